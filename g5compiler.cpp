@@ -6,29 +6,77 @@
 // GNU General Public License as published by the Free Software Foundation, either version 3 of 
 // the License, or (at your option) any later version.
 //===---------------------------------------------------------------------------------------===//
+#include <array>
+#include <bitset>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <exception>
 #include <iostream>
 #include <fstream>
 #include <functional>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <tuple>
+#include <unordered_map>
 #include <map>
+#include <optional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <iomanip>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#else
+#include <process.h>
+extern "C" __declspec(dllimport) void* __stdcall VirtualAlloc(void* address, size_t bytes, unsigned long type, unsigned long protect);
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define G5_SSE2
+#if defined(__GNUC__) && defined(__x86_64__)
+#define G5_AVX2
+#endif
+#endif
+#if defined(__GNUC__)
+#define G5_THREADED     // labels as values, the VM dispatches by computed goto
+#endif
 #define inrange(c,begin,end) (c>=begin && c<=end)
-#define LAMBDA_FUN(X) function<X*(Token&)> parse##X;
-#define G_ERROR(PRE,STR) \
-{cerr<<PRE<<": "<<STR<<" at line "<<line<<", col"<<column<<"\n";\
-exit(EXIT_FAILURE);}
+#define G_ERROR(PRE,STR) {throw Diagnostic{PRE, STR, line, column};}
 #define G_ASSERT(EXPR,PRE,MSG) {if((EXPR)) G_ERROR(PRE,MSG);}
 using namespace std;
 //===---------------------------------------------------------------------------------------===//
 // global data
 //===---------------------------------------------------------------------------------------===//
-string keywords[] = { "break","default","func","interface","select","case","defer","go","map",
+constexpr string_view keywords[] = { "break","default","func","interface","select","case","defer","go","map",
     "struct","chan","else","goto","package","switch","const","fallthrough","if","range","type",
     "continue","for","import","return","var" };
-static int line = 1, column = 1, lastToken = 0, shouldEof = 0, nestLev = 0;
-static struct goruntime {} grt;
+// A problem found in source files. G_ERROR throws it, then the parser records it and goes on, so
+// that a run reports every problem of a file
+struct Diagnostic {
+    string kind, message;
+    int line, column;
+};
+inline ostream& operator<<(ostream& os, const Diagnostic& d) {
+    return os << d.kind << ": " << d.message << " at line " << d.line << ", col" << d.column;
+}
+struct TooManyErrors {};     // a file, or a body parsed later, is given up when it has too many diagnostics
 static auto anyone = [](auto&& k, auto&&... args) ->bool { return ((args == k) || ...); };
 //===---------------------------------------------------------------------------------------===//
 // various declarations which contains TokenType for lexical analysis and AST node definitions 
@@ -45,501 +93,1247 @@ enum TokenType : signed int {
     OP_AGN, OP_ANDAGN, OP_COMMA, OP_SEMI, OP_MOD, OP_RSHIFT, OP_MODAGN, OP_RSFTAGN, OP_DEC, OP_NOT,
     OP_VARIADIC, OP_DOT, OP_COLON, OP_ANDXOR, OP_ANDXORAGN, TK_ID, LIT_INT, LIT_FLOAT, LIT_IMG, 
     LIT_RUNE, LIT_STR, TK_EOF = -1,};
-// TODO: add destructor for them
+// Bump pointer arena which holds all AST nodes of a CompilationUnit, nodes are laid out in parsing
+// order and never destructed one by one, the whole tree goes away along with its chunks
+struct Arena {
+    static thread_local Arena* current;     // arena that receives nodes created by `new` on this thread
+    struct Chunk { Chunk* prev; size_t size; };
+    Chunk* chunks{};
+    char* cur{}, *end{};
+    size_t used{}, count{};
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() { for (Chunk* prev; chunks != nullptr; chunks = prev) { prev = chunks->prev; free(chunks); } }
+    void* allocate(size_t n, size_t align = alignof(max_align_t)) {
+        auto p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(align - 1);
+        if (cur == nullptr || p + n > reinterpret_cast<uintptr_t>(end)) {
+            size_t size = max(n + align + sizeof(Chunk), chunks ? min<size_t>(chunks->size * 2, 16 << 20) : 64 << 10);
+            auto* c = static_cast<Chunk*>(malloc(size));
+            if (c == nullptr) throw bad_alloc();
+            *c = Chunk{ chunks, size };
+            chunks = c;
+            cur = reinterpret_cast<char*>(c + 1);
+            end = reinterpret_cast<char*>(c) + size;
+            p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(align - 1);
+        }
+        cur = reinterpret_cast<char*>(p + n);
+        used += n;
+        count++;
+        return reinterpret_cast<void*>(p);
+    }
+    string_view str(string_view s) {
+        if (s.empty()) return {};
+        auto* p = static_cast<char*>(allocate(s.size(), 1));
+        memcpy(p, s.data(), s.size());
+        return { p, s.size() };
+    }
+};
+thread_local Arena* Arena::current = nullptr;
+struct ArenaScope {
+    Arena* saved;
+    explicit ArenaScope(Arena& a) :saved(Arena::current) { Arena::current = &a; }
+    ~ArenaScope() { Arena::current = saved; }
+};
+template<typename T> struct ArenaAllocator {
+    using value_type = T;
+    ArenaAllocator() = default;
+    template<typename U> ArenaAllocator(const ArenaAllocator<U>&) {}
+    T* allocate(size_t n) { return static_cast<T*>(Arena::current->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+    template<typename U> bool operator==(const ArenaAllocator<U>&) const { return true; }
+    template<typename U> bool operator!=(const ArenaAllocator<U>&) const { return false; }
+};
+template<typename T> using avector = vector<T, ArenaAllocator<T>>;
+template<typename K, typename V> using amap = map<K, V, less<K>, ArenaAllocator<pair<const K, V>>>;
+struct ArenaObject {
+    static void* operator new(size_t n) { return Arena::current->allocate(n); }
+    static void operator delete(void*) {}
+};
+// Identifiers and literals are interned into 32-bit symbols backed by one string pool shared by
+// all files, equal spellings are equal ids. Symbol 0 is the empty string
+struct Symbol {
+    uint32_t id{};
+    string_view str() const;
+    bool operator==(Symbol s) const { return id == s.id; }
+    bool operator!=(Symbol s) const { return id != s.id; }
+    bool operator<(Symbol s) const { return id < s.id; }
+};
+struct SymbolTable {
+    static constexpr uint32_t PageBits = 16, PageSize = 1 << PageBits;
+    mutex lock;
+    Arena pool;                                 // spellings and pages, they live as long as the program
+    array<string_view*, 4096> pages{};          // id -> spelling, pages never move so reading needs no lock
+    vector<pair<uint32_t, uint32_t>> slots;     // open addressing of (hash, id), guarded by lock
+    uint32_t size = 1;
+    static uint32_t hash(string_view s) {
+        uint32_t h = 2166136261u;
+        for (unsigned char c : s) h = (h ^ c) * 16777619u;
+        return h;
+    }
+    string_view spelling(uint32_t id) const { return pages[id >> PageBits][id & (PageSize - 1)]; }
+    Symbol intern(string_view s) {
+        if (s.empty()) return {};
+        const uint32_t h = hash(s);
+        // symbols seen by this thread are remembered, so most lookups never take the lock
+        static thread_local array<Symbol, 4096> cache{};
+        Symbol& seen = cache[h & (cache.size() - 1)];
+        if (seen.id != 0 && spelling(seen.id) == s) return seen;
+        lock_guard<mutex> guard(lock);
+        if (size * 2 >= slots.size()) {
+            vector<pair<uint32_t, uint32_t>> old(max<size_t>(slots.size() * 2, 4096));
+            old.swap(slots);
+            for (auto[oh, oid] : old) if (oid != 0) slots[probe(oh, [](auto&) { return false; })] = { oh, oid };
+        }
+        auto& slot = slots[probe(h, [&](auto& e) { return e.first == h && spelling(e.second) == s; })];
+        if (slot.second == 0) {
+            if (size >= pages.size() * PageSize) { cerr << "fatal error: too many symbols\n"; exit(EXIT_FAILURE); }
+            auto& page = pages[size >> PageBits];
+            if (page == nullptr) page = static_cast<string_view*>(pool.allocate(sizeof(string_view) * PageSize));
+            page[size & (PageSize - 1)] = pool.str(s);
+            slot = { h, size++ };
+        }
+        return seen = Symbol{ slot.second };
+    }
+    template<typename F> size_t probe(uint32_t h, F match) const {   // slot of a match or an empty one
+        for (size_t i = h & (slots.size() - 1);; i = (i + 1) & (slots.size() - 1))
+            if (slots[i].second == 0 || match(slots[i])) return i;
+    }
+};
+// never destroyed, a worker thread may still intern while another one exits on error
+static SymbolTable& symbols = *new SymbolTable;
+inline string_view Symbol::str() const { return symbols.spelling(id); }
+inline ostream& operator<<(ostream& os, Symbol s) { return os << s.str(); }
 // Common
-#define _S :public Stmt
-#define _E :public Expr
-#define _N :public Node
-#define CTOR1(NAME,FD1)         NAME(decltype(FD1) FD1):FD1(FD1){}
-#define CTOR2(NAME,FD1,FD2)     NAME(decltype(FD1) FD1, decltype(FD2) FD2):FD1(FD1),FD2(FD2){}
-#define CTOR3(NAME,FD1,FD2,FD3) NAME(decltype(FD1) FD1, decltype(FD2) FD2, decltype(FD3) FD3)\
+#define _S(NAME) :public NodeOf<NodeKind::NAME, Stmt>
+#define _E(NAME) :public NodeOf<NodeKind::NAME, Expr>
+#define CTOR1(NAME,FD1)         NAME() = default; NAME(decltype(FD1) FD1):FD1(FD1){}
+#define CTOR2(NAME,FD1,FD2)     NAME() = default; NAME(decltype(FD1) FD1, decltype(FD2) FD2):FD1(FD1),FD2(FD2){}
+#define CTOR3(NAME,FD1,FD2,FD3) NAME() = default; NAME(decltype(FD1) FD1, decltype(FD2) FD2, decltype(FD3) FD3)\
                                 :FD1(FD1),FD2(FD2),FD3(FD3){}
 // Common
-struct Node                { virtual ~Node() = default; };
-struct Expr             _N {};
-struct Stmt             _N {};
-struct ExprList         _E { vector<Expr*> exprs; };
-struct StmtList         _S { vector<Stmt*> stmts; };    // the concept of **block**
+// Nodes are not polymorphic, the kind tells which concrete node it is, see as<T>() and walk()
+enum class NodeKind : uint8_t {
+    ExprList, StmtList, GoStmt, ReturnStmt, BreakStmt, DeferStmt, ContinueStmt,
+    GotoStmt, FallthroughStmt, LabeledStmt, IfStmt, SwitchStmt, SelectStmt, ForStmt,
+    SRangeClause, RangeClause, ExprStmt, SendStmt, IncDecStmt, AssignStmt, SAssignStmt,
+    BasicExpr, SelectorExpr, TypeSwitchExpr, IndexExpr, TypeAssertExpr, SliceExpr, CallExpr,
+    LitValue, BasicLit, CompositeLit, Name, ArrayType, StructType, PtrType,
+    FuncType, InterfaceType, SliceType, MapType, ChanType, ConstDecl, TypeDecl,
+    VarDecl, FuncDecl
+};
+constexpr string_view kindName[] = {
+    "ExprList", "StmtList", "GoStmt", "ReturnStmt", "BreakStmt", "DeferStmt", "ContinueStmt",
+    "GotoStmt", "FallthroughStmt", "LabeledStmt", "IfStmt", "SwitchStmt", "SelectStmt", "ForStmt",
+    "SRangeClause", "RangeClause", "ExprStmt", "SendStmt", "IncDecStmt", "AssignStmt", "SAssignStmt",
+    "BasicExpr", "SelectorExpr", "TypeSwitchExpr", "IndexExpr", "TypeAssertExpr", "SliceExpr", "CallExpr",
+    "LitValue", "BasicLit", "CompositeLit", "Name", "ArrayType", "StructType", "PtrType",
+    "FuncType", "InterfaceType", "SliceType", "MapType", "ChanType", "ConstDecl", "TypeDecl",
+    "VarDecl", "FuncDecl"
+};
+static_assert(size(kindName) == static_cast<size_t>(NodeKind::FuncDecl) + 1, "a NodeKind has no name");
+struct Node:ArenaObject   { NodeKind kind{}; };
+struct Expr:Node          {};
+struct Stmt:Node          {};
+template<NodeKind K, typename Base> struct NodeOf :Base {
+    static constexpr NodeKind Kind = K;
+    NodeOf() { this->kind = K; }
+};
+struct ExprList         _E(ExprList) { avector<Expr*> exprs; };
+struct StmtList         _S(StmtList) { avector<Stmt*> stmts; };    // the concept of **block**
 // Statement
-struct GoStmt           _S { Expr* expr{}; CTOR1(GoStmt, expr) };
-struct ReturnStmt       _S { ExprList* exprs{}; CTOR1(ReturnStmt,exprs) };
-struct BreakStmt        _S { string label; CTOR1(BreakStmt, label) };
-struct DeferStmt        _S { Expr* expr{}; CTOR1(DeferStmt, expr) };
-struct ContinueStmt     _S { string label; CTOR1(ContinueStmt, label) };
-struct GotoStmt         _S { string label; CTOR1(GotoStmt, label) };
-struct FallthroughStmt  _S {};
-struct LabeledStmt      _S { string label; Stmt* stmt{}; CTOR2(LabeledStmt,label,stmt)};
-struct IfStmt           _S { Stmt* init{}, *ifBlock{}, *elseBlock{}; Expr* cond{}; };
-struct SwitchStmt       _S { Stmt* init{}, *cond{}; vector<tuple<ExprList*,StmtList*>> caseList{}; };
-struct SelectStmt       _S { vector<tuple<Stmt*,StmtList*>> caseList;};
-struct ForStmt          _S { Node* init{}, *cond{}, *post{}; StmtList* block{}; };
-struct SRangeClause     _S { vector<string> lhs; Expr* rhs{}; CTOR2(SRangeClause, lhs, rhs) };
-struct RangeClause      _S { ExprList* lhs{}; TokenType op; Expr* rhs{}; CTOR3(RangeClause,lhs,op,rhs)};
-struct ExprStmt         _S { Expr* expr{}; CTOR1(ExprStmt,expr) };
-struct SendStmt         _S { Expr* receiver{}, *sender{}; CTOR2(SendStmt, receiver, sender) };
-struct IncDecStmt       _S { Expr* expr{}; bool isInc{}; CTOR2(IncDecStmt, expr, isInc) };
-struct AssignStmt       _S { ExprList* lhs{}, *rhs{}; TokenType op{}; CTOR3(AssignStmt,lhs,op,rhs) };
-struct SAssignStmt      _S { vector<string> lhs{}; ExprList* rhs{}; CTOR2(SAssignStmt,lhs,rhs) };
+struct GoStmt           _S(GoStmt) { Expr* expr{}; CTOR1(GoStmt, expr) };
+struct ReturnStmt       _S(ReturnStmt) { ExprList* exprs{}; CTOR1(ReturnStmt,exprs) };
+struct BreakStmt        _S(BreakStmt) { Symbol label; CTOR1(BreakStmt, label) };
+struct DeferStmt        _S(DeferStmt) { Expr* expr{}; CTOR1(DeferStmt, expr) };
+struct ContinueStmt     _S(ContinueStmt) { Symbol label; CTOR1(ContinueStmt, label) };
+struct GotoStmt         _S(GotoStmt) { Symbol label; CTOR1(GotoStmt, label) };
+struct FallthroughStmt  _S(FallthroughStmt) {};
+struct LabeledStmt      _S(LabeledStmt) { Symbol label; Stmt* stmt{}; CTOR2(LabeledStmt,label,stmt)};
+struct IfStmt           _S(IfStmt) { Stmt* init{}, *ifBlock{}, *elseBlock{}; Expr* cond{}; };
+struct SwitchStmt       _S(SwitchStmt) { Stmt* init{}, *cond{}; avector<tuple<ExprList*,StmtList*>> caseList{}; };
+struct SelectStmt       _S(SelectStmt) { avector<tuple<Stmt*,StmtList*>> caseList;};
+struct ForStmt          _S(ForStmt) { Node* init{}, *cond{}, *post{}; StmtList* block{}; };
+struct SRangeClause     _S(SRangeClause) { avector<Symbol> lhs; Expr* rhs{}; CTOR2(SRangeClause, lhs, rhs) };
+struct RangeClause      _S(RangeClause) { ExprList* lhs{}; TokenType op; Expr* rhs{}; CTOR3(RangeClause,lhs,op,rhs)};
+struct ExprStmt         _S(ExprStmt) { Expr* expr{}; CTOR1(ExprStmt,expr) };
+struct SendStmt         _S(SendStmt) { Expr* receiver{}, *sender{}; CTOR2(SendStmt, receiver, sender) };
+struct IncDecStmt       _S(IncDecStmt) { Expr* expr{}; bool isInc{}; CTOR2(IncDecStmt, expr, isInc) };
+struct AssignStmt       _S(AssignStmt) { ExprList* lhs{}, *rhs{}; TokenType op{}; CTOR3(AssignStmt,lhs,op,rhs) };
+struct SAssignStmt      _S(SAssignStmt) { avector<Symbol> lhs{}; ExprList* rhs{}; CTOR2(SAssignStmt,lhs,rhs) };
 // Expression
-struct BasicExpr        _E { Expr*lhs{}, *rhs{}; TokenType op{}; };
-struct SelectorExpr     _E { Expr* operand{}; string selector; CTOR2(SelectorExpr, operand, selector) };
-struct TypeSwitchExpr   _E { Expr* operand{}; CTOR1(TypeSwitchExpr, operand) };
-struct IndexExpr        _E { Expr* operand{}, *index{}; CTOR2(IndexExpr, operand,index) };
-struct TypeAssertExpr   _E { Expr* operand{}, *type{}; CTOR2(TypeAssertExpr, operand, type) };
-struct SliceExpr        _E { Expr* operand{}, *begin{}, *end{}, *step{}; };
-struct CallExpr         _E { Expr* operand{}, *type{}; ExprList* arguments{}; bool isVariadic{}; };
-struct LitValue         _E { vector<tuple<Expr*,Expr*>> keyedElement; };
-struct BasicLit         _E { TokenType type{}; string value; CTOR2(BasicLit, type, value) };
-struct CompositeLit     _E { Expr* litName{}; LitValue* litValue{}; CTOR2(CompositeLit,litName,litValue) };
-struct Name             _E { string name; };
-struct ArrayType        _E { Expr* len{}; Expr* elem{}; bool autoLen = false; };
-struct StructType       _E { vector<tuple<vector<string>, Expr*, string, bool>> fields; };
-struct PtrType          _E { Expr* elem{}; CTOR1(PtrType, elem) };
-struct ParamDecl           { bool isVariadic = false, hasName = false; Expr* type{}; string name; };
-struct Param               { vector<ParamDecl*> paramList; };
-struct Signature           { Param* param{}, *resultParam{}; Expr* resultType{}; };
-struct FuncType         _E { Signature * signature{}; CTOR1(FuncType,signature) };
-struct InterfaceType    _E { vector<tuple<Name*, Signature*>> method; };
-struct SliceType        _E { Expr* elem{}; };
-struct MapType          _E { Expr* type{}, *elem{}; };
-struct ChanType         _E { Expr* elem{}; };
+struct BasicExpr        _E(BasicExpr) { Expr*lhs{}, *rhs{}; TokenType op{}; };
+struct SelectorExpr     _E(SelectorExpr) { Expr* operand{}; Symbol selector; CTOR2(SelectorExpr, operand, selector) };
+struct TypeSwitchExpr   _E(TypeSwitchExpr) { Expr* operand{}; CTOR1(TypeSwitchExpr, operand) };
+struct IndexExpr        _E(IndexExpr) { Expr* operand{}, *index{}; CTOR2(IndexExpr, operand,index) };
+struct TypeAssertExpr   _E(TypeAssertExpr) { Expr* operand{}, *type{}; CTOR2(TypeAssertExpr, operand, type) };
+struct SliceExpr        _E(SliceExpr) { Expr* operand{}, *begin{}, *end{}, *step{}; };
+struct CallExpr         _E(CallExpr) { Expr* operand{}, *type{}; ExprList* arguments{}; bool isVariadic{}; };
+struct LitValue         _E(LitValue) { avector<tuple<Expr*,Expr*>> keyedElement; };
+struct BasicLit         _E(BasicLit) { TokenType type{}; Symbol value; CTOR2(BasicLit, type, value) };
+struct CompositeLit     _E(CompositeLit) { Expr* litName{}; LitValue* litValue{}; CTOR2(CompositeLit,litName,litValue) };
+struct Name             _E(Name) { Symbol name; };
+struct ArrayType        _E(ArrayType) { Expr* len{}; Expr* elem{}; bool autoLen = false; };
+struct StructType       _E(StructType) { avector<tuple<avector<Symbol>, Expr*, Symbol, bool>> fields; };
+struct PtrType          _E(PtrType) { Expr* elem{}; CTOR1(PtrType, elem) };
+struct ParamDecl:ArenaObject { bool isVariadic = false, hasName = false; Expr* type{}; Symbol name; };
+struct Param:ArenaObject  { avector<ParamDecl*> paramList; };
+struct Signature:ArenaObject { Param* param{}, *resultParam{}; Expr* resultType{}; };
+struct FuncType         _E(FuncType) { Signature * signature{}; CTOR1(FuncType,signature) };
+struct InterfaceType    _E(InterfaceType) { avector<tuple<Name*, Signature*>> method; };
+struct SliceType        _E(SliceType) { Expr* elem{}; };
+struct MapType          _E(MapType) { Expr* type{}, *elem{}; };
+struct ChanType         _E(ChanType) { Expr* elem{}; };
 // Declaration
-struct ImportDecl          { map<string, string> imports; };
-struct ConstDecl        _S { vector<vector<string>> idents; vector<Expr*> type; vector<ExprList*> exprs; };
-struct TypeDecl         _S { vector<tuple< string,Expr*>> typeSpec; };
-struct VarSpec             { vector<string> idents{}; ExprList* exprs{}; Expr* type{}; };
-struct VarDecl          _S { vector<VarSpec*> varSpec; };
-// Freak
-struct FuncDecl:public Stmt,Expr{ string funcName;Param* receiver{};Signature* signature{};StmtList* funcBody{};};
+struct ImportDecl:ArenaObject { amap<Symbol, Symbol> imports; };
+struct ConstDecl        _S(ConstDecl) { avector<avector<Symbol>> idents; avector<Expr*> type; avector<ExprList*> exprs; };
+struct TypeDecl         _S(TypeDecl) { avector<tuple<Symbol,Expr*>> typeSpec; };
+struct VarSpec:ArenaObject { avector<Symbol> idents{}; ExprList* exprs{}; Expr* type{}; };
+struct VarDecl          _S(VarDecl) { avector<VarSpec*> varSpec; };
+// function literal is an expression as well, the named ones only appear in CompilationUnit
+// Function body that a lazy parse skipped, it's parsed on first access. A unit is not locked
+// meanwhile, touch bodies of one unit from one thread at a time
+struct CompilationUnit;
+struct LazyBlock {
+    StmtList* block{};
+    string_view text;           // from '{' to '}', copied into arena of the unit until it's parsed
+    int line{}, column{};       // lexer position right after '{'
+    CompilationUnit* unit{};
+    uint32_t firstError{}, errors{};    // diagnostics of the unit it reported once parsed
+    LazyBlock& operator=(StmtList* b) { block = b; return *this; }
+    operator StmtList*();
+    StmtList* operator->() { return *this; }
+};
+struct FuncDecl         _E(FuncDecl) { Symbol funcName; Param* receiver{}; Signature* signature{}; LazyBlock funcBody; };
+// Where a top-level declaration of a unit starts, see reparse(). Offsets are known for units parsed from text
+struct DeclSpan {
+    uint32_t offset, reach;     // lexing its first token started at offset, parsing it read text up to reach
+    int line, column, last;     // lexer state at offset
+    int keyLine, keyColumn;     // lexer position right after keyword, diagnostics about the declaration point there
+    TokenType keyword;
+    ArenaObject* decl;          // ImportDecl or the Node that keyword starts, null if it failed to parse
+    uint32_t errors;            // diagnostics reported while parsing it
+};
 struct CompilationUnit {
-    string package;
+    Arena arena;    // owns every node of this unit
+    Symbol package;
+    vector<ImportDecl*> importDecl;
+    vector<ConstDecl*> constDecl;
+    vector<TypeDecl*> typeDecl;
+    vector<FuncDecl*> funcDecl;
+    vector<VarDecl*> varDecl;
+    string file;
+    vector<Diagnostic> diagnostics;
+    double seconds{};   // time spent parsing it
+    bool cached{};      // loaded from AstCache rather than parsed
+    // Units parsed from text keep it along with their top-level layout, so that reparse() could
+    // parse again only declarations an edit touches. Others keep where their declarations start
+    string text;
+    vector<DeclSpan> spans;
+    size_t parseErrors{};   // leading diagnostics that parsing the text reported, bodies report the rest
+    size_t parsedBytes{};   // of arena that the last parse of the whole text took
+    size_t reparsedBytes{}; // and that reparse() took since then, replaced declarations stay in arena
+    unsigned edits{};       // reparsed in place since then
+    bool lazy{};
+};
+// Files sharing a package clause are viewed as one Package, nodes are still owned by their units
+struct Package {
+    Symbol name;
+    vector<CompilationUnit*> units;
     vector<ImportDecl*> importDecl;
     vector<ConstDecl*> constDecl;
     vector<TypeDecl*> typeDecl;
     vector<FuncDecl*> funcDecl;
     vector<VarDecl*> varDecl;
+    void merge(CompilationUnit* unit) {
+        auto append = [](auto& to, auto& from) { to.insert(to.end(), from.begin(), from.end()); };
+        name = unit->package;
+        units.push_back(unit);
+        append(importDecl, unit->importDecl);
+        append(constDecl, unit->constDecl);
+        append(typeDecl, unit->typeDecl);
+        append(funcDecl, unit->funcDecl);
+        append(varDecl, unit->varDecl);
+    }
 };
+template<typename T> T* as(Node* n) { return n != nullptr && n->kind == T::Kind ? static_cast<T*>(n) : nullptr; }
+// Static AST walker, fn(Node*) is invoked on n and then on its descendants in pre-order, children
+// of a node are skipped if fn returns false. It dispatches by switching on kind, neither RTTI nor
+// virtual function is involved
+template<typename F> void walk(Node* n, F&& fn) {
+    if (n == nullptr || !fn(n)) return;
+    auto each = [&](const auto& list) { for (auto* c : list) walk(c, fn); };
+    auto param = [&](Param* p) { if (p != nullptr) for (auto* d : p->paramList) walk(d->type, fn); };
+    auto signature = [&](Signature* s) {
+        if (s != nullptr) { param(s->param); param(s->resultParam); walk(s->resultType, fn); }
+    };
+    switch (n->kind) {
+    case NodeKind::ExprList:       each(static_cast<ExprList*>(n)->exprs); break;
+    case NodeKind::StmtList:       each(static_cast<StmtList*>(n)->stmts); break;
+    case NodeKind::GoStmt:         walk(static_cast<GoStmt*>(n)->expr, fn); break;
+    case NodeKind::ReturnStmt:     walk(static_cast<ReturnStmt*>(n)->exprs, fn); break;
+    case NodeKind::DeferStmt:      walk(static_cast<DeferStmt*>(n)->expr, fn); break;
+    case NodeKind::LabeledStmt:    walk(static_cast<LabeledStmt*>(n)->stmt, fn); break;
+    case NodeKind::IfStmt: {
+        auto* s = static_cast<IfStmt*>(n);
+        walk(s->init, fn); walk(s->cond, fn); walk(s->ifBlock, fn); walk(s->elseBlock, fn);
+        break;
+    }
+    case NodeKind::SwitchStmt: {
+        auto* s = static_cast<SwitchStmt*>(n);
+        walk(s->init, fn); walk(s->cond, fn);
+        for (auto&[exprs, stmts] : s->caseList) { walk(exprs, fn); walk(stmts, fn); }
+        break;
+    }
+    case NodeKind::SelectStmt:
+        for (auto&[cond, stmts] : static_cast<SelectStmt*>(n)->caseList) { walk(cond, fn); walk(stmts, fn); }
+        break;
+    case NodeKind::ForStmt: {
+        auto* s = static_cast<ForStmt*>(n);
+        walk(s->init, fn); walk(s->cond, fn); walk(s->post, fn); walk(s->block, fn);
+        break;
+    }
+    case NodeKind::SRangeClause:   walk(static_cast<SRangeClause*>(n)->rhs, fn); break;
+    case NodeKind::RangeClause:    walk(static_cast<RangeClause*>(n)->lhs, fn); walk(static_cast<RangeClause*>(n)->rhs, fn); break;
+    case NodeKind::ExprStmt:       walk(static_cast<ExprStmt*>(n)->expr, fn); break;
+    case NodeKind::SendStmt:       walk(static_cast<SendStmt*>(n)->receiver, fn); walk(static_cast<SendStmt*>(n)->sender, fn); break;
+    case NodeKind::IncDecStmt:     walk(static_cast<IncDecStmt*>(n)->expr, fn); break;
+    case NodeKind::AssignStmt:     walk(static_cast<AssignStmt*>(n)->lhs, fn); walk(static_cast<AssignStmt*>(n)->rhs, fn); break;
+    case NodeKind::SAssignStmt:    walk(static_cast<SAssignStmt*>(n)->rhs, fn); break;
+    case NodeKind::BasicExpr:      walk(static_cast<BasicExpr*>(n)->lhs, fn); walk(static_cast<BasicExpr*>(n)->rhs, fn); break;
+    case NodeKind::SelectorExpr:   walk(static_cast<SelectorExpr*>(n)->operand, fn); break;
+    case NodeKind::TypeSwitchExpr: walk(static_cast<TypeSwitchExpr*>(n)->operand, fn); break;
+    case NodeKind::IndexExpr:      walk(static_cast<IndexExpr*>(n)->operand, fn); walk(static_cast<IndexExpr*>(n)->index, fn); break;
+    case NodeKind::TypeAssertExpr: walk(static_cast<TypeAssertExpr*>(n)->operand, fn); walk(static_cast<TypeAssertExpr*>(n)->type, fn); break;
+    case NodeKind::SliceExpr: {
+        auto* e = static_cast<SliceExpr*>(n);
+        walk(e->operand, fn); walk(e->begin, fn); walk(e->end, fn); walk(e->step, fn);
+        break;
+    }
+    case NodeKind::CallExpr: {
+        auto* e = static_cast<CallExpr*>(n);
+        walk(e->operand, fn); walk(e->type, fn); walk(e->arguments, fn);
+        break;
+    }
+    case NodeKind::LitValue:
+        for (auto&[key, elem] : static_cast<LitValue*>(n)->keyedElement) { walk(key, fn); walk(elem, fn); }
+        break;
+    case NodeKind::CompositeLit:   walk(static_cast<CompositeLit*>(n)->litName, fn); walk(static_cast<CompositeLit*>(n)->litValue, fn); break;
+    case NodeKind::ArrayType:      walk(static_cast<ArrayType*>(n)->len, fn); walk(static_cast<ArrayType*>(n)->elem, fn); break;
+    case NodeKind::StructType:     for (auto& field : static_cast<StructType*>(n)->fields) walk(get<1>(field), fn); break;
+    case NodeKind::PtrType:        walk(static_cast<PtrType*>(n)->elem, fn); break;
+    case NodeKind::FuncType:       signature(static_cast<FuncType*>(n)->signature); break;
+    case NodeKind::InterfaceType:
+        for (auto&[name, sig] : static_cast<InterfaceType*>(n)->method) { walk(name, fn); signature(sig); }
+        break;
+    case NodeKind::SliceType:      walk(static_cast<SliceType*>(n)->elem, fn); break;
+    case NodeKind::MapType:        walk(static_cast<MapType*>(n)->type, fn); walk(static_cast<MapType*>(n)->elem, fn); break;
+    case NodeKind::ChanType:       walk(static_cast<ChanType*>(n)->elem, fn); break;
+    case NodeKind::ConstDecl: {
+        auto* d = static_cast<ConstDecl*>(n);
+        each(d->type); each(d->exprs);
+        break;
+    }
+    case NodeKind::TypeDecl:       for (auto&[name, type] : static_cast<TypeDecl*>(n)->typeSpec) walk(type, fn); break;
+    case NodeKind::VarDecl:
+        for (auto* spec : static_cast<VarDecl*>(n)->varSpec) if (spec != nullptr) { walk(spec->type, fn); walk(spec->exprs, fn); }
+        break;
+    case NodeKind::FuncDecl: {
+        auto* d = static_cast<FuncDecl*>(n);
+        param(d->receiver); signature(d->signature); walk(d->funcBody, fn);
+        break;
+    }
+    case NodeKind::BreakStmt: case NodeKind::ContinueStmt: case NodeKind::GotoStmt: case NodeKind::FallthroughStmt:
+    case NodeKind::BasicLit: case NodeKind::Name: break;
+    }
+}
+// Fields of nodes in declaration order, io(fields...) visits them. It's the one list that AstCache and
+// CompactAst derive their layouts from. node<T>(n) lets io pick the node to visit or create a new one
+template<typename IO> void fields(IO& io, ParamDecl* d) { io(d->isVariadic, d->hasName, d->type, d->name); }
+template<typename IO> void fields(IO& io, Param* p) { io(p->paramList); }
+template<typename IO> void fields(IO& io, Signature* s) { io(s->param, s->resultParam, s->resultType); }
+template<typename IO> void fields(IO& io, VarSpec* s) { io(s->idents, s->exprs, s->type); }
+template<typename IO> void fields(IO& io, ImportDecl* d) { io(d->imports); }
+template<typename IO> Node* fields(IO& io, NodeKind kind, Node* n) {
+    switch (kind) {
+    case NodeKind::ExprList:       { auto* e = io.template node<ExprList>(n); io(e->exprs); return e; }
+    case NodeKind::StmtList:       { auto* s = io.template node<StmtList>(n); io(s->stmts); return s; }
+    case NodeKind::GoStmt:         { auto* s = io.template node<GoStmt>(n); io(s->expr); return s; }
+    case NodeKind::ReturnStmt:     { auto* s = io.template node<ReturnStmt>(n); io(s->exprs); return s; }
+    case NodeKind::BreakStmt:      { auto* s = io.template node<BreakStmt>(n); io(s->label); return s; }
+    case NodeKind::DeferStmt:      { auto* s = io.template node<DeferStmt>(n); io(s->expr); return s; }
+    case NodeKind::ContinueStmt:   { auto* s = io.template node<ContinueStmt>(n); io(s->label); return s; }
+    case NodeKind::GotoStmt:       { auto* s = io.template node<GotoStmt>(n); io(s->label); return s; }
+    case NodeKind::FallthroughStmt:{ return io.template node<FallthroughStmt>(n); }
+    case NodeKind::LabeledStmt:    { auto* s = io.template node<LabeledStmt>(n); io(s->label, s->stmt); return s; }
+    case NodeKind::IfStmt:         { auto* s = io.template node<IfStmt>(n); io(s->init, s->ifBlock, s->elseBlock, s->cond); return s; }
+    case NodeKind::SwitchStmt:     { auto* s = io.template node<SwitchStmt>(n); io(s->init, s->cond, s->caseList); return s; }
+    case NodeKind::SelectStmt:     { auto* s = io.template node<SelectStmt>(n); io(s->caseList); return s; }
+    case NodeKind::ForStmt:        { auto* s = io.template node<ForStmt>(n); io(s->init, s->cond, s->post, s->block); return s; }
+    case NodeKind::SRangeClause:   { auto* s = io.template node<SRangeClause>(n); io(s->lhs, s->rhs); return s; }
+    case NodeKind::RangeClause:    { auto* s = io.template node<RangeClause>(n); io(s->lhs, s->op, s->rhs); return s; }
+    case NodeKind::ExprStmt:       { auto* s = io.template node<ExprStmt>(n); io(s->expr); return s; }
+    case NodeKind::SendStmt:       { auto* s = io.template node<SendStmt>(n); io(s->receiver, s->sender); return s; }
+    case NodeKind::IncDecStmt:     { auto* s = io.template node<IncDecStmt>(n); io(s->expr, s->isInc); return s; }
+    case NodeKind::AssignStmt:     { auto* s = io.template node<AssignStmt>(n); io(s->lhs, s->rhs, s->op); return s; }
+    case NodeKind::SAssignStmt:    { auto* s = io.template node<SAssignStmt>(n); io(s->lhs, s->rhs); return s; }
+    case NodeKind::BasicExpr:      { auto* e = io.template node<BasicExpr>(n); io(e->lhs, e->rhs, e->op); return e; }
+    case NodeKind::SelectorExpr:   { auto* e = io.template node<SelectorExpr>(n); io(e->operand, e->selector); return e; }
+    case NodeKind::TypeSwitchExpr: { auto* e = io.template node<TypeSwitchExpr>(n); io(e->operand); return e; }
+    case NodeKind::IndexExpr:      { auto* e = io.template node<IndexExpr>(n); io(e->operand, e->index); return e; }
+    case NodeKind::TypeAssertExpr: { auto* e = io.template node<TypeAssertExpr>(n); io(e->operand, e->type); return e; }
+    case NodeKind::SliceExpr:      { auto* e = io.template node<SliceExpr>(n); io(e->operand, e->begin, e->end, e->step); return e; }
+    case NodeKind::CallExpr:       { auto* e = io.template node<CallExpr>(n); io(e->operand, e->type, e->arguments, e->isVariadic); return e; }
+    case NodeKind::LitValue:       { auto* e = io.template node<LitValue>(n); io(e->keyedElement); return e; }
+    case NodeKind::BasicLit:       { auto* e = io.template node<BasicLit>(n); io(e->type, e->value); return e; }
+    case NodeKind::CompositeLit:   { auto* e = io.template node<CompositeLit>(n); io(e->litName, e->litValue); return e; }
+    case NodeKind::Name:           { auto* e = io.template node<Name>(n); io(e->name); return e; }
+    case NodeKind::ArrayType:      { auto* e = io.template node<ArrayType>(n); io(e->len, e->elem, e->autoLen); return e; }
+    case NodeKind::StructType:     { auto* e = io.template node<StructType>(n); io(e->fields); return e; }
+    case NodeKind::PtrType:        { auto* e = io.template node<PtrType>(n); io(e->elem); return e; }
+    case NodeKind::FuncType:       { auto* e = io.template node<FuncType>(n); io(e->signature); return e; }
+    case NodeKind::InterfaceType:  { auto* e = io.template node<InterfaceType>(n); io(e->method); return e; }
+    case NodeKind::SliceType:      { auto* e = io.template node<SliceType>(n); io(e->elem); return e; }
+    case NodeKind::MapType:        { auto* e = io.template node<MapType>(n); io(e->type, e->elem); return e; }
+    case NodeKind::ChanType:       { auto* e = io.template node<ChanType>(n); io(e->elem); return e; }
+    case NodeKind::ConstDecl:      { auto* d = io.template node<ConstDecl>(n); io(d->idents, d->type, d->exprs); return d; }
+    case NodeKind::TypeDecl:       { auto* d = io.template node<TypeDecl>(n); io(d->typeSpec); return d; }
+    case NodeKind::VarDecl:        { auto* d = io.template node<VarDecl>(n); io(d->varSpec); return d; }
+    case NodeKind::FuncDecl:       { auto* d = io.template node<FuncDecl>(n); io(d->funcName, d->receiver, d->signature, d->funcBody); return d; }
+    }
+    return nullptr;
+}
 struct Token { 
-    TokenType type{}; string lexeme;
-    Token(TokenType t, string e) :type(t), lexeme(e) { lastToken = t; }
+    TokenType type{}; string_view lexeme;   // lexeme refers to Source buffer, copy it if needed
+    Symbol sym;                             // interned lexeme of identifiers and literals
+    Token(TokenType t, string_view e, Symbol s = {}) :type(t), lexeme(e), sym(s) {}
+};
+// Whole source file in memory, it's mmapped whenever possible otherwise we read it by fstream
+struct Source {
+    const char* begin{}, *cur{}, *end{};
+    string fallback;
+    size_t mapped{};
+    explicit Source(const string& filename) {
+#ifndef _WIN32
+        if (int fd = open(filename.c_str(), O_RDONLY); fd != -1) {
+            struct stat st{};
+            if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+                if (void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0); p != MAP_FAILED) {
+                    madvise(p, st.st_size, MADV_SEQUENTIAL);
+                    mapped = st.st_size;
+                    begin = static_cast<const char*>(p);
+                }
+            }
+            close(fd);
+        }
+#endif
+        if (!mapped) {
+            fstream f(filename, ios::binary | ios::in);
+            fallback.assign(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+            begin = fallback.data();
+        }
+        cur = begin;
+        end = begin + (mapped ? mapped : fallback.size());
+    }
+    Source(const char* b, const char* e) :begin(b), cur(b), end(e) {}     // view of a buffer owned by others
+    ~Source() {
+#ifndef _WIN32
+        if (mapped) munmap(const_cast<char*>(begin), mapped);
+#endif
+    }
+    Source(const Source&) = delete;
+    Source& operator=(const Source&) = delete;
+    char peek() const { return cur < end ? *cur : static_cast<char>(EOF); }
+    bool good() const { return cur < end; }
+    bool eof() const { return cur >= end; }
+};
+// Lexing state of one source file, nothing is shared so that files can be lexed in parallel
+struct Lexer :Source {
+    int line = 1, column = 1, lastToken = 0, shouldEof = 0;
+    using Source::Source;
+    Lexer(string_view text, int line, int column, int lastToken)
+        :Source(text.data(), text.data() + text.size()), line(line), column(column), lastToken(lastToken) {}
+};
+#pragma endregion
+//===---------------------------------------------------------------------------------------===//
+// lexical tables, all of them are computed at compile time so the lexer needs no runtime setup
+//===---------------------------------------------------------------------------------------===//
+#pragma region LexTable
+enum CharClass : uint8_t { CC_ID = 1, CC_DIGIT = 2, CC_HEX = 4, CC_OCT = 8, CC_SPACE = 16, CC_NUM = 32, CC_BODY = 64 };
+constexpr auto charClass = [] {
+    array<uint8_t, 256> t{};
+    for (int c = 0; c < 256; c++) {
+        if (inrange(c, 'a', 'z') || inrange(c, 'A', 'Z') || c == '_') t[c] |= CC_ID;
+        if (inrange(c, '0', '9')) t[c] |= CC_DIGIT | CC_HEX | CC_NUM;
+        if (inrange(c, '0', '7')) t[c] |= CC_OCT;
+        if (inrange(c, 'a', 'f') || inrange(c, 'A', 'F')) t[c] |= CC_HEX;
+        if (c == ' ' || c == '\r' || c == '\t' || c == '\n') t[c] |= CC_SPACE;
+        if (c == '.' || c == 'e' || c == 'E' || c == 'i') t[c] |= CC_NUM;   // continuation of numbers
+        if (c == '{' || c == '}' || c == '"' || c == '\'' || c == '`' || c == '/') t[c] |= CC_BODY;  // see skipBlock
+    }
+    return t;
+}();
+constexpr bool isa(char c, uint8_t cls) { return (charClass[static_cast<unsigned char>(c)] & cls) != 0; }
+
+// perfect hash of 25 keywords, constructing kwTable fails to compile if two keywords collide
+constexpr unsigned kwHash(string_view s) { return (s.size() * 6 + s[0] + s[1] * 4) & 63; }
+constexpr auto kwTable = [] {
+    array<TokenType, 64> t{};
+    for (int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+        if (t[kwHash(keywords[i])] != INVALID) throw "keyword hash collision";
+        t[kwHash(keywords[i])] = static_cast<TokenType>(i + 1);
+    }
+    return t;
+}();
+constexpr TokenType keyword(string_view s) {
+    if (s.size() < 2 || s.size() > 11) return INVALID;
+    auto k = kwTable[kwHash(s)];
+    return k != INVALID && keywords[k - 1] == s ? k : INVALID;
+}
+
+constexpr pair<string_view, TokenType> operators[] = {
+    {"+",OP_ADD},       {"+=",OP_ADDAGN},   {"++",OP_INC},      {"&",OP_BITAND},    {"&=",OP_ANDAGN},
+    {"&&",OP_AND},      {"&^",OP_ANDXOR},   {"&^=",OP_ANDXORAGN},{"=",OP_AGN},      {"==",OP_EQ},
+    {"!",OP_NOT},       {"!=",OP_NE},       {"(",OP_LPAREN},    {")",OP_RPAREN},    {"-",OP_SUB},
+    {"-=",OP_SUBAGN},   {"--",OP_DEC},      {"|",OP_BITOR},     {"|=",OP_ORAGN},    {"||",OP_OR},
+    {"<",OP_LT},        {"<=",OP_LE},       {"<-",OP_CHAN},     {"<<",OP_LSHIFT},   {"<<=",OP_LSFTAGN},
+    {"[",OP_LBRACKET},  {"]",OP_RBRACKET},  {"*",OP_MUL},       {"*=",OP_MULAGN},   {"^",OP_XOR},
+    {"^=",OP_XORAGN},   {">",OP_GT},        {">=",OP_GE},       {">>",OP_RSHIFT},   {">>=",OP_RSFTAGN},
+    {"{",OP_LBRACE},    {"}",OP_RBRACE},    {":",OP_COLON},     {":=",OP_SHORTAGN}, {",",OP_COMMA},
+    {";",OP_SEMI},      {"%",OP_MOD},       {"%=",OP_MODAGN},   {"/",OP_DIV},       {"/=",OP_DIVAGN},
+    {".",OP_DOT},       {"...",OP_VARIADIC},
+};
+// DFA of operators whose states are nodes of the operator trie, lexer walks it in maximal munch way
+struct OperatorDFA {
+    uint8_t column[256]{};      // operator character -> input column, 0 stands for non-operator character
+    uint8_t next[64][24]{};     // (state, column) -> state, 0 stands for no transition
+    TokenType accept[64]{};     // token recognized when stopping at the state, INVALID if none
+};
+constexpr auto opDFA = [] {
+    OperatorDFA d{};
+    int states = 1, columns = 1;
+    for (const auto&[spelling, type] : operators) {
+        int s = 0;
+        for (char c : spelling) {
+            auto& col = d.column[static_cast<unsigned char>(c)];
+            if (col == 0) col = columns++;
+            if (d.next[s][col] == 0) d.next[s][col] = states++;
+            s = d.next[s][col];
+        }
+        d.accept[s] = type;
+    }
+    if (states > 64 || columns > 24) throw "operator DFA overflow";
+    return d;
+}();
+
+constexpr auto tokenSpelling = [] {
+    array<string_view, LIT_STR + 1> t{};
+    for (int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) t[i + 1] = keywords[i];
+    for (const auto&[spelling, type] : operators) t[type] = spelling;
+    t[INVALID] = "<invalid>"; t[TK_ID] = "identifier"; t[LIT_INT] = "integer literal";
+    t[LIT_FLOAT] = "float literal"; t[LIT_IMG] = "imaginary literal"; t[LIT_RUNE] = "rune literal";
+    t[LIT_STR] = "string literal";
+    return t;
+}();
+constexpr string_view spelling(int type) { return type == TK_EOF ? "EOF" : tokenSpelling[type]; }
+
+// binary operators have five precedence levels, 0 stands for the token is not a binary operator
+constexpr auto binaryPrecedence = [] {
+    array<int8_t, LIT_STR + 1> t{};
+    for (auto k : { OP_MUL, OP_DIV, OP_MOD, OP_LSHIFT, OP_RSHIFT, OP_BITAND, OP_ANDXOR }) t[k] = 5;
+    for (auto k : { OP_ADD, OP_SUB, OP_BITOR, OP_XOR }) t[k] = 4;
+    for (auto k : { OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE }) t[k] = 3;
+    t[OP_AND] = 2;
+    t[OP_OR] = 1;
+    return t;
+}();
+constexpr int precedence(int type) { return type > 0 ? binaryPrecedence[type] : 0; }
+
+// a newline becomes a semicolon if the line's final token is one of them
+constexpr auto autoSemicolon = [] {
+    array<bool, LIT_STR + 1> t{};
+    for (auto k : { TK_ID, LIT_INT, LIT_FLOAT, LIT_IMG, LIT_RUNE, LIT_STR, KW_fallthrough, KW_continue,
+        KW_return, KW_break, OP_INC, OP_DEC, OP_RPAREN, OP_RBRACKET, OP_RBRACE }) t[k] = true;
+    return t;
+}();
+#pragma endregion
+//===---------------------------------------------------------------------------------------===//
+// bulk scanning kernels used by the lexer to skip blanks, comments, identifiers and strings
+//===---------------------------------------------------------------------------------------===//
+#pragma region Scan
+struct ScanKernel {
+    const char* (*find)(const char* p, const char* end, char a, char b, char c, char d);// first of {a,b,c,d}
+    const char* (*skipBlank)(const char* p, const char* end);   // first byte which is not ' ', '\t' or '\r'
+    const char* (*skipIdent)(const char* p, const char* end);   // first byte which is not [A-Za-z0-9_]
+    size_t (*count)(const char* p, const char* end, char a);
+    uint64_t (*bodyMask)(const char* p, const char* end);       // bit i is set if p[i] is of CC_BODY
 };
+static inline int ctz64(uint64_t m) {
+#ifdef _MSC_VER
+    unsigned long i; _BitScanForward64(&i, m); return static_cast<int>(i);
+#else
+    return __builtin_ctzll(m);
+#endif
+}
+static const char* findScalar(const char* p, const char* end, char a, char b, char c, char d) {
+    while (p < end && *p != a && *p != b && *p != c && *p != d) p++;
+    return p;
+}
+static const char* skipBlankScalar(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+static const char* skipIdentScalar(const char* p, const char* end) {
+    while (p < end && isa(*p, CC_ID | CC_DIGIT)) p++;
+    return p;
+}
+static size_t countScalar(const char* p, const char* end, char a) {
+    size_t n = 0;
+    for (; p < end; p++) n += *p == a;
+    return n;
+}
+static uint64_t bodyMaskScalar(const char* p, const char* end) {
+    uint64_t m = 0;
+    for (int i = 0; i < 64 && p + i < end; i++) m |= static_cast<uint64_t>(isa(p[i], CC_BODY)) << i;
+    return m;
+}
+#ifdef G5_SSE2
+static inline int ctz(unsigned m) {
+#ifdef _MSC_VER
+    unsigned long i; _BitScanForward(&i, m); return static_cast<int>(i);
+#else
+    return __builtin_ctz(m);
+#endif
+}
+static const char* findSSE2(const char* p, const char* end, char a, char b, char c, char d) {
+    const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b), vc = _mm_set1_epi8(c), vd = _mm_set1_epi8(d);
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int m = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)),
+            _mm_or_si128(_mm_cmpeq_epi8(x, vc), _mm_cmpeq_epi8(x, vd))));
+        if (m) return p + ctz(m);
+    }
+    return findScalar(p, end, a, b, c, d);
+}
+static const char* skipBlankSSE2(const char* p, const char* end) {
+    const __m128i sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), cr = _mm_set1_epi8('\r');
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int m = ~_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, sp), _mm_cmpeq_epi8(x, tab)),
+            _mm_cmpeq_epi8(x, cr))) & 0xffff;
+        if (m) return p + ctz(m);
+    }
+    return skipBlankScalar(p, end);
+}
+static const char* skipIdentSSE2(const char* p, const char* end) {
+    const __m128i a = _mm_set1_epi8('a' - 1), z = _mm_set1_epi8('z' + 1), zero = _mm_set1_epi8('0' - 1),
+        nine = _mm_set1_epi8('9' + 1), under = _mm_set1_epi8('_'), lower = _mm_set1_epi8(0x20);
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), l = _mm_or_si128(x, lower);
+        __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(l, a), _mm_cmplt_epi8(l, z));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(x, zero), _mm_cmplt_epi8(x, nine));
+        int m = ~_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), _mm_cmpeq_epi8(x, under))) & 0xffff;
+        if (m) return p + ctz(m);
+    }
+    return skipIdentScalar(p, end);
+}
+static size_t countSSE2(const char* p, const char* end, char a) {
+    const __m128i va = _mm_set1_epi8(a);
+    size_t n = 0;
+    for (; end - p >= 16; p += 16) {
+        unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), va));
+        for (; m; m &= m - 1) n++;
+    }
+    return n + countScalar(p, end, a);
+}
+static uint64_t bodyMaskSSE2(const char* p, const char* end) {
+    if (end - p < 64) return bodyMaskScalar(p, end);
+    const __m128i lb = _mm_set1_epi8('{'), rb = _mm_set1_epi8('}'), dq = _mm_set1_epi8('"'),
+        sq = _mm_set1_epi8('\''), bq = _mm_set1_epi8('`'), sl = _mm_set1_epi8('/');
+    uint64_t m = 0;
+    for (int i = 0; i < 64; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        m |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(x, lb), _mm_cmpeq_epi8(x, rb)), _mm_or_si128(_mm_cmpeq_epi8(x, dq),
+            _mm_cmpeq_epi8(x, sq))), _mm_or_si128(_mm_cmpeq_epi8(x, bq), _mm_cmpeq_epi8(x, sl))))) << i;
+    }
+    return m;
+}
+#endif
+#ifdef G5_AVX2
+#pragma GCC push_options
+#pragma GCC target("avx2")
+static const char* findAVX2(const char* p, const char* end, char a, char b, char c, char d) {
+    const __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b), vc = _mm256_set1_epi8(c),
+        vd = _mm256_set1_epi8(d);
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned m = _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, va),
+            _mm256_cmpeq_epi8(x, vb)), _mm256_or_si256(_mm256_cmpeq_epi8(x, vc), _mm256_cmpeq_epi8(x, vd))));
+        if (m) return p + ctz(m);
+    }
+    return findScalar(p, end, a, b, c, d);
+}
+static const char* skipBlankAVX2(const char* p, const char* end) {
+    const __m256i sp = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t'), cr = _mm256_set1_epi8('\r');
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned m = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(
+            _mm256_cmpeq_epi8(x, sp), _mm256_cmpeq_epi8(x, tab)), _mm256_cmpeq_epi8(x, cr))));
+        if (m) return p + ctz(m);
+    }
+    return skipBlankScalar(p, end);
+}
+static const char* skipIdentAVX2(const char* p, const char* end) {
+    const __m256i a = _mm256_set1_epi8('a' - 1), z = _mm256_set1_epi8('z' + 1), zero = _mm256_set1_epi8('0' - 1),
+        nine = _mm256_set1_epi8('9' + 1), under = _mm256_set1_epi8('_'), lower = _mm256_set1_epi8(0x20);
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), l = _mm256_or_si256(x, lower);
+        __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(l, a), _mm256_cmpgt_epi8(z, l));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(x, zero), _mm256_cmpgt_epi8(nine, x));
+        unsigned m = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit),
+            _mm256_cmpeq_epi8(x, under))));
+        if (m) return p + ctz(m);
+    }
+    return skipIdentScalar(p, end);
+}
+static size_t countAVX2(const char* p, const char* end, char a) {
+    const __m256i va = _mm256_set1_epi8(a);
+    size_t n = 0;
+    for (; end - p >= 32; p += 32)
+        n += __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), va))));
+    return n + countScalar(p, end, a);
+}
+static uint64_t bodyMaskAVX2(const char* p, const char* end) {
+    if (end - p < 64) return bodyMaskScalar(p, end);
+    const __m256i lb = _mm256_set1_epi8('{'), rb = _mm256_set1_epi8('}'), dq = _mm256_set1_epi8('"'),
+        sq = _mm256_set1_epi8('\''), bq = _mm256_set1_epi8('`'), sl = _mm256_set1_epi8('/');
+    uint64_t m = 0;
+    for (int i = 0; i < 64; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        m |= static_cast<uint64_t>(static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, lb), _mm256_cmpeq_epi8(x, rb)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, dq), _mm256_cmpeq_epi8(x, sq))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, bq), _mm256_cmpeq_epi8(x, sl)))))) << i;
+    }
+    return m;
+}
+#pragma GCC pop_options
+#endif
+// The widest kernel supported by current cpu is chosen, G5_SIMD=scalar|sse2|avx2 forces one of them
+static const ScanKernel scan = [] {
+    const char* force = getenv("G5_SIMD");
+    auto want = [&](const char* isa) { return force == nullptr || string_view(force) == isa; };
+#ifdef G5_AVX2
+    if (want("avx2") && __builtin_cpu_supports("avx2"))
+        return ScanKernel{ findAVX2, skipBlankAVX2, skipIdentAVX2, countAVX2, bodyMaskAVX2 };
+#endif
+#ifdef G5_SSE2
+    if (want("sse2")) return ScanKernel{ findSSE2, skipBlankSSE2, skipIdentSSE2, countSSE2, bodyMaskSSE2 };
+#endif
+    return ScanKernel{ findScalar, skipBlankScalar, skipIdentScalar, countScalar, bodyMaskScalar };
+}();
 #pragma endregion
 //===---------------------------------------------------------------------------------------===//
 // Implementation of golang compiler and runtime within 5 explicit functions
 //===---------------------------------------------------------------------------------------===//
-Token next(fstream& f) {
+Token next(Lexer& f) {
+    int& line = f.line, &column = f.column;
+    auto token = [&](TokenType type, string_view lexeme) {
+        f.lastToken = type;
+        return Token(type, lexeme, type >= TK_ID ? symbols.intern(lexeme) : Symbol{});
+    };
     auto consumePeek = [&](char& c) {
-        f.get();
+        if (f.cur < f.end) f.cur++;
         column++;
         char oc = c;
-        c = static_cast<char>(f.peek());
+        c = f.peek();
         return oc;
     };
-    auto c = static_cast<char>(f.peek());
+    auto c = f.peek();
+    const char* begin;
+    auto lexeme = [&] { return string_view(begin, f.cur - begin); };
+    auto skipTo = [&](const char* p) { column += static_cast<int>(p - f.cur); f.cur = p; c = f.peek(); };
 skip_comment_and_find_next:
-    for (; anyone(c, ' ', '\r', '\t', '\n'); column++) {
+    while (isa(c, CC_SPACE)) {
         if (c == '\n') {
             line++;
             column = 1;
-            if (anyone(lastToken, TK_ID, LIT_INT, LIT_FLOAT, LIT_IMG, LIT_RUNE, LIT_STR, KW_fallthrough,
-                KW_continue, KW_return, KW_break, OP_INC, OP_DEC, OP_RPAREN, OP_RBRACKET, OP_RBRACE)) {
+            if (f.lastToken > 0 && autoSemicolon[f.lastToken]) {
                 consumePeek(c);
-                return Token(OP_SEMI, ";");
+                return token(OP_SEMI, ";");
             }
+            consumePeek(c);
+            column++;
+        } else {    // blanks are counted twice in column since the very beginning, keep it unchanged
+            auto* p = scan.skipBlank(f.cur, f.end);
+            column += static_cast<int>(p - f.cur);
+            skipTo(p);
         }
-        consumePeek(c);
     }
     if (f.eof()) {
-        if (shouldEof) return Token(TK_EOF, "");
-        shouldEof = 1;
-        return Token(OP_SEMI, ";");
+        if (f.shouldEof) return token(TK_EOF, "");
+        f.shouldEof = 1;
+        return token(OP_SEMI, ";");
     }
-    string lexeme;
+    begin = f.cur;
     // identifier
-    if (inrange(c, 'a', 'z') || inrange(c, 'A', 'Z') || c == '_') {
-        while (inrange(c, 'a', 'z') || inrange(c, 'A', 'Z') || inrange(c,'0','9') || c == '_') {
-            lexeme += consumePeek(c);
-        }
-
-        for (int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++)
-            if (keywords[i] == lexeme)  return Token(static_cast<TokenType>(i + 1), lexeme);
-        return Token(TK_ID, lexeme);
+    if (isa(c, CC_ID)) {
+        skipTo(scan.skipIdent(f.cur + 1, f.end));
+        if (auto kw = keyword(lexeme()); kw != INVALID) return token(kw, lexeme());
+        return token(TK_ID, lexeme());
     }
     // decimal 
-    if (c >= '0'&&c <= '9' || c == '.') {
+    if (isa(c, CC_DIGIT) || (c == '.' && f.cur + 1 < f.end && isa(f.cur[1], CC_DIGIT))) {
         TokenType type = LIT_INT;
         if (c == '0') {
-            lexeme += consumePeek(c);
+            consumePeek(c);
             if (c == 'x' || c == 'X') {
                 do {
-                    lexeme += consumePeek(c);
-                } while (inrange(c, '0', '9') || inrange(c, 'a', 'f') || inrange(c, 'A', 'F'));
-                return Token(LIT_INT, lexeme);
-            } else if (inrange(c, '0', '9') || anyone(c, '.', 'e', 'E', 'i')) {
-                while (inrange(c, '0', '9') || anyone(c, '.', 'e', 'E', 'i')) {
-                    if (inrange(c, '0', '7')) {
-                        lexeme += consumePeek(c);
+                    consumePeek(c);
+                } while (isa(c, CC_HEX));
+                return token(LIT_INT, lexeme());
+            } else if (isa(c, CC_NUM)) {
+                while (isa(c, CC_NUM)) {
+                    if (isa(c, CC_OCT)) {
+                        consumePeek(c);
                     } else {
                         goto shall_float;
                     }
                 }
-                return Token(LIT_INT, lexeme);
+                return token(LIT_INT, lexeme());
             }
-            goto may_float;
-        } else {  // 1-9 or . or just a single 0
-        may_float:
+            return token(type, lexeme());
+        } else {  // 1-9 or .
             if (c == '.') {
-                lexeme += consumePeek(c);
-                if (c == '.') {
-                    lexeme += consumePeek(c);
-                    if (c == '.') {
-                        lexeme += consumePeek(c);
-                        return Token(OP_VARIADIC, lexeme);
-                    } else G_ERROR("lex error", "expect variadic notation(...)");
-                } else if (inrange(c, '0', '9')) {
+                consumePeek(c);
+                type = LIT_FLOAT;
+            } else {
+                consumePeek(c);
+            }
+        shall_float:  // skip char consuming since we did that before jumping here;
+            bool hasDot = false, hasExponent = false;
+            while (isa(c, CC_NUM)) {
+                if (isa(c, CC_DIGIT)) {
+                    consumePeek(c);
+                } else if (c == '.' && !hasDot) {
+                    consumePeek(c);
+                    type = LIT_FLOAT;
+                } else if ((c == 'e' && !hasExponent) || (c == 'E' && !hasExponent)) {
+                    hasExponent = true;
                     type = LIT_FLOAT;
+                    consumePeek(c);
+                    if (c == '+' || c == '-') consumePeek(c);
                 } else {
-                    return Token(OP_DOT, lexeme);
-                }
-                goto shall_float;
-            } else if (inrange(c, '1', '9')) {
-                lexeme += consumePeek(c);
-            shall_float:  // skip char consuming and appending since we did that before jumping here;
-                bool hasDot = false, hasExponent = false;
-                while (inrange(c, '0', '9') || anyone(c, '.', 'e', 'E', 'i')) {
-                    if (inrange(c, '0', '9')) {
-                        lexeme += consumePeek(c);
-                    } else if (c == '.' && !hasDot) {
-                        lexeme += consumePeek(c);
-                        type = LIT_FLOAT;
-                    } else if ((c == 'e' && !hasExponent) || (c == 'E' && !hasExponent)) {
-                        hasExponent = true;
-                        type = LIT_FLOAT;
-                        lexeme += consumePeek(c);
-                        if (c == '+' || c == '-') lexeme += consumePeek(c);
-                    } else {
-                        f.get();
-                        column++;
-                        lexeme += c;
-                        return Token(LIT_IMG, lexeme);
-                    }
+                    consumePeek(c);
+                    return token(LIT_IMG, lexeme());
                 }
-                return Token(type, lexeme);
-            } else return Token(type, lexeme);
+            }
+            return token(type, lexeme());
         }
     }
     // literal
     if (c == '\'') {
-        lexeme += consumePeek(c);
+        consumePeek(c);
         if (c == '\\') {
-            lexeme += consumePeek(c);
+            consumePeek(c);
             if (anyone(c, 'U', 'u', 'X', 'x'))
-                do lexeme += consumePeek(c); 
-                while (inrange(c, '0', '9') || inrange(c, 'A', 'F') || inrange(c, 'a', 'f'));
-            else if (inrange(c, '0', '7'))
-                do lexeme += consumePeek(c); while (inrange(c, '0', '7'));
+                do consumePeek(c); while (isa(c, CC_HEX));
+            else if (isa(c, CC_OCT))
+                do consumePeek(c); while (isa(c, CC_OCT));
             else if (anyone(c, 'a', 'b', 'f', 'n', 'r', 't', 'v', '\\', '\'', '"'))
-                lexeme += consumePeek(c);
+                consumePeek(c);
             else G_ERROR("lex error", "illegal rune");
-        } else lexeme += consumePeek(c);
+        } else consumePeek(c);
 
         G_ASSERT(c != '\'', "lexer error", "illegal rune");
-        lexeme += consumePeek(c);
-        return Token(LIT_RUNE, lexeme);
+        consumePeek(c);
+        return token(LIT_RUNE, lexeme());
     }
     // string literal
     if (c == '`') {
-        do {
-            lexeme += consumePeek(c);
-            if (c == '\n') line++;
-        } while (f.good() && c != '`');
+        auto* close = scan.find(f.cur + 1, f.end, '`', '`', '`', '`');
+        line += static_cast<int>(scan.count(f.cur + 1, close, '\n'));
+        skipTo(close);
         G_ASSERT(c != '`', "lexer error", "raw string literal does not have a closed symbol \"`\"");
-        lexeme += consumePeek(c);
-        return Token(LIT_STR, lexeme);
+        consumePeek(c);
+        return token(LIT_STR, lexeme());
     } else if (c == '"') {
-        do {
-            lexeme += consumePeek(c);
-            if (c == '\\') {
-                lexeme += consumePeek(c);
-                lexeme += consumePeek(c);
-            }
-        } while (f.good() && (c != '\n' && c != '\r' && c != '"'));
+        auto* p = scan.find(f.cur + 1, f.end, '\\', '"', '\n', '\r');
+        while (p < f.end && *p == '\\') {
+            p += 2;     // skip escaped char, the char following them is only checked as a terminator
+            if (p >= f.end || anyone(*p, '"', '\n', '\r')) break;
+            p = scan.find(p + 1, f.end, '\\', '"', '\n', '\r');
+        }
+        column += static_cast<int>(p - f.cur);  // consumePeek counts columns even if it reaches EOF
+        f.cur = min(p, f.end);
+        c = f.peek();
         G_ASSERT(c != '"', "lexer error", "string literal does not have a closed symbol");
-        lexeme += consumePeek(c);
-        return Token(LIT_STR, lexeme);
-    }
-
-    auto match = [&](initializer_list<tuple<pair<char, TokenType>,initializer_list<pair<string_view, TokenType>>,
-        pair<string_view, TokenType>>> big) ->Token {
-        for (const auto&[v1, v2, v3] : big) {
-            if (c == v1.first) {
-                lexeme += consumePeek(c);
-                for (const auto &[v2str, v2type] : v2) {
-                    if (c == v2str[1]) {
-                        lexeme += consumePeek(c);
-                        if (const auto&[v3str, v3type] = v3; v3type != INVALID) {
-                            if (c == v3str[2]) {
-                                lexeme += consumePeek(c);
-                                return Token(v3type, lexeme);
-                            }
-                        }
-                        return Token(v2type, lexeme);
-                    }
-                }
-                return Token(v1.second, lexeme);
+        consumePeek(c);
+        return token(LIT_STR, lexeme());
+    }
+    // comments
+    if (c == '/' && f.cur + 1 < f.end && (f.cur[1] == '/' || f.cur[1] == '*')) {
+        consumePeek(c);
+        if (c == '/') {
+            skipTo(scan.find(f.cur + 1, f.end, '\n', '\r', '\n', '\r'));
+            goto skip_comment_and_find_next;
+        }
+        for (auto* p = f.cur + 1;; p += 2) {  // the char right after a '*' is consumed without checking
+            p = scan.find(p, f.end, '\n', '*', '\n', '*');
+            while (p < f.end && *p == '\n') line++, p = scan.find(p + 1, f.end, '\n', '*', '\n', '*');
+            if (p >= f.end) {
+                skipTo(f.end);
+                break;
+            }
+            if (p + 1 < f.end && p[1] == '/') {
+                skipTo(p + 2);
+                goto skip_comment_and_find_next;
             }
         }
-        return Token(INVALID, "");
-    };
+        return token(OP_DIV, string_view(begin, 1));
+    }
     // operators
-    if(c=='/') { // special case for /  /= // /*...*/
-        char pending = consumePeek(c);
-        if (c == '=') {
-            lexeme += pending;
-            lexeme += consumePeek(c);
-            return Token(OP_DIVAGN, lexeme);
-        } else if (c == '/') {
-            do consumePeek(c); while (f.good() && (c != '\n' && c != '\r'));
-            goto skip_comment_and_find_next;
-        } else if (c == '*') {
-            do {
-                consumePeek(c);
-                if (c == '\n') line++;
-                if (c == '*') {
-                    consumePeek(c);
-                    if (c == '/') {
-                        consumePeek(c);
-                        goto skip_comment_and_find_next;
-                    }
-                }
-            } while (f.good());
-        }
-        lexeme += pending;
-        return Token(OP_DIV, lexeme);
-    }
-    auto result = match({
-        {{ '+',OP_ADD },    {{"+=",OP_ADDAGN} ,{"++",OP_INC}},                  {}},
-        {{'&',OP_BITAND},   {{"&=",OP_ANDAGN},{"&&",OP_AND},{"&^",OP_ANDXOR}},  {"&^=",OP_ANDXORAGN}},
-        {{'=',OP_AGN},      {{"==",OP_EQ}},                                     {}},
-        {{'!',OP_NOT},      {{"!=",OP_NE}},                                     {}},
-        {{'(',OP_LPAREN},   {},                                                 {}},
-        {{')',OP_RPAREN},   {},                                                 {}},
-        {{'-',OP_SUB},      {{"-=",OP_SUBAGN},{"--",OP_DEC}},                   {}},
-        {{'|',OP_BITOR},    {{"|=",OP_ORAGN},{"||",OP_OR}},                     {}},
-        {{'<',OP_LT},       {{"<=",OP_LE},{"<-",OP_CHAN},{"<<",OP_LSHIFT}},     {"<<=",OP_LSFTAGN}},
-        {{'[',OP_LBRACKET}, {},                                                 {}},
-        {{']',OP_RBRACKET}, {},                                                 {}},
-        {{'*',OP_MUL},      {{"*=",OP_MULAGN}},                                 {}},
-        {{'^',OP_XOR},      {{"^=",OP_XORAGN}},                                 {}},
-        {{'>',OP_GT},       {{">=",OP_GE},{">>",OP_RSHIFT}},                    {">>=",OP_RSFTAGN}},
-        {{'{',OP_LBRACE},   {},                                                 {}},
-        {{'}',OP_RBRACE},   {},                                                 {}},
-        {{':',OP_COLON},    {{":=",OP_SHORTAGN}},                               {}},
-        {{',',OP_COMMA},    {},                                                 {}},
-        {{';',OP_SEMI},     {},                                                 {}},
-        {{'%',OP_MOD},      {{"%=",OP_MODAGN}},                                 {}},
-    });
-    if (result.type != INVALID) { return result; }
-    else G_ERROR("lex error", "illegal token in source file");
+    int state = 0;
+    for (int s; (s = opDFA.next[state][opDFA.column[static_cast<unsigned char>(c)]]) != 0; state = s) 
+        consumePeek(c);
+    if (auto type = opDFA.accept[state]; type != INVALID) return token(type, lexeme());
+    G_ASSERT(state != 0, "lex error", "expect variadic notation(...)");
+    Diagnostic illegal{ "lex error", "illegal token in source file", line, column };
+    consumePeek(c);     // lexing goes on after the illegal char once it's reported
+    throw illegal;
 }
 
-const auto parse(const string & filename) {
-    fstream f(filename, ios::binary | ios::in);
-    auto t = next(f);
+// Tokens of a whole file lexed up front as struct of arrays, so that the parser reads them linearly
+// and could look ahead arbitrarily. Positions are byte offsets, the table of line starts is built
+// only when a diagnostic asks for line and column
+struct TokenBuffer {
+    const char* src{}, *end{};
+    vector<int8_t> type;
+    vector<uint32_t> offset;
+    vector<uint32_t> extra;         // symbol of identifiers and literals, lexeme length of the others
+    vector<uint32_t> lineStart;
+    vector<Diagnostic> errors;      // lexing goes on after them
+    TokenBuffer() = default;
+    explicit TokenBuffer(Lexer& f) :src(f.begin), end(f.end) {
+        const size_t hint = (f.end - f.begin) / 5;  // official corpus has a token per 5.7 bytes
+        type.reserve(hint); offset.reserve(hint); extra.reserve(hint);
+        for (Token tk(INVALID, ""); tk.type != TK_EOF;) {
+            try { tk = next(f); } catch (Diagnostic& d) { errors.push_back(d); continue; }
+            const bool inSource = tk.lexeme.data() >= src && tk.lexeme.data() < end;   // or ";" and ""
+            type.push_back(static_cast<int8_t>(tk.type));
+            offset.push_back(static_cast<uint32_t>((inSource ? tk.lexeme.data() : f.cur) - src));
+            extra.push_back(tk.type >= TK_ID ? tk.sym.id : inSource ? static_cast<uint32_t>(tk.lexeme.size()) : 0);
+        }
+    }
+    size_t size() const { return type.size(); }
+    Token operator[](size_t i) const {     // tokens past the end are all EOF
+        i = min(i, type.size() - 1);
+        const auto tk = static_cast<TokenType>(type[i]);
+        if (tk >= TK_ID) {
+            const Symbol sym{ extra[i] };
+            return Token(tk, string_view(src + offset[i], sym.str().size()), sym);
+        }
+        if (extra[i] == 0) return Token(tk, tk == OP_SEMI ? ";" : "");
+        return Token(tk, string_view(src + offset[i], extra[i]));
+    }
+    pair<int, int> position(size_t i) {
+        if (lineStart.empty()) {
+            lineStart.push_back(0);
+            for (const char* p = src; (p = scan.find(p, end, '\n', '\n', '\n', '\n')) < end; p++)
+                lineStart.push_back(static_cast<uint32_t>(p + 1 - src));
+        }
+        const uint32_t off = offset[min(i, type.size() - 1)];
+        const auto line = upper_bound(lineStart.begin(), lineStart.end(), off) - lineStart.begin();
+        return { static_cast<int>(line), static_cast<int>(off - lineStart[line - 1]) + 1 };
+    }
+};
+
+// Stream lexes a token whenever the parser asks for one, Buffer lexes the whole file up front into
+// a TokenBuffer, and Lazy streams but skips bodies of function declarations, see LazyBlock
+enum class ParseMode : uint8_t { Stream, Buffer, Lazy };
 
-    auto eat = [&](TokenType tk) {
-        G_ASSERT(t.type != tk, "syntax ", "expect " + keywords[tk - 1] + "but got " + keywords[t.type - 1]);
-        t = next(f);
-    };
+// Recursive descent parser, every grammar rule is a member function so that calls among them
+// could be resolved statically and inlined by compiler
+struct Parser {
+    Lexer f;
+    CompilationUnit* unit;
+    ArenaScope scope;
+    bool lazy = false;      // skip bodies of function declarations, see LazyBlock
+    bool buffered = false;  // lex the whole file into tokens once parsing starts
+    TokenBuffer tokens;     // the whole file pre-lexed, unless it's streamed from f
+    size_t cursor = 0;
+    Token t;
+    int nestLev = 0;
+    size_t consumed = 0;    // tokens so far, a repetition must make progress
+    size_t errorBase = 0;   // diagnostics of the unit before this parser, a lazy body counts only its own
+    struct { const char* cur; int line, column, last; } lexed{};  // lexer state before t, if it's streamed
+    bool readAll = false;   // skipBlock() looked for '}' up to the end of source in vain
+    // G_ERROR reports the position by them. The streaming lexer tracks its line and column while
+    // buffered tokens look them up only then
+    struct Coordinate {
+        Parser* p; bool isColumn;
+        operator int() const {
+            if (p->tokens.size() == 0) return isColumn ? p->f.column : p->f.line;
+            auto[line, column] = p->tokens.position(p->cursor - 1);
+            return isColumn ? column : line;
+        }
+    } line{ this, false }, column{ this, true };
+    static constexpr size_t maxErrors = 10;     // like gc does
+    explicit Parser(const string& filename, ParseMode mode = ParseMode::Stream)
+        :f(filename), unit(new CompilationUnit), scope(unit->arena), lazy(mode == ParseMode::Lazy),
+        buffered(mode == ParseMode::Buffer), t(INVALID, "") {}
+    Parser(CompilationUnit* unit, size_t offset, int line, int column, int last)    // text of unit from offset on
+        :f(string_view(unit->text).substr(offset), line, column, last), unit(unit), scope(unit->arena),
+        lazy(unit->lazy), t(INVALID, "") {}
+    explicit Parser(const LazyBlock& body)   // resume right after '{' of a skipped body
+        :f(body.text.substr(1), body.line, body.column, OP_LBRACE), unit(body.unit), scope(unit->arena),
+        t(OP_LBRACE, body.text.substr(0, 1)), nestLev(1), errorBase(body.unit->diagnostics.size()) {}
+    Token next() {  // lex errors are reported and the lexer moves on, the grammar never sees them
+        consumed++;
+        if (tokens.size() != 0) return tokens[cursor++];
+        for (;;) try { lexed = { f.cur, f.line, f.column, f.lastToken }; return ::next(f); } catch (Diagnostic& d) { report(d); }
+    }
+    void report(const Diagnostic& d) {
+        unit->diagnostics.push_back(d);
+        if (unit->diagnostics.size() - errorBase >= maxErrors) throw TooManyErrors{};
+    }
+    // Error recovery, skip the rest of a broken statement up to ';' or to '}' or case clause that
+    // ends the enclosing block
+    void syncStmt() {
+        for (int depth = 0; t.type != TK_EOF; t = next()) {
+            if (anyone(t.type, OP_LBRACE, OP_LPAREN, OP_LBRACKET)) depth++;
+            else if (anyone(t.type, OP_RPAREN, OP_RBRACKET)) depth = max(depth - 1, 0);
+            else if (t.type == OP_RBRACE && depth-- == 0) return;
+            else if (depth == 0 && t.type == OP_SEMI) { t = next(); return; }
+            else if (depth == 0 && anyone(t.type, KW_case, KW_default)) return;
+        }
+    }
+    // and skip a broken declaration up to a keyword which starts a line outside of braces
+    void syncDecl() {
+        for (int depth = 0, last = OP_SEMI; t.type != TK_EOF; last = t.type, t = next()) {
+            if (t.type == OP_LBRACE) depth++;
+            else if (t.type == OP_RBRACE) depth = max(depth - 1, 0);
+            else if (depth == 0 && last == OP_SEMI && anyone(t.type, KW_func, KW_var, KW_const, KW_type, KW_import))
+                return;
+        }
+    }
+    TokenType peek(size_t k = 1) const {   // type of the k-th token after t, buffered parsers only
+        return static_cast<TokenType>(tokens.type[min(cursor - 1 + k, tokens.size() - 1)]);
+    }
+    string_view str(string_view s) { return unit->arena.str(s); }     // lexemes die with Source
+    Symbol sym() const { return t.type >= TK_ID ? t.sym : symbols.intern(t.lexeme); }  // of current token
+    void eat(TokenType tk) {
+        G_ASSERT(t.type != tk, "syntax error", "expect " + string(spelling(tk)) + " but got " + string(spelling(t.type)));
+        t = next();
+    }
     // Simulate EBNF behaviors, see g5/docs/ebnf.md for their explanation if you don't know
     // They are merely used in the case of simple parsing tasks, while keeping traditional control
     // flows for those complicated tasks since callback is not enough clear to read for human logic
-    auto option = [&](TokenType specific,auto then) {
-        if (t.type == specific) { t = next(f); then(); }};
-    auto repetition = [&](TokenType endToken, auto work) {
-        do { work(); } while (t.type != endToken); t = next(f); };
-    auto alternation = [&](TokenType specific, auto then, auto otherwise) {
-        if (t.type == specific) { t = next(f); then(); } else { otherwise(); }}; 
-
-    LAMBDA_FUN(LitValue);LAMBDA_FUN(Stmt); LAMBDA_FUN(IfStmt);
-    function<Expr*(Token&)> parseType, parseUnaryExpr, parsePrimaryExpr,parseExpr;
+    template<typename F> void option(TokenType specific, F then) {
+        if (t.type == specific) { t = next(); then(); }}
+    template<typename F> void repetition(TokenType endToken, F work) {
+        do {
+            const size_t before = consumed;
+            work();
+            G_ASSERT(t.type != endToken && (consumed == before || t.type == TK_EOF), "syntax error",
+                "expect " + string(spelling(endToken)) + " but got " + string(spelling(t.type)));
+        } while (t.type != endToken); t = next(); }
+    template<typename F, typename G> void alternation(TokenType specific, F then, G otherwise) {
+        if (t.type == specific) { t = next(); then(); } else { otherwise(); }}
 
 #pragma region Common
-    auto parseName = [&](bool couldFullName, Token&t) {
+    Symbol nameOf(Node* n) {    // where the grammar wants an identifier but parsed an expression
+        auto* name = as<Name>(n);
+        G_ASSERT(name == nullptr, "syntax error", "expect identifier");
+        return name->name;
+    }
+    Name* parseName(bool couldFullName) {
         Name * node{};
         if (t.type == TK_ID) {
             node = new Name;
-            string name;
-            name += t.lexeme;
-            t = next(f);
+            node->name = t.sym;
+            const string_view name = t.lexeme;
+            t = next();
             if (couldFullName && t.type == OP_DOT) {
-                t = next(f);
-                name.operator+=(".").operator+=(t.lexeme);
-                t = next(f);
+                t = next();
+                node->name = symbols.intern(string(name).append(".").append(t.lexeme));
+                t = next();
             }
-            node->name = name;
         }
         return node;
-    };
-    auto parseIdentList = [&](Token&t) {
-        vector<string> idents;
-        option(TK_ID, [&] {
-            idents.emplace_back(t.lexeme);
-            while (t.type == OP_COMMA) {
-                t = next(f);
-                idents.emplace_back(t.lexeme);
-                t = next(f);
-            }
-        });
+    }
+    avector<Symbol> parseIdentList() {
+        avector<Symbol> idents;
+        if (t.type != TK_ID) return idents;
+        idents.emplace_back(t.sym);
+        t = next();
+        while (t.type == OP_COMMA) {
+            t = next();
+            idents.emplace_back(sym());
+            t = next();
+        }
         return idents;
-    };
-    auto parseExprList = [&](Token&t) {
+    }
+    ExprList* parseExprList() {
         ExprList* node{};
-        if (auto* tmp = parseExpr(t); tmp != nullptr) {
+        if (auto* tmp = parseExpr(); tmp != nullptr) {
             node = new  ExprList;
             node->exprs.emplace_back(tmp);
             while (t.type == OP_COMMA) {
-                t = next(f);
-                node->exprs.emplace_back(parseExpr(t));
+                t = next();
+                node->exprs.emplace_back(parseExpr());
             }
         }
         return node;
-    };
-    auto parseStmtList = [&](Token&t) {
+    }
+    StmtList* parseStmtList() {
         StmtList * node{};
-        Stmt* tmp = nullptr;
-        while ((tmp = parseStmt(t))) {
+        for (Stmt* tmp;;) {
+            const int outLev = nestLev;
+            try {
+                if ((tmp = parseStmt()) == nullptr) {
+                    if (anyone(t.type, OP_RBRACE, KW_case, KW_default, TK_EOF)) break;
+                    G_ERROR("syntax error", "expect statement but got " + string(spelling(t.type)));
+                }
+            } catch (Diagnostic& d) {
+                report(d);
+                nestLev = outLev;
+                syncStmt();
+                continue;
+            }
             if (node == nullptr) node = new StmtList;
             node->stmts.push_back(tmp);
             option(OP_SEMI,[]{});
         }
         return node;
-    };
-    auto parseBlock = [&](Token&t){
+    }
+    StmtList* parseBlock() {
         StmtList * node{};
         option(OP_LBRACE, [&] {
-            alternation(OP_RBRACE, [&] {}, [&] {node = parseStmtList(t); eat(OP_RBRACE); });});
+            alternation(OP_RBRACE, [&] {}, [&] {node = parseStmtList(); eat(OP_RBRACE); });});
         return node;
-    };
+    }
 #pragma endregion
 #pragma region Declaration
-    auto parseImportDecl = [&](Token&t) {
+    ImportDecl* parseImportDecl() {
         auto node = new ImportDecl;
         eat(KW_import);
         alternation(OP_LPAREN, [&] { repetition(OP_RPAREN,[&] {
-            string importName, alias;
+            string_view importName, alias;
             if (anyone(t.type, OP_DOT, TK_ID)) {
                 alias = t.lexeme;
-                t = next(f);
+                t = next();
                 importName = t.lexeme;
             } else importName = t.lexeme;
             importName = importName.substr(1, importName.length() - 2);
-            node->imports[importName] = alias;
-            t = next(f);
+            node->imports[symbols.intern(importName)] = symbols.intern(alias);
+            t = next();
             option(OP_SEMI, [] {});
         });}, [&] {
-            string importName, alias;
+            string_view importName, alias;
             if (anyone(t.type, OP_DOT, TK_ID)) {
                 alias = t.lexeme;
-                t = next(f);
+                t = next();
                 importName = t.lexeme;
-                t = next(f);
+                t = next();
             } else {
                 importName = t.lexeme;
-                t = next(f);
+                t = next();
             }
             importName = importName.substr(1, importName.length() - 2);
-            node->imports[importName] = alias;
+            node->imports[symbols.intern(importName)] = symbols.intern(alias);
         });
         return node;
-    };
-    auto parseConstDecl = [&](Token&t){
+    }
+    ConstDecl* parseConstDecl() {
         auto * node = new ConstDecl;
         eat(KW_const);
         alternation(OP_LPAREN, [&] {repetition(OP_RPAREN, [&] {
-            node->idents.push_back(parseIdentList(t));
-            if (auto*tmp = parseType(t); tmp != nullptr)
+            node->idents.push_back(parseIdentList());
+            if (auto*tmp = parseType(); tmp != nullptr)
                 node->type.push_back(tmp);
             else
                 node->type.push_back(nullptr);
-            alternation(OP_AGN, [&] {node->exprs.push_back(parseExprList(t)); }, [&] {node->exprs.push_back(nullptr); });
+            alternation(OP_AGN, [&] {node->exprs.push_back(parseExprList()); }, [&] {node->exprs.push_back(nullptr); });
             option(OP_SEMI, [] {});
         });}, [&] {
-            node->idents.push_back(parseIdentList(t));
-            if (auto*tmp = parseType(t); tmp != nullptr)    node->type.push_back(tmp);
+            node->idents.push_back(parseIdentList());
+            if (auto*tmp = parseType(); tmp != nullptr)    node->type.push_back(tmp);
             else                                           node->type.push_back(nullptr);
-            alternation(OP_AGN, [&] {node->exprs.push_back(parseExprList(t)); }, [&] {node->exprs.push_back(nullptr); });
+            alternation(OP_AGN, [&] {node->exprs.push_back(parseExprList()); }, [&] {node->exprs.push_back(nullptr); });
             if (t.type != OP_SEMI) G_ERROR("syntax error", "expect an explicit semicolon");
         });
         return node;
-    };
-    auto parseTypeSpec = [&](Token&t) {
-        string ident;
-        Expr* type;
+    }
+    tuple<Symbol, Expr*> parseTypeSpec() {
+        Symbol ident;
+        Expr* type{};
         if (t.type == TK_ID) {
-            ident = t.lexeme;
-            t = next(f);
+            ident = t.sym;
+            t = next();
             option(OP_AGN, [] {});
-            type = parseType(t);
+            type = parseType();
         }
         return make_tuple(ident,type);
-    };
-    auto parseTypeDecl = [&](Token&t) {
+    }
+    TypeDecl* parseTypeDecl() {
         auto * node = new TypeDecl;
         eat(KW_type);
         alternation(OP_LPAREN, [&] {
-            repetition(OP_RPAREN, [&] {node->typeSpec.push_back(parseTypeSpec(t));option(OP_SEMI, [] {}); });
-        }, [&] {node->typeSpec.push_back(parseTypeSpec(t)); });
+            repetition(OP_RPAREN, [&] {node->typeSpec.push_back(parseTypeSpec());option(OP_SEMI, [] {}); });
+        }, [&] {node->typeSpec.push_back(parseTypeSpec()); });
         return node;
-    };
-    auto parseVarSpec = [&](Token&t){
+    }
+    VarSpec* parseVarSpec() {
         VarSpec* node{};
-        if (auto tmp = parseIdentList(t); !tmp.empty()) {
+        if (auto tmp = parseIdentList(); !tmp.empty()) {
             node = new VarSpec;
             node->idents = tmp;
-            alternation(OP_AGN, [&] {node->exprs = parseExprList(t); },
-                [&] {node->type = parseType(t); option(OP_AGN, [&] {node->exprs = parseExprList(t); }); });
+            alternation(OP_AGN, [&] {node->exprs = parseExprList(); },
+                [&] {node->type = parseType(); option(OP_AGN, [&] {node->exprs = parseExprList(); }); });
         }
         return node;
-    };
-    auto parseVarDecl = [&](Token&t) {
+    }
+    VarDecl* parseVarDecl() {
         auto * node = new VarDecl;
         eat(KW_var);
         alternation(OP_LPAREN, [&] {
-            repetition(OP_RPAREN, [&] {node->varSpec.push_back(parseVarSpec(t)); option(OP_SEMI, [] {}); });
-        }, [&] {node->varSpec.push_back(parseVarSpec(t)); });
+            repetition(OP_RPAREN, [&] {node->varSpec.push_back(parseVarSpec()); option(OP_SEMI, [] {}); });
+        }, [&] {node->varSpec.push_back(parseVarSpec()); });
         return node;
-    };
-    auto parseParamDecl = [&](Token&t) {
+    }
+    ParamDecl* parseParamDecl() {
         ParamDecl* node{};
         if (t.type == OP_VARIADIC) {
             node = new ParamDecl;
             node->isVariadic = true;
-            t = next(f);
-            node->type = parseType(t);
+            t = next();
+            node->type = parseType();
         } else if (t.type != OP_RPAREN) {
             node = new ParamDecl;
-            auto*mayIdentOrType = parseType(t);
+            auto*mayIdentOrType = parseType();
             if (t.type != OP_COMMA && t.type != OP_RPAREN) {
                 node->hasName = true;
                 option(OP_VARIADIC, [&] {node->isVariadic = true; });
-                node->name = dynamic_cast<Name*>(mayIdentOrType)->name;
-                node->type = parseType(t);
+                node->name = nameOf(mayIdentOrType);
+                node->type = parseType();
             } else node->type = mayIdentOrType;
         }
         return node;
-    };
-    auto parseParam = [&](Token&t){
+    }
+    Param* parseParam() {
         Param* node{};
         option(OP_LPAREN, [&] {
             node = new Param;
             repetition(OP_RPAREN, [&] {
-                if (auto * tmp = parseParamDecl(t); tmp != nullptr) { node->paramList.push_back(tmp); }
+                if (auto * tmp = parseParamDecl(); tmp != nullptr) { node->paramList.push_back(tmp); }
                 option(OP_COMMA, [] {}); });
             for (int i = 0, rewriteStart = 0; i < node->paramList.size(); i++) {
-                if (dynamic_cast<ParamDecl*>(node->paramList[i])->hasName) {
+                if (node->paramList[i]->hasName) {
                     for (int k = rewriteStart; k < i; k++) {
-                        string name = dynamic_cast<Name*>(node->paramList[k]->type)->name;
+                        auto name = nameOf(node->paramList[k]->type);
                         node->paramList[k]->type = node->paramList[i]->type;
                         node->paramList[k]->name = name;
                         node->paramList[k]->hasName = true; 
@@ -549,359 +1343,432 @@ const auto parse(const string & filename) {
             }
         });
         return node;
-    };
-    auto parseSignature = [&](Token&t){
+    }
+    Signature* parseSignature() {
         Signature* node{};
         if (t.type == OP_LPAREN) {
             node = new Signature;
-            node->param = parseParam(t);
-            if (auto*result = parseParam(t); result != nullptr) {
+            node->param = parseParam();
+            if (auto*result = parseParam(); result != nullptr) {
                 node->resultParam = result;
-            } else  if (auto*result = parseType(t); result != nullptr) {
+            } else  if (auto*result = parseType(); result != nullptr) {
                 node->resultType = result;
             }
         }
         return node;
-    };
-    auto parseFuncDecl = [&](bool anonymous, Token&t){
+    }
+    FuncDecl* parseFuncDecl(bool anonymous) {
         auto * node = new FuncDecl;
         eat(KW_func);
         if (!anonymous) {
-            if (t.type == OP_LPAREN) node->receiver = parseParam(t);
-            node->funcName = t.lexeme;
-            t = next(f);
+            if (t.type == OP_LPAREN) node->receiver = parseParam();
+            node->funcName = sym();
+            t = next();
         }
-        node->signature = parseSignature(t);
+        node->signature = parseSignature();
         nestLev++;
-        node->funcBody = parseBlock(t);
+        if (lazy && !anonymous && t.type == OP_LBRACE) node->funcBody = skipBlock();
+        else node->funcBody = parseBlock();
         nestLev--;
         return node;
-    };
+    }
+    // Match braces up to the end of the block without building any node. Literals and comments
+    // are stepped over the same way next() scans them, hence the skipped text is exactly what
+    // parseBlock() would consume. Columns on the line of '}' are approximate afterwards
+    LazyBlock skipBlock() {
+        LazyBlock body{ nullptr, {}, f.line, f.column, unit };
+        const char* open = t.lexeme.data(), *p = f.cur, *base = p;
+        uint64_t mask = scan.bodyMask(base, f.end);
+        auto stop = [&] {   // first CC_BODY byte from p on, the mask of 64 bytes at base is reused
+            for (;;) {
+                if (p - base >= 64) mask = scan.bodyMask(base = p, f.end);
+                if (uint64_t m = mask & (~0ull << (p - base)); m != 0) return base + ctz64(m);
+                if (f.end - base <= 64) return f.end;
+                mask = scan.bodyMask(p = base += 64, f.end);
+            }
+        };
+        for (int depth = 1; depth > 0;) {
+            p = stop();
+            readAll = p >= f.end;
+            G_ASSERT(readAll, "syntax error", "function body does not have a closed symbol \"}\"");
+            switch (*p++) {
+            case '{': depth++; break;
+            case '}': depth--; break;
+            case '`': p = scan.find(p, f.end, '`', '`', '`', '`') + 1; break;
+            case '"':
+                for (p = scan.find(p, f.end, '\\', '"', '\n', '\r'); p < f.end && *p == '\\';) {
+                    p += 2;
+                    if (p >= f.end || anyone(*p, '"', '\n', '\r')) break;
+                    p = scan.find(p + 1, f.end, '\\', '"', '\n', '\r');
+                }
+                p++;
+                break;
+            case '\'': p = scan.find(p + (p < f.end && *p == '\\' ? 2 : 1), f.end, '\'', '\'', '\'', '\'') + 1; break;
+            case '/':
+                if (p < f.end && *p == '/') {
+                    p = scan.find(p, f.end, '\n', '\r', '\n', '\r');
+                } else if (p < f.end && *p == '*') {
+                    for (p++;; p += 2) {
+                        p = scan.find(p, f.end, '*', '*', '*', '*');
+                        if (p >= f.end || (p + 1 < f.end && p[1] == '/')) break;
+                    }
+                    p += 2;
+                }
+                break;
+            }
+            p = min(p, f.end);
+        }
+        const char* lineStart = p;
+        while (lineStart > f.cur && lineStart[-1] != '\n') lineStart--;
+        f.line += static_cast<int>(scan.count(f.cur, p, '\n'));
+        f.column = lineStart == f.cur ? f.column + static_cast<int>(p - f.cur) : static_cast<int>(p - lineStart) + 1;
+        f.cur = p;
+        f.lastToken = OP_RBRACE;
+        body.text = str(string_view(open, p - open));
+        t = next();
+        return body;
+    }
 #pragma endregion
 #pragma region Type
-    auto parseArrayOrSliceType = [&](Token&t) {
+    Expr* parseArrayOrSliceType() {
         Expr* node{};
         eat(OP_LBRACKET);
         nestLev++;
         alternation(OP_RBRACKET, [&] {
-            node = new SliceType;
+            auto* slice = new SliceType;
             nestLev--;
-            dynamic_cast<SliceType*>(node)->elem = parseType(t);
+            slice->elem = parseType();
+            node = slice;
         }, [&] {
-            node = new ArrayType;
-            alternation(OP_VARIADIC, [&] {dynamic_cast<ArrayType*>(node)->autoLen = true; },
-                [&] {dynamic_cast<ArrayType*>(node)->len = parseExpr(t); });
+            auto* array = new ArrayType;
+            alternation(OP_VARIADIC, [&] {array->autoLen = true; },
+                [&] {array->len = parseExpr(); });
             nestLev--;
-            t = next(f);
-            dynamic_cast<ArrayType*>(node)->elem = parseType(t);
+            t = next();
+            array->elem = parseType();
+            node = array;
         });
         return node;
-    };
-    auto parseStructType = [&](Token&t){
+    }
+    StructType* parseStructType() {
         auto * node = new  StructType;
         eat(KW_struct); option(OP_SEMI, [] {}); eat(OP_LBRACE);
         repetition(OP_RBRACE, [&] {
-            tuple<vector<string>, Expr*, string, bool> field;// <IdentList/Name,Type,Tag,isEmbeded>
-            if (auto tmp = parseIdentList(t); !tmp.empty()) {
-                get<0>(field) = tmp;
-                get<1>(field) = parseType(t);
-                get<3>(field) = false;
+            tuple<avector<Symbol>, Expr*, Symbol, bool> field;// <IdentList/Name,Type,Tag,isEmbeded>
+            if (t.type == TK_ID) {     // names and their type, or an embedded type name
+                auto* name = parseName(true);
+                get<0>(field).push_back(name->name);
+                if (name->name.str().find('.') == string::npos && !anyone(t.type, OP_SEMI, OP_RBRACE, LIT_STR)) {
+                    while (t.type == OP_COMMA) {
+                        t = next();
+                        get<0>(field).push_back(sym());
+                        t = next();
+                    }
+                    get<1>(field) = parseType();
+                } else get<3>(field) = true;
             } else {
                 option(OP_MUL, [&] {get<3>(field) = true;});
-                auto tmpName = parseName(true, t);
-                get<0>(field).push_back(tmpName != nullptr ? tmpName->name : "");
-                delete tmpName;
+                auto tmpName = parseName(true);
+                get<0>(field).push_back(tmpName != nullptr ? tmpName->name : Symbol{});
             }
-            if (t.type == LIT_STR) get<2>(field) = t.lexeme;
+            if (t.type == LIT_STR) get<2>(field) = t.sym;
             node->fields.push_back(field);
             option(OP_SEMI, [] {});
         });
         option(OP_SEMI,[]{});
         return node;
-    };
-    auto parseInterfaceType = [&](Token&t){
+    }
+    InterfaceType* parseInterfaceType() {
         auto * node = new InterfaceType;
         eat(KW_interface);eat(OP_LBRACE);
         while (t.type != OP_RBRACE) {
-            if (auto* tmp = parseName(true, t); tmp != nullptr && tmp->name.find('.') == string::npos)
-                node->method.emplace_back(tmp, parseSignature(t));
+            auto* tmp = parseName(true);
+            G_ASSERT(tmp == nullptr, "syntax error", "expect method but got " + string(spelling(t.type)));
+            if (tmp->name.str().find('.') == string::npos)
+                node->method.emplace_back(tmp, parseSignature());
             else node->method.emplace_back(tmp, nullptr);
             option(OP_SEMI,[]{});
         }
-        t = next(f);
+        t = next();
         return node;
-    };
-    auto parseMapType = [&](Token&t){
+    }
+    MapType* parseMapType() {
         auto * node = new MapType;
         eat(KW_map);eat(OP_LBRACKET);
-        node->type = parseType(t);
+        node->type = parseType();
         eat(OP_RBRACKET);
-        node->elem = parseType(t);
+        node->elem = parseType();
         return node;
-    };
-    auto parseChanType = [&](Token&t){
+    }
+    ChanType* parseChanType() {
         ChanType* node{};
         option(KW_chan, [&] {
             node = new ChanType;
-            alternation(OP_CHAN, [&] {node->elem = parseType(t); }, [&] {node->elem = parseType(t); }); });
+            alternation(OP_CHAN, [&] {node->elem = parseType(); }, [&] {node->elem = parseType(); }); });
         return node;
-    };
-    parseType = [&](Token&t)->Expr* {
+    }
+    Expr* parseType() {
         switch (t.type) {
-        case OP_MUL:      {t = next(f); return new PtrType(parseType(t)); }
-        case KW_func:     {t = next(f); return new FuncType(parseSignature(t)); }
-        case OP_LPAREN:   {t = next(f); auto*tmp = parseType(t); t = next(f); return tmp; }
-        case TK_ID:       return parseName(true, t);
-        case OP_LBRACKET: return parseArrayOrSliceType(t);
-        case KW_struct:   return parseStructType(t);
-        case KW_interface:return parseInterfaceType(t);
-        case KW_map:      return parseMapType(t);
-        case KW_chan:     return parseChanType(t);
+        case OP_MUL:      {t = next(); return new PtrType(parseType()); }
+        case KW_func:     {t = next(); return new FuncType(parseSignature()); }
+        case OP_LPAREN:   {t = next(); auto*tmp = parseType(); t = next(); return tmp; }
+        case TK_ID:       return parseName(true);
+        case OP_LBRACKET: return parseArrayOrSliceType();
+        case KW_struct:   return parseStructType();
+        case KW_interface:return parseInterfaceType();
+        case KW_map:      return parseMapType();
+        case KW_chan:     return parseChanType();
         default:          return nullptr;
         }
-    };
+    }
 #pragma endregion
 #pragma region Statement
-    auto parseSimpleStmt = [&](ExprList* lhs, Token&t)->Stmt* {
+    Stmt* parseSimpleStmt(ExprList* lhs) {
         if (t.type == KW_range) {    //special case for ForStmt
-            t = next(f);
-            return new SRangeClause{ vector<string>(),parseExpr(t) };
+            t = next();
+            return new SRangeClause{ avector<Symbol>(),parseExpr() };
         }
-        if (lhs == nullptr) lhs = parseExprList(t);
+        if (lhs == nullptr) lhs = parseExprList();
+        G_ASSERT(lhs == nullptr, "syntax error", "expect expression but got " + string(spelling(t.type)));
         switch (t.type) {
-        case OP_CHAN:           {t = next(f); return new SendStmt{ lhs->exprs[0],parseExpr(t) }; }
-        case OP_INC:case OP_DEC:{auto tmp = t.type; t = next(f); return new IncDecStmt{lhs->exprs[0],tmp==OP_INC}; }
+        case OP_CHAN:           {t = next(); return new SendStmt{ lhs->exprs[0],parseExpr() }; }
+        case OP_INC:case OP_DEC:{auto tmp = t.type; t = next(); return new IncDecStmt{lhs->exprs[0],tmp==OP_INC}; }
         case OP_SHORTAGN: {
-            vector<string> idents;
+            avector<Symbol> idents;
             for (auto* e : lhs->exprs) {
-                string identName = dynamic_cast<Name*>(dynamic_cast<BasicExpr*>(e)->lhs)->name;
+                auto identName = nameOf(e);
                 idents.push_back(identName);
             }
-            t = next(f);
+            t = next();
             Stmt* stmt{};
-            alternation(KW_range,[&] {stmt = new SRangeClause{ move(idents), parseExpr(t) }; },
-                [&] {stmt = new SAssignStmt{ move(idents) ,parseExprList(t) }; });
+            alternation(KW_range,[&] {stmt = new SRangeClause{ move(idents), parseExpr() }; },
+                [&] {stmt = new SAssignStmt{ move(idents) ,parseExprList() }; });
             return stmt;
         }
         case OP_ADDAGN:case OP_SUBAGN:case OP_ORAGN:case OP_XORAGN:case OP_MULAGN:case OP_DIVAGN:
         case OP_MODAGN:case OP_LSFTAGN:case OP_RSFTAGN:case OP_ANDAGN:case OP_ANDXORAGN:case OP_AGN: {
-            if (lhs->exprs.empty()) throw runtime_error("one expr required");
+            G_ASSERT(lhs->exprs.empty(), "syntax error", "one expr required");
             auto op = t.type;
-            t = next(f);
+            t = next();
             Stmt* stmt{};
-            alternation(KW_range,[&] {stmt = new RangeClause{ lhs,op,parseExpr(t) }; },
-                [&] {stmt = new AssignStmt{ lhs,op,parseExprList(t)}; });
+            alternation(KW_range,[&] {stmt = new RangeClause{ lhs,op,parseExpr() }; },
+                [&] {stmt = new AssignStmt{ lhs,op,parseExprList()}; });
             return stmt;
         }
         default: {return new ExprStmt{ lhs->exprs[0] }; }//ExprStmt
         }
-    };
-    parseIfStmt = [&](Token&t)->IfStmt* {
+    }
+    IfStmt* parseIfStmt() {
         const int outLev = nestLev;
         nestLev = -1;
         auto * node = new IfStmt;
-        if (t.type == OP_LBRACE) throw runtime_error("if statement requires a condition");
-        auto* tmp = parseSimpleStmt(nullptr, t);
+        G_ASSERT(t.type == OP_LBRACE, "syntax error", "if statement requires a condition");
+        auto* tmp = parseSimpleStmt(nullptr);
         alternation(OP_SEMI, 
-            [&] {node->init = tmp; node->cond = parseExpr(t); },
-            [&] {node->cond = dynamic_cast<ExprStmt*>(tmp)->expr; });
+            [&] {node->init = tmp; node->cond = parseExpr(); },
+            [&] {
+                G_ASSERT(as<ExprStmt>(tmp) == nullptr, "syntax error", "if statement requires a condition");
+                node->cond = as<ExprStmt>(tmp)->expr; });
         nestLev = outLev;
         
-        node->ifBlock = parseBlock(t);
+        node->ifBlock = parseBlock();
         option(KW_else, [&] {
-            if (t.type == KW_if) {t = next(f); node->elseBlock = parseIfStmt(t);}
-            else if (t.type == OP_LBRACE)   node->elseBlock = parseBlock(t);
+            if (t.type == KW_if) {t = next(); node->elseBlock = parseIfStmt();}
+            else if (t.type == OP_LBRACE)   node->elseBlock = parseBlock();
             else G_ERROR("syntax error", "only else-if or else could place here");
         });
         return node;
-    };
-    auto parseSwitchCase = [&](Token&t) {
+    }
+    tuple<ExprList*, StmtList*> parseSwitchCase() {
         ExprList*exprs{}; 
         StmtList*stmts{};
         if (t.type == KW_case) {
-            t = next(f);
-            exprs = parseExprList(t);
+            t = next();
+            exprs = parseExprList();
             eat(OP_COLON);
-            stmts = parseStmtList(t);
+            stmts = parseStmtList();
         } else if (t.type == KW_default) {
-            t = next(f);
+            t = next();
             eat(OP_COLON);
-            stmts = parseStmtList(t);
+            stmts = parseStmtList();
         }
         return make_tuple(exprs, stmts);
-    };
-    auto parseSwitchStmt = [&](Token&t) {
+    }
+    SwitchStmt* parseSwitchStmt() {
         const int outLev = nestLev;
         nestLev = -1;
         auto * node = new SwitchStmt;
         if (t.type != OP_LBRACE) {
-            node->init = parseSimpleStmt(nullptr, t);
+            node->init = parseSimpleStmt(nullptr);
             option(OP_SEMI, [] {});
-            if (t.type != OP_LBRACE) node->cond = parseSimpleStmt(nullptr, t);
+            if (t.type != OP_LBRACE) node->cond = parseSimpleStmt(nullptr);
         }
         nestLev = outLev;
 
         eat(OP_LBRACE);
         repetition(OP_RBRACE, [&] {
-            if (auto[cond, stmts] = parseSwitchCase(t); /*cond could null*/stmts != nullptr)
+            if (auto[cond, stmts] = parseSwitchCase(); /*cond could null*/stmts != nullptr)
                 node->caseList.emplace_back(cond,stmts); });
         return node;
-    };
-    auto parseSelectCase = [&](Token&t){
+    }
+    // a clause without statements still has a list, it's only null when there is no clause
+    tuple<Stmt*, StmtList*> parseSelectCase() {
         Stmt*cond{}; StmtList* stmts{};
         if (t.type == KW_case) {
-            t = next(f);
-            cond = parseSimpleStmt(nullptr, t);
+            t = next();
+            cond = parseSimpleStmt(nullptr);
             eat(OP_COLON);
-            stmts = parseStmtList(t);
+            if ((stmts = parseStmtList()) == nullptr) stmts = new StmtList;
         } else if (t.type == KW_default) {
-            t = next(f);
+            t = next();
             eat(OP_COLON);
-            stmts = parseStmtList(t);
+            if ((stmts = parseStmtList()) == nullptr) stmts = new StmtList;
         }
         return make_tuple(cond, stmts);
-    };
-    auto parseSelectStmt = [&](Token&t) {
+    }
+    SelectStmt* parseSelectStmt() {
         eat(OP_LBRACE);
         auto* node = new SelectStmt;
         repetition(OP_RBRACE,[&] {
-            if (auto[cond,stmts] = parseSelectCase(t); /*cond could null*/stmts != nullptr) 
+            if (auto[cond,stmts] = parseSelectCase(); /*cond could null*/stmts != nullptr) 
                 node->caseList.emplace_back(cond,stmts); 
         });
         return node;
-    };
-    auto parseForStmt = [&](Token&t){
+    }
+    ForStmt* parseForStmt() {
         const int outLev = nestLev;
         nestLev = -1;
         auto* node = new ForStmt;
         if (t.type != OP_LBRACE) {
             if (t.type != OP_SEMI) {
-                auto*tmp = parseSimpleStmt(nullptr, t);
+                auto*tmp = parseSimpleStmt(nullptr);
                 switch (t.type) {
                 case OP_LBRACE:
                     node->cond = tmp;
-                    if (anyone(typeid(*tmp), typeid(SRangeClause), typeid(RangeClause))) nestLev = outLev;
+                    if (anyone(tmp->kind, NodeKind::SRangeClause, NodeKind::RangeClause)) nestLev = outLev;
                     break;
                 case OP_SEMI:
                     node->init = tmp;
                     eat(OP_SEMI);
-                    node->cond = parseExpr(t);
+                    node->cond = parseExpr();
                     eat(OP_SEMI);
-                    if (t.type != OP_LBRACE)node->post = parseSimpleStmt(nullptr, t);
+                    if (t.type != OP_LBRACE)node->post = parseSimpleStmt(nullptr);
                     break;
                 default:G_ERROR("syntax error", "expect {/;/range/:=/=");
                 }
             } else {  // for ;cond;post{}
-                t = next(f);
-                node->cond = parseExpr(t);
+                t = next();
+                node->cond = parseExpr();
                 eat(OP_SEMI);
-                if (t.type != OP_LBRACE) node->post = parseSimpleStmt(nullptr, t);
+                if (t.type != OP_LBRACE) node->post = parseSimpleStmt(nullptr);
             }
         }
         nestLev = outLev;
-        node->block = parseBlock(t);
+        node->block = parseBlock();
         return node;
-    };
-    parseStmt = [&](Token&t)->Stmt* {
+    }
+    Stmt* parseStmt() {
         switch (t.type) {
-        case KW_type:  	    return parseTypeDecl(t);
-        case KW_const:      return parseConstDecl(t);
-        case KW_var:        return parseVarDecl(t);
-        case KW_fallthrough:t = next(f);  return new FallthroughStmt();
-        case KW_go:         t = next(f);  return new GoStmt(parseExpr(t));
-        case KW_return:     t = next(f);  return new ReturnStmt(parseExprList(t));
-        case KW_break:      t = next(f);  return new BreakStmt(t.type == TK_ID ? t.lexeme : "");
-        case KW_continue:   t = next(f);  return new ContinueStmt(t.type == TK_ID ? t.lexeme : "");
-        case KW_goto:       t = next(f);  return new GotoStmt(t.lexeme);
-        case KW_defer:      t = next(f);  return new DeferStmt(parseExpr(t));
-        case KW_if:         t = next(f);  return parseIfStmt(t);
-        case KW_switch:     t = next(f);  return parseSwitchStmt(t);
-        case KW_select:     t = next(f);  return parseSelectStmt(t);
-        case KW_for:        t = next(f);  return parseForStmt(t);
-        case OP_LBRACE:     return parseBlock(t);
+        case KW_type:  	    return parseTypeDecl();
+        case KW_const:      return parseConstDecl();
+        case KW_var:        return parseVarDecl();
+        case KW_fallthrough:t = next();  return new FallthroughStmt();
+        case KW_go:         t = next();  return new GoStmt(parseExpr());
+        case KW_return:     t = next();  return new ReturnStmt(parseExprList());
+        case KW_break:      t = next();  return new BreakStmt(t.type == TK_ID ? t.sym : Symbol{});
+        case KW_continue:   t = next();  return new ContinueStmt(t.type == TK_ID ? t.sym : Symbol{});
+        case KW_goto:       t = next();  return new GotoStmt(sym());
+        case KW_defer:      t = next();  return new DeferStmt(parseExpr());
+        case KW_if:         t = next();  return parseIfStmt();
+        case KW_switch:     t = next();  return parseSwitchStmt();
+        case KW_select:     t = next();  return parseSelectStmt();
+        case KW_for:        t = next();  return parseForStmt();
+        case OP_LBRACE:     return parseBlock();
         case OP_SEMI:       return nullptr;
         case OP_ADD:case OP_SUB:case OP_NOT:case OP_XOR:case OP_MUL:case OP_CHAN:
         case LIT_STR:case LIT_INT:case LIT_IMG:case LIT_FLOAT:case LIT_RUNE:
         case KW_func:case KW_struct:case KW_map:case OP_LBRACKET:case TK_ID: case OP_LPAREN:{
             // It shall a labeled statement(not part of simple stmt so we handle it here)
-            auto* exprs = parseExprList(t);
+            auto* exprs = parseExprList();
             Stmt*result{};
-            alternation(OP_COLON, [&] { result = new LabeledStmt(dynamic_cast<Name*>(
-                dynamic_cast<BasicExpr*>(exprs->exprs[0])->lhs)->name,parseStmt(t));
-            }, [&] {result = parseSimpleStmt(exprs, t); });
+            alternation(OP_COLON, [&] { result = new LabeledStmt(
+                nameOf(exprs->exprs[0]), parseStmt());
+            }, [&] {result = parseSimpleStmt(exprs); });
             return result;
         }
         }
         return nullptr;
-    };
+    }
 #pragma endregion
 #pragma region Expression
-    parseExpr = [&](Token&t)->Expr* {
-        BasicExpr* node{};
-        if (auto*tmp = parseUnaryExpr(t); tmp != nullptr) {
-            node = new  BasicExpr;
-            node->lhs = tmp;
-            if (anyone(t.type, OP_OR, OP_AND, OP_EQ, OP_NE, OP_LT, OP_LE, OP_XOR, OP_GT, OP_GE, OP_ADD,
-                OP_SUB, OP_BITOR, OP_XOR, OP_ANDXOR, OP_MUL, OP_DIV, OP_MOD, OP_LSHIFT, OP_RSHIFT, OP_BITAND)) {
-                node->op = t.type;
-                t = next(f);
-                node->rhs = parseExpr(t);
-            }
+    // Precedence climbing, operators of the same level associate to the left within the loop, so
+    // recursion depth is bounded by the number of precedence levels rather than operands
+    Expr* parseExpr(int minPrec = 1) {
+        auto* lhs = parseUnaryExpr();
+        if (lhs == nullptr) return nullptr;
+        for (int prec; (prec = precedence(t.type)) >= minPrec;) {
+            auto* node = new BasicExpr;
+            node->lhs = lhs;
+            node->op = t.type;
+            t = next();
+            node->rhs = parseExpr(prec + 1);
+            lhs = node;
         }
-        return node;
-    };
-    parseUnaryExpr = [&](Token&t)->Expr* {
+        return lhs;
+    }
+    Expr* parseUnaryExpr() {
         if (anyone(t.type, OP_ADD, OP_SUB, OP_NOT, OP_XOR, OP_MUL, OP_BITAND, OP_CHAN)) {
             auto* node = new BasicExpr;
             node->op = t.type;
-            t = next(f);
-            node->lhs = parseUnaryExpr(t);
+            t = next();
+            node->lhs = parseUnaryExpr();
+            return node;
         } else if (anyone(t.type, TK_ID, LIT_INT, LIT_FLOAT, LIT_IMG, LIT_RUNE, LIT_STR,
             KW_struct, KW_map, OP_LBRACKET, KW_chan, KW_interface, KW_func, OP_LPAREN)) {
-            return parsePrimaryExpr(t);
+            return parsePrimaryExpr();
         } else return nullptr;
-    };
-    auto parseOperand = [&](Token&t)->Expr* {
+    }
+    Expr* parseOperand() {
         if (t.type == TK_ID) {
-            return parseName(false, t);
+            return parseName(false);
         } else if (t.type == KW_func) {
-            return parseFuncDecl(true, t);
+            return parseFuncDecl(true);
         } else if (t.type == OP_LPAREN) {
-            t = next(f); 
+            t = next(); 
             nestLev++; 
-            auto* e = parseExpr(t); 
+            auto* e = parseExpr(); 
             nestLev--; 
             eat(OP_RPAREN); 
             return e;
         } else if (anyone(t.type, LIT_INT, LIT_FLOAT, LIT_IMG, LIT_RUNE, LIT_STR)) {
-            auto*tmp = new BasicLit(t.type, t.lexeme); t = next(f); return tmp;
+            auto*tmp = new BasicLit(t.type, t.sym); t = next(); return tmp;
         } else if (anyone(t.type, KW_struct, KW_map, OP_LBRACKET, KW_chan, KW_interface)) {
-            return parseType(t);
+            return parseType();
         } else return nullptr;
-    };
-    parsePrimaryExpr = [&](Token&t)->Expr* {
-        if (auto*tmp = parseOperand(t); tmp != nullptr) {
+    }
+    Expr* parsePrimaryExpr() {
+        if (auto*tmp = parseOperand(); tmp != nullptr) {
             while (true) {
                 if (t.type == OP_DOT) {
-                    t = next(f);
+                    t = next();
                     if (t.type == TK_ID) {
-                        tmp = new SelectorExpr(tmp, t.lexeme);
-                        t = next(f);
+                        tmp = new SelectorExpr(tmp, t.sym);
+                        t = next();
                     } else if (t.type == OP_LPAREN) {
-                        t = next(f);
+                        t = next();
                         alternation(KW_type, [&] { tmp = new TypeSwitchExpr(tmp); },
-                            [&] {tmp = new TypeAssertExpr(tmp, parseType(t)); });
+                            [&] {tmp = new TypeAssertExpr(tmp, parseType()); });
                         eat(OP_RPAREN);
                     } else G_ERROR("syntax error", "expec identifier or (");
                 } else if (t.type == OP_LBRACKET) {
                     nestLev++;
-                    t = next(f);
+                    t = next();
                     Expr* start{};//Ignore start if next token is :(syntax of operand[:xxx])
                     if (t.type != OP_COLON) {
-                        start = parseExpr(t);
+                        start = parseExpr();
                         if (t.type == OP_RBRACKET) {
                             tmp = new IndexExpr(tmp, start);
-                            t = next(f);
+                            t = next();
                             nestLev--;
                             continue;
                         }
@@ -910,22 +1777,22 @@ const auto parse(const string & filename) {
                     e->operand = tmp;
                     e->begin = start;
                     eat(OP_COLON);
-                    e->end = parseExpr(t);//may nullptr
+                    e->end = parseExpr();//may nullptr
                     if (t.type == OP_COLON) {
-                        t = next(f);
-                        e->step = parseExpr(t);
+                        t = next();
+                        e->step = parseExpr();
                         eat(OP_RBRACKET);
                     }
-                    else if (t.type == OP_RBRACKET) t = next(f);
+                    else if (t.type == OP_RBRACKET) t = next();
                     else G_ERROR("syntax error", "expec : or ]");
                     tmp = e;
                     nestLev--;
                 } else if (t.type == OP_LPAREN) {
-                    t = next(f);
+                    t = next();
                     auto* e = new CallExpr;
                     e->operand = tmp;
                     nestLev++;
-                    if (auto*tmp1 = parseExprList(t); tmp1 != nullptr) e->arguments = tmp1;
+                    if (auto*tmp1 = parseExprList(); tmp1 != nullptr) e->arguments = tmp1;
                     option(OP_VARIADIC, [&] {e->isVariadic = true; });
                     nestLev--;
                     eat(OP_RPAREN);
@@ -933,82 +1800,6372 @@ const auto parse(const string & filename) {
                 }else if (t.type == OP_LBRACE) {
                     // Only operand has literal value, otherwise, treats it as a block
                     // It's somewhat curious since official implementation treats literal type and literal value as separate parts
-                    if (anyone(typeid(*tmp), typeid(ArrayType), typeid(SliceType), typeid(StructType), typeid(MapType))
-                        || ((anyone(typeid(*tmp), typeid(Name), typeid(SelectorExpr))) && nestLev >= 0)) {
-                        tmp = new CompositeLit{ tmp,parseLitValue(t) };
+                    if (anyone(tmp->kind, NodeKind::ArrayType, NodeKind::SliceType, NodeKind::StructType, NodeKind::MapType)
+                        || (anyone(tmp->kind, NodeKind::Name, NodeKind::SelectorExpr) && nestLev >= 0)) {
+                        tmp = new CompositeLit{ tmp,parseLitValue() };
                     } else break;
                 } else break;
             }
             return tmp;
         }
         return nullptr;
-    };
-    auto parseKeyedElement = [&](Token&t){
+    }
+    tuple<Expr*, Expr*> parseKeyedElement() {
         Expr* elem{}, *key{};
-        elem = (t.type == OP_LBRACE) ? parseLitValue(t) : parseExpr(t);
+        elem = (t.type == OP_LBRACE) ? parseLitValue() : parseExpr();
         option(OP_COLON, 
-            [&] {key = elem; elem = (t.type == OP_LBRACE) ? parseLitValue(t) : parseExpr(t); });
+            [&] {key = elem; elem = (t.type == OP_LBRACE) ? parseLitValue() : parseExpr(); });
         return make_tuple(key,elem);
-    };
-    parseLitValue = [&](Token&t)->LitValue* {
+    }
+    LitValue* parseLitValue() {
         LitValue*node{};
         if (t.type == OP_LBRACE) {
             nestLev++;
             node = new LitValue;
             repetition(OP_RBRACE, [&] {
-                t = next(f);
+                t = next();
                 if (t.type == OP_RBRACE) return; // it's necessary since both {a,b} or {a,b,} are legal form
-                node->keyedElement.push_back(parseKeyedElement(t));
+                node->keyedElement.push_back(parseKeyedElement());
             });
             nestLev--;
         }
         return node;
-    };
+    }
 #pragma endregion
-    // parsing startup
-    auto * node = new CompilationUnit;
-    eat(KW_package);
-    node->package = t.lexeme;
-    eat(TK_ID);eat(OP_SEMI);
-    while (t.type != TK_EOF) {
-        switch (t.type) {
-        case KW_import: node->importDecl.push_back(parseImportDecl(t));     break;
-        case KW_const:  node->constDecl.push_back(parseConstDecl(t));       break;
-        case KW_type:   node->typeDecl.push_back(parseTypeDecl(t));         break;
-        case KW_var:    node->varDecl.push_back(parseVarDecl(t));           break;
-        case KW_func:   node->funcDecl.push_back(parseFuncDecl(false, t));  break;
-        case OP_SEMI:   t = next(f);                                        break;
-        default:        G_ERROR("syntax error","unknown top level declaration"); 
+    CompilationUnit* parseCompilationUnit() {
+        if (buffered) tokens = TokenBuffer(f);
+        for (auto& d : tokens.errors) report(d);
+        t = next();
+        try {
+            eat(KW_package);
+            unit->package = sym();
+            eat(TK_ID);eat(OP_SEMI);
+        } catch (Diagnostic& d) {
+            report(d);
+            syncDecl();
         }
+        while (t.type != TK_EOF) parseTopLevel();
+        return unit;
     }
-    return node;
-}
-void codegen(const CompilationUnit*const tree) {
-    for (auto&func : tree->funcDecl) {
-        if (func->funcName == "main" && func->receiver == nullptr && func->funcBody != nullptr) {
-            for (auto&mainStmt : func->funcBody->stmts) {
-
+    // A top-level declaration or a stray ';'. Units parsed from text record where declarations start,
+    // diagnostics and text read up to the next one are counted to a declaration
+    void parseTopLevel() {
+        auto at = [&](const char* p) { return unit->text.empty() ? 0 : static_cast<uint32_t>(p - unit->text.data()); };
+        if (t.type == OP_SEMI) {
+            const size_t errors = unit->diagnostics.size();
+            t = next();
+            if (!unit->spans.empty()) {
+                unit->spans.back().errors += static_cast<uint32_t>(unit->diagnostics.size() - errors);
+                unit->spans.back().reach = at(f.cur);
+            }
+            return;
+        }
+        unit->spans.push_back({ at(lexed.cur), 0, lexed.line, lexed.column, lexed.last, line, column, t.type, nullptr, 0 });
+        DeclSpan* span = &unit->spans.back();
+        readAll = false;
+        const size_t errors = unit->diagnostics.size();
+        ArenaObject* decl{};
+        try {
+            switch (t.type) {
+            case KW_import: decl = unit->importDecl.emplace_back(parseImportDecl());  break;
+            case KW_const:  decl = unit->constDecl.emplace_back(parseConstDecl());    break;
+            case KW_type:   decl = unit->typeDecl.emplace_back(parseTypeDecl());      break;
+            case KW_var:    decl = unit->varDecl.emplace_back(parseVarDecl());        break;
+            case KW_func:   decl = unit->funcDecl.emplace_back(parseFuncDecl(false)); break;
+            default:        G_ERROR("syntax error","unknown top level declaration"); 
             }
+        } catch (Diagnostic& d) {
+            report(d);
+            nestLev = 0;
+            syncDecl();
         }
+        span->reach = readAll ? at(f.end) : at(f.cur);
+        span->decl = decl;
+        span->errors = static_cast<uint32_t>(unit->diagnostics.size() - errors);
     }
+};
+
+LazyBlock::operator StmtList*() {
+    if (!text.empty()) {    // problems of the body join diagnostics of its unit
+        firstError = static_cast<uint32_t>(unit->diagnostics.size());
+        Parser p(*this);
+        try { block = p.parseBlock(); } catch (Diagnostic& d) { unit->diagnostics.push_back(d); } catch (TooManyErrors&) {}
+        errors = static_cast<uint32_t>(unit->diagnostics.size() - firstError);
+        text = {};
+    }
+    return block;
 }
+#pragma region AstCache
+// Parsed units are cached on disk, keyed by hash of their source and of the image format, so
+// that unchanged files skip lexing and parsing. An image is the pre-order encoding of a unit: a
+// node is its kind + 1 (0 for null) followed by its fields, integers are varints and symbols are
+// indices into the spellings leading the image. Loading maps the image and rebuilds the tree into
+// the arena of a new unit in one linear pass
+struct AstCache {
+    static constexpr char version[] = "g5 ast 2";     // bump it whenever the layout of images changes
+    struct BadImage {};
+    string dir;
+    explicit AstCache(string dir) :dir(move(dir)) {}
 
-//===---------------------------------------------------------------------------------------===//
+    static uint64_t hash(const char* p, const char* e, uint64_t h) {
+        for (uint64_t w; e - p >= 8; p += 8) { memcpy(&w, p, 8); h = (h ^ w) * 0xFF51AFD7ED558CCDull; h ^= h >> 32; }
+        for (; p < e; p++) h = (h ^ static_cast<uint8_t>(*p)) * 0x100000001B3ull;
+        return h;
+    }
+    static uint64_t key(const Source& src, ParseMode mode) {  // lazy trees differ from others
+        const uint64_t h = hash(src.begin, src.end, 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(src.end - src.begin));
+        return hash(version, version + sizeof(version), h) ^ (mode == ParseMode::Lazy);
+    }
+    string path(uint64_t key) const {
+        char name[24];
+        snprintf(name, sizeof(name), "%016llx.g5ast", static_cast<unsigned long long>(key));
+        return dir + "/" + name;
+    }
+
+    template<typename IO> static void unitFields(IO& io, CompilationUnit* u) {
+        io(u->package, u->importDecl, u->constDecl, u->typeDecl, u->funcDecl, u->varDecl);
+    }
+
+    struct Encoder {
+        string out;
+        vector<uint32_t> index;         // symbol id -> 1 + its index in spellings, 0 if not seen
+        vector<Symbol> spellings;
+        template<typename... T> void operator()(T&... xs) { (one(xs), ...); }
+        template<typename T> T* node(Node* n) { return static_cast<T*>(n); }
+        void num(uint64_t v) { for (; v >= 0x80; v >>= 7) out += static_cast<char>(v | 0x80); out += static_cast<char>(v); }
+        void one(bool& b) { out += static_cast<char>(b); }
+        void one(int& v) { num(static_cast<uint32_t>(v)); }
+        void one(TokenType& t) { num(static_cast<uint32_t>(t - TK_EOF)); }
+        void one(Symbol& s) {
+            if (s.id >= index.size()) index.resize(s.id + 1024);
+            if (s.id != 0 && index[s.id] == 0) { spellings.push_back(s); index[s.id] = static_cast<uint32_t>(spellings.size()); }
+            num(index[s.id]);
+        }
+        template<typename T> void one(T*& p) {
+            if constexpr (is_base_of_v<Node, T>) {
+                num(p == nullptr ? 0 : static_cast<uint32_t>(p->kind) + 1);
+                if (p != nullptr) fields(*this, p->kind, p);
+            } else {
+                out += static_cast<char>(p != nullptr);
+                if (p != nullptr) fields(*this, p);
+            }
+        }
+        template<typename V> void one(V& list) {    // avector and vector
+            num(list.size());
+            for (auto& e : list) one(e);
+        }
+        template<typename... T> void one(tuple<T...>& t) { apply([&](auto&... e) { (one(e), ...); }, t); }
+        void one(amap<Symbol, Symbol>& m) {
+            num(m.size());
+            for (auto& e : m) { Symbol k = e.first, v = e.second; one(k), one(v); }
+        }
+        void one(LazyBlock& b) {
+            if (b.block != nullptr || b.text.empty()) { out += '\1'; one(b.block); return; }
+            out += '\2';
+            num(b.text.size()); out.append(b.text); num(b.line); num(b.column);
+        }
+    };
+    // where declarations start follows them, in the order of spans that kept one
+    static string encode(CompilationUnit* unit, uint64_t key) {
+        Encoder body;
+        unitFields(body, unit);
+        body.num(count_if(unit->spans.begin(), unit->spans.end(), [](const DeclSpan& s) { return s.decl != nullptr; }));
+        for (auto& s : unit->spans) if (s.decl != nullptr) body(s.keyword, s.keyLine, s.keyColumn);
+        Encoder head;
+        head.num(body.spellings.size());
+        for (auto s : body.spellings) { head.num(s.str().size()); head.out.append(s.str()); }
+        head.out += body.out;
+        // a checksum of the rest follows version and key, so that damaged images are not trusted
+        const uint64_t sum = hash(head.out.data(), head.out.data() + head.out.size(), key);
+        return string(version, sizeof(version)) + string(reinterpret_cast<const char*>(&key), sizeof(key))
+            + string(reinterpret_cast<const char*>(&sum), sizeof(sum)) + head.out;
+    }
+
+    struct Decoder {
+        const char* p, *end;
+        CompilationUnit* unit;
+        vector<Symbol> spellings;
+        template<typename... T> void operator()(T&... xs) { (one(xs), ...); }
+        template<typename T> T* node(Node*) { return new T; }
+        uint64_t num() {
+            uint64_t v = 0;
+            for (int shift = 0; p < end && shift < 64; shift += 7) {
+                const auto b = static_cast<uint8_t>(*p++);
+                v |= static_cast<uint64_t>(b & 0x7f) << shift;
+                if (b < 0x80) return v;
+            }
+            throw BadImage{};
+        }
+        string_view bytes(size_t n) {
+            if (static_cast<size_t>(end - p) < n) throw BadImage{};
+            p += n;
+            return { p - n, n };
+        }
+        void one(bool& b) { b = bytes(1)[0] != 0; }
+        void one(int& v) { v = static_cast<int>(num()); }
+        void one(TokenType& t) { t = static_cast<TokenType>(static_cast<int>(num()) + TK_EOF); }
+        void one(Symbol& s) {
+            const auto i = num();
+            if (i > spellings.size()) throw BadImage{};
+            s = i == 0 ? Symbol{} : spellings[i - 1];
+        }
+        template<typename T> void one(T*& ptr) {
+            ptr = nullptr;
+            if constexpr (is_base_of_v<Node, T>) {
+                const auto k = num();
+                if (k == 0) return;
+                if (k > static_cast<uint64_t>(NodeKind::FuncDecl) + 1) throw BadImage{};
+                Node* n = fields(*this, static_cast<NodeKind>(k - 1), nullptr);
+                if constexpr (!is_same_v<T, Node> && !is_same_v<T, Expr> && !is_same_v<T, Stmt>)
+                    if (n->kind != T::Kind) throw BadImage{};
+                ptr = static_cast<T*>(n);
+            } else {
+                bool present;
+                one(present);
+                if (present) fields(*this, ptr = new T);
+            }
+        }
+        template<typename V> void one(V& list) {
+            const auto n = num();
+            if (n > static_cast<size_t>(end - p)) throw BadImage{};     // every element takes a byte at least
+            list.resize(n);
+            for (auto& e : list) one(e);
+        }
+        template<typename... T> void one(tuple<T...>& t) { apply([&](auto&... e) { (one(e), ...); }, t); }
+        void one(amap<Symbol, Symbol>& m) {
+            for (auto n = num(); n > 0; n--) {
+                Symbol k, v;
+                one(k), one(v);
+                m.emplace(k, v);
+            }
+        }
+        void one(LazyBlock& b) {
+            b.unit = unit;
+            if (bytes(1)[0] == '\1') { one(b.block); return; }
+            b.text = unit->arena.str(bytes(num()));
+            one(b.line), one(b.column);
+        }
+    };
+    static CompilationUnit* decode(const char* begin, const char* end, uint64_t key) {
+        Decoder in{ begin, end, new CompilationUnit };
+        ArenaScope scope(in.unit->arena);
+        try {
+            if (in.bytes(sizeof(version)) != string_view(version, sizeof(version))) throw BadImage{};
+            uint64_t k, sum;
+            memcpy(&k, in.bytes(sizeof(k)).data(), sizeof(k));
+            memcpy(&sum, in.bytes(sizeof(sum)).data(), sizeof(sum));
+            if (k != key || sum != hash(in.p, end, key)) throw BadImage{};
+            in.spellings.resize(in.num());
+            for (auto& s : in.spellings) s = symbols.intern(in.bytes(in.num()));
+            unitFields(in, in.unit);
+            size_t next[5]{};   // into importDecl, constDecl, typeDecl, varDecl and funcDecl
+            auto pick = [&](auto& list, size_t& i) -> ArenaObject* { if (i >= list.size()) throw BadImage{}; return list[i++]; };
+            for (auto n = in.num(); n > 0; n--) {
+                DeclSpan s{};
+                in(s.keyword, s.keyLine, s.keyColumn);
+                switch (s.keyword) {
+                case KW_import: s.decl = pick(in.unit->importDecl, next[0]); break;
+                case KW_const:  s.decl = pick(in.unit->constDecl, next[1]);  break;
+                case KW_type:   s.decl = pick(in.unit->typeDecl, next[2]);   break;
+                case KW_var:    s.decl = pick(in.unit->varDecl, next[3]);    break;
+                case KW_func:   s.decl = pick(in.unit->funcDecl, next[4]);   break;
+                default:        throw BadImage{};
+                }
+                in.unit->spans.push_back(s);
+            }
+            if (in.p != end) throw BadImage{};
+        } catch (BadImage&) {
+            delete in.unit;
+            return nullptr;
+        }
+        in.unit->cached = true;
+        return in.unit;
+    }
+
+    CompilationUnit* load(uint64_t key) const {    // images are small, reading beats mapping them
+        ifstream in(path(key), ios::binary | ios::ate);
+        if (!in) return nullptr;
+        string image(static_cast<size_t>(in.tellg()), '\0');
+        if (!in.seekg(0).read(image.data(), image.size())) return nullptr;
+        return decode(image.data(), image.data() + image.size(), key);
+    }
+    // an image is written aside and renamed into place, readers never see a partial one. The temp
+    // name is unique to the process and thread, compilers may share the directory
+    void store(uint64_t key, CompilationUnit* unit) const {
+        error_code ec;
+        filesystem::create_directories(dir, ec);
+#ifdef _WIN32
+        const auto pid = _getpid();
+#else
+        const auto pid = getpid();
+#endif
+        const string file = path(key), temp = file + "." + to_string(pid) + "."
+            + to_string(std::hash<thread::id>()(this_thread::get_id()));
+        const string image = encode(unit, key);
+        if (ofstream(temp, ios::binary).write(image.data(), image.size()).good()) filesystem::rename(temp, file, ec);
+        filesystem::remove(temp, ec);
+    }
+};
+#pragma endregion
+
+#pragma region CompactAst
+// Alternative layout of the tree of a unit. Nodes are records of 32-bit slots in one pool, laid
+// out in pre-order. A record is a header of its kind and the length of its subtree, followed by
+// slots of its fields: a child handle, a symbol id, an operator or a flag, or the offset in extra
+// of a list (its length followed by elements) or of an object like Signature. A handle is offset
+// of the record, 0 is null. The tree is two flat arrays rather than nodes and heap buffers
+// scattered in an arena, and walking it is a linear sweep that jumps over skipped subtrees
+struct CompactAst {
+    using Handle = uint32_t;
+    static constexpr int KindBits = 6;
+    static constexpr size_t Kinds = static_cast<size_t>(NodeKind::FuncDecl) + 1;
+    struct SlotCount {
+        uint8_t slots = 0;
+        template<typename T> T* node(Node*) { static T dummy; return &dummy; }
+        template<typename... T> void operator()(T&...) { slots += sizeof...(T); }
+    };
+    static const array<uint8_t, 1 << KindBits>& widths() {  // slots of records by kind, one per field
+        static const auto all = [] {
+            array<uint8_t, 1 << KindBits> w{};
+            for (size_t k = 0; k < Kinds; k++) {
+                SlotCount count;
+                fields(count, static_cast<NodeKind>(k), nullptr);
+                w[k] = count.slots;
+            }
+            return w;
+        }();
+        return all;
+    }
+
+    vector<uint32_t> pool{ 0 };         // handle 0 is null
+    vector<uint32_t> extra{ 0 };        // offset 0 is an empty list or a null object
+    Symbol package;
+    vector<pair<Symbol, Symbol>> imports;
+    vector<Handle> constDecl, typeDecl, funcDecl, varDecl;
+
+    // It parses lazy bodies of the unit, if any
+    explicit CompactAst(CompilationUnit* unit) :package(unit->package) {
+        Builder b{ *this };
+        for (auto* d : unit->importDecl) imports.insert(imports.end(), d->imports.begin(), d->imports.end());
+        for (auto* d : unit->constDecl) constDecl.push_back(b.build(d));
+        for (auto* d : unit->typeDecl) typeDecl.push_back(b.build(d));
+        for (auto* d : unit->funcDecl) funcDecl.push_back(b.build(d));
+        for (auto* d : unit->varDecl) varDecl.push_back(b.build(d));
+    }
+    struct Builder {
+        CompactAst& tree;
+        vector<uint32_t> scratch;   // records and lists under construction, they nest as a stack
+        template<typename T> T* node(Node* n) { return static_cast<T*>(n); }
+        template<typename... T> void operator()(T&... xs) { (one(xs), ...); }
+        void one(bool& b) { scratch.push_back(b); }
+        void one(TokenType& t) { scratch.push_back(static_cast<uint32_t>(t)); }
+        void one(Symbol& s) { scratch.push_back(s.id); }
+        uint32_t flush(size_t start) {  // moves what's above start into extra
+            const auto offset = static_cast<uint32_t>(tree.extra.size());
+            tree.extra.insert(tree.extra.end(), scratch.begin() + start, scratch.end());
+            scratch.resize(start);
+            return offset;
+        }
+        template<typename T> void one(T*& p) {
+            if constexpr (is_base_of_v<Node, T>) {
+                scratch.push_back(build(p));
+            } else if (p == nullptr) {
+                scratch.push_back(0);
+            } else {
+                const size_t start = scratch.size();
+                fields(*this, p);
+                scratch.push_back(flush(start));
+            }
+        }
+        template<typename T> void one(avector<T>& list) {
+            if (list.empty()) { scratch.push_back(0); return; }
+            const size_t start = scratch.size();
+            scratch.push_back(static_cast<uint32_t>(list.size()));
+            for (auto& e : list) one(e);
+            scratch.push_back(flush(start));
+        }
+        template<typename... T> void one(tuple<T...>& t) { apply([&](auto&... e) { (one(e), ...); }, t); }
+        void one(LazyBlock& b) { StmtList* block = b; one(block); }
+        Handle build(Node* n) {     // the record is placed before its children are
+            if (n == nullptr) return 0;
+            auto& pool = tree.pool;
+            const auto k = static_cast<size_t>(n->kind);
+            const size_t at = pool.size(), start = scratch.size();
+            pool.resize(at + 1 + widths()[k]);
+            fields(*this, n->kind, n);
+            copy(scratch.begin() + start, scratch.end(), pool.begin() + at + 1);
+            scratch.resize(start);
+            if (pool.size() >> (32 - KindBits)) { cerr << "fatal error: too many nodes\n"; exit(EXIT_FAILURE); }
+            pool[at] = static_cast<uint32_t>((pool.size() - at) << KindBits | k);
+            return static_cast<Handle>(at);
+        }
+    };
+
+    NodeKind kind(Handle h) const { return static_cast<NodeKind>(pool[h] & ((1u << KindBits) - 1)); }
+    size_t subtree(Handle h) const { return pool[h] >> KindBits; }   // slots of h and its descendants
+    const uint32_t* record(Handle h) const { return &pool[h + 1]; }
+    Symbol symbol(Handle h, int slot) const { return Symbol{ record(h)[slot] }; }
+    pair<const uint32_t*, uint32_t> list(uint32_t offset) const {  // elements of a list slot
+        return offset == 0 ? make_pair(nullptr, 0u) : make_pair(&extra[offset + 1], extra[offset]);
+    }
+    size_t bytes() const {
+        const size_t n = pool.size() + extra.size() + constDecl.size() + typeDecl.size() + funcDecl.size() + varDecl.size();
+        return n * sizeof(uint32_t) + imports.size() * sizeof(imports[0]);
+    }
+    // Like walk(), fn(h) is invoked in pre-order and children are skipped if it returns false.
+    // Children are in order of fields
+    template<typename F> void walk(Handle h, F&& fn) const {
+        if (h == 0) return;
+        const auto& width = widths();
+        const uint32_t* p = pool.data();    // fn could not move it
+        for (size_t i = h, end = h + (p[h] >> KindBits); i < end;) {
+            const uint32_t header = p[i];
+            i += fn(static_cast<Handle>(i)) ? 1 + width[header & ((1u << KindBits) - 1)] : header >> KindBits;
+        }
+    }
+};
+#pragma endregion
+
+// Units that parsed without diagnostics are cached if cache is given
+const auto parse(const string & filename, ParseMode mode = ParseMode::Stream, const AstCache* cache = nullptr) {
+    const auto start = chrono::steady_clock::now();
+    auto seconds = [&] { return chrono::duration<double>(chrono::steady_clock::now() - start).count(); };
+    uint64_t key{};
+    Parser p(filename, mode);   // the key is hashed from the very bytes that are parsed on a miss
+    if (cache != nullptr && filesystem::is_regular_file(filename)) {
+        key = AstCache::key(p.f, mode);
+        if (auto* unit = cache->load(key)) {
+            delete p.unit;
+            unit->file = filename;
+            unit->seconds = seconds();
+            return unit;
+        }
+    }
+    p.unit->file = filename;
+    if (!filesystem::is_regular_file(filename))
+        p.unit->diagnostics.push_back({ "fatal error", "can not open " + filename, 0, 0 });
+    else try { p.parseCompilationUnit(); } catch (TooManyErrors&) {}
+    stable_sort(p.unit->diagnostics.begin(), p.unit->diagnostics.end(), [](auto& a, auto& b) {
+        return make_pair(a.line, a.column) < make_pair(b.line, b.column);  // -tokens lexes them first
+    });
+    if (cache != nullptr && key != 0 && p.unit->diagnostics.empty()) cache->store(key, p.unit);
+    p.unit->seconds = seconds();
+    return p.unit;
+}
+// Parse files on a pool of hardware_concurrency threads, each parser owns its lexer and arena so
+// workers share nothing but the cursor. Units are returned in the order of files
+vector<CompilationUnit*> parse(const vector<string>& files, ParseMode mode = ParseMode::Stream,
+    const AstCache* cache = nullptr) {
+    vector<CompilationUnit*> units(files.size());
+    atomic<size_t> cursor{ 0 };
+    auto worker = [&] { for (size_t i; (i = cursor++) < files.size();) units[i] = parse(files[i], mode, cache); };
+    const size_t workers = min<size_t>(max(thread::hardware_concurrency(), 1u), files.size());
+    vector<thread> pool;
+    for (size_t i = 1; i < workers; i++) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+    return units;
+}
+// Parse a file an editor holds in memory, the unit keeps the text for reparse(). Text is always
+// streamed, a buffered parse only pays off when the whole file is parsed once
+CompilationUnit* parse(const string& file, string text, ParseMode mode) {
+    const auto start = chrono::steady_clock::now();
+    auto* unit = new CompilationUnit;
+    unit->file = file;
+    unit->text = move(text);
+    unit->lazy = mode == ParseMode::Lazy;
+    Parser p(unit, 0, 1, 1, 0);
+    try { p.parseCompilationUnit(); } catch (TooManyErrors&) {}
+    unit->parseErrors = unit->diagnostics.size();
+    unit->parsedBytes = unit->arena.used;
+    unit->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return unit;
+}
+// An edit of the text of a unit, `removed` bytes at offset are replaced by `inserted`
+struct TextEdit { size_t offset, removed; string_view inserted; };
+// Apply edit to a unit parsed from text. Declarations are parsed again from the one holding the edit
+// until the parser arrives at a declaration that the last parse started at the same lexer position,
+// the rest of the tree is kept and its positions are moved by the lines the edit added. The whole
+// text is parsed again if the edit touches the package clause, if errors stopped the last parse or
+// once reparsing took as much arena as the whole parse. It returns unit, or a new one replacing it
+CompilationUnit* reparse(CompilationUnit* unit, const TextEdit& edit) {
+    const auto start = chrono::steady_clock::now();
+    const size_t offset = min(edit.offset, unit->text.size()), removed = min(edit.removed, unit->text.size() - offset);
+    const string_view erased = string_view(unit->text).substr(offset, removed);
+    const int lines = static_cast<int>(count(edit.inserted.begin(), edit.inserted.end(), '\n') - count(erased.begin(), erased.end(), '\n'));
+    const auto delta = static_cast<int64_t>(edit.inserted.size()) - static_cast<int64_t>(removed);
+    unit->text.replace(offset, removed, edit.inserted);
+    auto whole = [&] {
+        auto* fresh = parse(unit->file, move(unit->text), unit->lazy ? ParseMode::Lazy : ParseMode::Stream);
+        delete unit;
+        fresh->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return fresh;
+    };
+    // the first declaration which read the edited text, the package clause read the first token of the first one
+    auto& spans = unit->spans;
+    const size_t from = find_if(spans.begin(), spans.end(), [&](const DeclSpan& s) { return s.reach >= offset; }) - spans.begin();
+    if (from == 0 || from == spans.size() || unit->parseErrors >= Parser::maxErrors || unit->reparsedBytes > unit->parsedBytes)
+        return whole();
+    const vector<DeclSpan> tail(spans.begin() + from, spans.end());
+    const vector<Diagnostic> diagnostics = move(unit->diagnostics);
+    size_t kept = unit->parseErrors;     // diagnostics of the package clause and of declarations before tail
+    for (auto& s : tail) kept -= s.errors;
+    unit->diagnostics.assign(diagnostics.begin(), diagnostics.begin() + kept);
+    spans.resize(from);
+    size_t k = 1;   // tail from k on is kept
+    const size_t used = unit->arena.used;
+    try {
+        Parser p(unit, tail[0].offset, tail[0].line, tail[0].column, tail[0].last);
+        const auto editEnd = static_cast<int64_t>(offset + edit.inserted.size());
+        for (p.t = p.next(); ; p.parseTopLevel()) {
+            if (p.t.type == TK_EOF) { k = tail.size(); break; }
+            const int64_t at = p.lexed.cur - unit->text.data();
+            if (p.t.type == OP_SEMI || p.nestLev != 0 || at < editEnd) continue;
+            while (k < tail.size() && tail[k].offset + delta < at) k++;
+            if (k < tail.size() && tail[k].offset + delta == at && tail[k].line + lines == p.lexed.line
+                && tail[k].column == p.lexed.column && tail[k].last == p.lexed.last) break;
+        }
+    } catch (TooManyErrors&) {
+        return whole();
+    }
+    unit->reparsedBytes += unit->arena.used - used;
+    auto moved = [&](Diagnostic d) { d.line += lines; return d; };
+    size_t next = kept;     // first diagnostic of tail[k]
+    for (size_t j = 0; j < k; j++) next += tail[j].errors;
+    for (size_t j = next; j < unit->parseErrors; j++) unit->diagnostics.push_back(moved(diagnostics[j]));
+    for (size_t j = k; j < tail.size(); j++) {
+        DeclSpan s = tail[j];
+        s.offset = static_cast<uint32_t>(s.offset + delta);
+        s.reach = static_cast<uint32_t>(s.reach + delta);
+        s.line += lines;
+        s.keyLine += lines;
+        spans.push_back(s);
+    }
+    unit->parseErrors = unit->diagnostics.size();
+    if (unit->parseErrors >= Parser::maxErrors) return whole();
+    // bodies parsed since keep their diagnostics, those of bodies replaced go away with them
+    const size_t shifted = spans.size() - (tail.size() - k);
+    for (size_t j = 0; j < spans.size(); j++) {
+        auto* func = spans[j].keyword == KW_func ? static_cast<FuncDecl*>(spans[j].decl) : nullptr;
+        if (func == nullptr) continue;
+        auto& body = func->funcBody;
+        if (j >= shifted) body.line += lines;
+        const auto first = diagnostics.begin() + body.firstError;
+        body.firstError = static_cast<uint32_t>(unit->diagnostics.size());
+        for (auto d = first; d != first + body.errors; ++d) unit->diagnostics.push_back(j >= shifted ? moved(*d) : *d);
+    }
+    unit->importDecl.clear(); unit->constDecl.clear(); unit->typeDecl.clear(); unit->funcDecl.clear(); unit->varDecl.clear();
+    for (auto& s : spans) {
+        if (s.decl == nullptr) continue;
+        switch (s.keyword) {
+        case KW_import: unit->importDecl.push_back(static_cast<ImportDecl*>(s.decl)); break;
+        case KW_const:  unit->constDecl.push_back(static_cast<ConstDecl*>(s.decl));   break;
+        case KW_type:   unit->typeDecl.push_back(static_cast<TypeDecl*>(s.decl));     break;
+        case KW_var:    unit->varDecl.push_back(static_cast<VarDecl*>(s.decl));       break;
+        case KW_func:   unit->funcDecl.push_back(static_cast<FuncDecl*>(s.decl));     break;
+        default:        break;
+        }
+    }
+    unit->edits++;
+    unit->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return unit;
+}
+#pragma region Constant
+// Arbitrary-precision integer of constant expressions, a sign and the magnitude in 32-bit limbs,
+// least significant first and without leading zero limbs. Limbs are kept in a u32string, up to
+// three of them fit in it without allocation as most constants do
+struct BigInt {
+    using Limbs = u32string;
+    Limbs mag;
+    bool neg = false;   // never set for zero
+    BigInt() = default;
+    BigInt(int64_t v) :neg(v < 0) {
+        for (uint64_t m = neg ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v); m != 0; m >>= 32)
+            mag.push_back(static_cast<uint32_t>(m));
+    }
+    bool zero() const { return mag.empty(); }
+    bool one() const { return !neg && mag.size() == 1 && mag[0] == 1; }
+    size_t bits() const {   // of the magnitude
+        size_t n = mag.size() * 32;
+        for (uint32_t top = mag.empty() ? 0 : mag.back(); n > 0 && (top & 0x80000000u) == 0; top <<= 1) n--;
+        return n;
+    }
+    size_t trailingZeros() const {  // of a nonzero number
+        size_t i = 0;
+        while (mag[i] == 0) i++;
+        return i * 32 + ctz64(mag[i]);
+    }
+    BigInt& trim() {
+        while (!mag.empty() && mag.back() == 0) mag.pop_back();
+        if (mag.empty()) neg = false;
+        return *this;
+    }
+    bool toInt64(int64_t& v) const {
+        if (mag.size() > 2) return false;
+        uint64_t m = 0;
+        for (size_t i = mag.size(); i-- > 0;) m = m << 32 | mag[i];
+        if (m > (neg ? uint64_t(1) << 63 : uint64_t(INT64_MAX))) return false;
+        v = static_cast<int64_t>(neg ? 0 - m : m);
+        return true;
+    }
+    static int magnitude(const Limbs& a, const Limbs& b) {
+        if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+        for (size_t i = a.size(); i-- > 0;) if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+        return 0;
+    }
+    friend int compare(const BigInt& a, const BigInt& b) {
+        if (a.neg != b.neg) return a.neg ? -1 : 1;
+        return a.neg ? -magnitude(a.mag, b.mag) : magnitude(a.mag, b.mag);
+    }
+    friend bool operator==(const BigInt& a, const BigInt& b) { return a.neg == b.neg && a.mag == b.mag; }
+    static Limbs add(const Limbs& a, const Limbs& b) {
+        if (a.size() < b.size()) return add(b, a);
+        Limbs r(a.size() + 1, 0);
+        uint64_t carry = 0;
+        for (size_t i = 0; i < a.size(); i++, carry >>= 32)
+            r[i] = static_cast<uint32_t>(carry += static_cast<uint64_t>(a[i]) + (i < b.size() ? b[i] : 0));
+        r[a.size()] = static_cast<uint32_t>(carry);
+        return r;
+    }
+    static Limbs sub(const Limbs& a, const Limbs& b) {     // a >= b
+        Limbs r(a.size(), 0);
+        int64_t borrow = 0;
+        for (size_t i = 0; i < a.size(); i++) {
+            const int64_t d = static_cast<int64_t>(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+            r[i] = static_cast<uint32_t>(d);
+            borrow = d < 0;
+        }
+        return r;
+    }
+    friend BigInt operator+(const BigInt& a, const BigInt& b) {
+        BigInt r;
+        if (a.neg == b.neg) r.mag = add(a.mag, b.mag), r.neg = a.neg;
+        else if (magnitude(a.mag, b.mag) >= 0) r.mag = sub(a.mag, b.mag), r.neg = a.neg;
+        else r.mag = sub(b.mag, a.mag), r.neg = b.neg;
+        return r.trim();
+    }
+    BigInt operator-() const {
+        BigInt r = *this;
+        r.neg = !neg && !zero();
+        return r;
+    }
+    friend BigInt operator-(const BigInt& a, const BigInt& b) { return a + -b; }
+    friend BigInt operator*(const BigInt& a, const BigInt& b) {
+        BigInt r;
+        r.mag.assign(a.mag.size() + b.mag.size(), 0);
+        for (size_t i = 0; i < a.mag.size(); i++) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < b.mag.size(); j++, carry >>= 32)
+                r.mag[i + j] = static_cast<uint32_t>(carry += static_cast<uint64_t>(a.mag[i]) * b.mag[j] + r.mag[i + j]);
+            r.mag[i + b.mag.size()] = static_cast<uint32_t>(carry);
+        }
+        r.neg = a.neg != b.neg;
+        return r.trim();
+    }
+    BigInt operator<<(size_t n) const {
+        if (zero()) return *this;
+        BigInt r;
+        r.mag.assign(n / 32, 0);
+        const unsigned s = n % 32;
+        uint32_t last = 0;
+        for (auto limb : mag) {
+            r.mag.push_back(s ? limb << s | last >> (32 - s) : limb);
+            last = limb;
+        }
+        if (s) r.mag.push_back(last >> (32 - s));
+        r.neg = neg;
+        return r.trim();
+    }
+    BigInt operator>>(size_t n) const {     // rounds toward negative infinity
+        if (neg) return -((-*this - 1) >> n) - 1;
+        BigInt r;
+        const unsigned s = n % 32;
+        for (size_t i = n / 32; i < mag.size(); i++)
+            r.mag.push_back(s ? mag[i] >> s | (i + 1 < mag.size() ? mag[i + 1] << (32 - s) : 0) : mag[i]);
+        return r.trim();
+    }
+    // the quotient rounded toward zero and the remainder, which has the sign of a
+    static pair<BigInt, BigInt> divmod(const BigInt& a, const BigInt& b) {
+        BigInt q, r;
+        q.mag.resize(a.mag.size(), 0);
+        if (b.mag.size() == 1) {
+            uint64_t rest = 0;
+            for (size_t i = a.mag.size(); i-- > 0;) {
+                rest = rest << 32 | a.mag[i];
+                q.mag[i] = static_cast<uint32_t>(rest / b.mag[0]);
+                rest %= b.mag[0];
+            }
+            r = BigInt(static_cast<int64_t>(rest));
+        } else {
+            for (size_t i = a.bits(); i-- > 0;) {
+                r = r << 1;
+                if (a.mag[i / 32] >> (i % 32) & 1) r = r + 1;
+                if (magnitude(r.mag, b.mag) >= 0) {
+                    r.mag = sub(r.mag, b.mag);
+                    r.trim();
+                    q.mag[i / 32] |= 1u << (i % 32);
+                }
+            }
+        }
+        q.neg = a.neg != b.neg;
+        r.neg = a.neg;
+        q.trim(); r.trim();
+        return { q, r };
+    }
+    // & | ^ and &^ of numbers in two's complement of unbounded width
+    static BigInt bitwise(const BigInt& a, const BigInt& b, TokenType op) {
+        const size_t n = max(a.mag.size(), b.mag.size()) + 1;
+        auto negate = [](Limbs& v) {
+            uint64_t carry = 1;
+            for (auto& limb : v) { carry += static_cast<uint32_t>(~limb); limb = static_cast<uint32_t>(carry); carry >>= 32; }
+        };
+        auto twos = [&](const BigInt& x) {
+            Limbs v(x.mag);
+            v.resize(n, 0);
+            if (x.neg) negate(v);
+            return v;
+        };
+        BigInt r;
+        r.mag = twos(a);
+        const auto y = twos(b);
+        for (size_t i = 0; i < n; i++) {
+            switch (op) {
+            case OP_BITAND: r.mag[i] &= y[i]; break;
+            case OP_BITOR:  r.mag[i] |= y[i]; break;
+            case OP_XOR:    r.mag[i] ^= y[i]; break;
+            default:        r.mag[i] &= ~y[i]; break;
+            }
+        }
+        if ((r.neg = r.mag.back() >> 31) != 0) negate(r.mag);
+        return r.trim();
+    }
+    static BigInt gcd(BigInt a, BigInt b) {     // binary, of the magnitudes
+        a.neg = b.neg = false;
+        if (a.zero() || b.zero()) return a.zero() ? b : a;
+        const size_t shift = min(a.trailingZeros(), b.trailingZeros());
+        a = a >> a.trailingZeros();
+        do {
+            b = b >> b.trailingZeros();
+            if (compare(a, b) > 0) swap(a, b);
+            b = b - a;
+        } while (!b.zero());
+        return a << shift;
+    }
+    static BigInt pow10(size_t k) {
+        BigInt p = 1;
+        for (; k >= 9; k -= 9) p = p * BigInt(1000000000);
+        for (; k > 0; k--) p = p * BigInt(10);
+        return p;
+    }
+    string str() const {
+        string s;
+        BigInt x = *this;
+        x.neg = false;
+        do {
+            auto[q, r] = divmod(x, BigInt(1000000000));
+            string digits = to_string(r.zero() ? 0 : r.mag[0]);
+            if (!q.zero()) digits.insert(0, 9 - digits.size(), '0');
+            s.insert(0, digits);
+            x = move(q);
+        } while (!x.zero());
+        return neg ? "-" + s : s;
+    }
+};
+// Value of a constant expression. A number is the fraction num / den in lowest terms, den is 1 unless
+// it's a float. Untyped constants have no type
+struct Constant {
+    enum Kind : uint8_t { Bool, String, Int, Rune, Float };   // numeric kinds are ordered, the larger one wins
+    Kind kind = Int;
+    Symbol type;
+    BigInt num, den = 1;    // a bool is num != 0
+    string str;
+    bool numeric() const { return kind >= Int; }
+    bool integer() const { return numeric() && den.one(); }
+};
+struct BasicType { enum Class : uint8_t { Signed, Unsigned, Float, String, Bool } cls; unsigned bits; };
+// Constant folding of a package, before code generation. A spec of a constant group that omits its
+// expressions gets a copy of the last ones given, and iota is replaced by the index of the spec. Then
+// every constant expression is evaluated exactly, untyped integers in up to 512 bits and floats as
+// fractions, and replaced by a literal, typed ones by a conversion of a literal to their type. Names
+// of constants become literals too, so no constant is computed at runtime. Package constants are
+// evaluated on first use in any order, names a function declares shadow them. Errors are reported
+// at the top-level declaration they are found in, what can't be evaluated is left as it is
+struct Constants {
+    static constexpr size_t IntBits = 512, FloatBits = 4096;     // of untyped integers, of either term of a float
+    static constexpr uint32_t None = UINT32_MAX;
+    enum State : uint8_t { Unseen, Busy, Done };
+    struct Entry {
+        ConstDecl* decl;
+        size_t spec, index;
+        CompilationUnit* unit;
+        State state = Unseen;
+        optional<Constant> value;
+    };
+    const Package& pkg;
+    map<Symbol, Entry> consts;                      // package constants, the first declaration of a name wins
+    map<Symbol, Expr*> types;                       // package types
+    // the declaration being folded
+    CompilationUnit* unit{};
+    const ArenaObject* decl{};
+    vector<pair<Symbol, uint32_t>> scope;           // names the function declared so far, constants index locals
+    vector<Constant> locals;
+    bitset<4096> named;                             // by symbol id, names that may be constants, most names aren't
+    const Symbol iota = symbols.intern("iota"), yes = symbols.intern("true"), no = symbols.intern("false"),
+        blank = symbols.intern("_"), len = symbols.intern("len"), intType = symbols.intern("int");
+    struct Mark {
+        Constants& c;
+        size_t scope, locals;
+        explicit Mark(Constants& c) :c(c), scope(c.scope.size()), locals(c.locals.size()) {}
+        ~Mark() { c.scope.resize(scope); c.locals.resize(locals); }
+    };
+
+    explicit Constants(const Package& pkg) :pkg(pkg) {
+        named.set(yes.id % named.size());
+        named.set(no.id % named.size());
+        for (auto* u : pkg.units) {
+            for (auto* d : u->typeDecl) for (auto&[name, type] : d->typeSpec) types.emplace(name, type);
+            ArenaScope arena(u->arena);
+            for (auto* d : u->constDecl) {
+                enter(u, d);
+                repeat(d);
+                for (size_t i = 0; i < d->idents.size(); i++)
+                    for (size_t k = 0; k < d->idents[i].size(); k++)
+                        if (d->idents[i][k] != blank) {
+                            consts.emplace(d->idents[i][k], Entry{ d, i, k, u, Unseen, nullopt });
+                            named.set(d->idents[i][k].id % named.size());
+                        }
+            }
+        }
+    }
+    // folds every declaration and the function bodies parsed so far, the rest are left to function()
+    void fold() {
+        for (auto* u : pkg.units) {
+            ArenaScope arena(u->arena);
+            for (auto* d : u->constDecl) {
+                enter(u, d);
+                for (size_t i = 0; i < d->idents.size(); i++)
+                    for (size_t k = 0; k < d->idents[i].size(); k++) {
+                        auto it = consts.find(d->idents[i][k]);
+                        if (it != consts.end() && it->second.decl == d && it->second.spec == i && it->second.index == k) constant(it->second);
+                        else spec(d, i, k);
+                    }
+            }
+            auto decls = [&](auto& list) {
+                for (auto* d : list) {
+                    enter(u, d);
+                    Mark m(*this);
+                    Node* n = d;
+                    fold(n);
+                }
+            };
+            decls(u->typeDecl);
+            decls(u->varDecl);
+            for (auto* f : u->funcDecl) if (f->funcBody.text.empty()) body(u, f);
+        }
+    }
+    // a body is folded as it's parsed, so one parsed already was folded by fold()
+    void function(FuncDecl* f) {
+        if (!f->funcBody.text.empty()) body(f->funcBody.unit, f);
+    }
+    void body(CompilationUnit* u, FuncDecl* f) {
+        enter(u, f);
+        ArenaScope arena(u->arena);
+        scope.clear(); locals.clear();
+        Node* n = f;
+        fold(n);
+    }
+    void enter(CompilationUnit* u, const ArenaObject* d) { unit = u; decl = d; }
+    // an untyped constant the body of f uses as an int value doesn't fit int, which only code
+    // generation tells from constants of other types
+    void overflows(FuncDecl* f, const Constant& c) {
+        for (auto* u : pkg.units)
+            if (find(u->funcDecl.begin(), u->funcDecl.end(), f) != u->funcDecl.end()) enter(u, f);
+        fail("constant " + text(c) + " overflows int");
+    }
+    nullopt_t fail(string message) {
+        auto span = find_if(unit->spans.begin(), unit->spans.end(), [&](const DeclSpan& s) { return s.decl == decl; });
+        const bool known = span != unit->spans.end();
+        unit->diagnostics.push_back({ "constant error", move(message), known ? span->keyLine : 0, known ? span->keyColumn : 0 });
+        return nullopt;
+    }
+#pragma region Declaration
+    // copies a tree, or rewrites it in place, with iota replaced by a literal of its value
+    struct Iota {
+        Constants& c;
+        bool copy;
+        int64_t value;
+        template<typename... T> void operator()(T&... xs) { (one(xs), ...); }
+        template<typename T> T* node(Node* n) { return copy ? new T(*static_cast<T*>(n)) : static_cast<T*>(n); }
+        template<typename T> void one(T&) {}
+        template<typename T> void one(T*& p) {
+            if (p == nullptr) return;
+            if constexpr (is_base_of_v<Node, T>) {
+                if constexpr (is_same_v<T, Expr> || is_same_v<T, Node>)
+                    if (auto* name = as<Name>(p); name != nullptr && name->name == c.iota) {
+                        p = new BasicLit(LIT_INT, symbols.intern(to_string(value)));
+                        return;
+                    }
+                p = static_cast<T*>(fields(*this, p->kind, p));
+            } else {
+                if (copy) p = new T(*p);
+                fields(*this, p);
+            }
+        }
+        template<typename T, typename A> void one(vector<T, A>& list) { for (auto& e : list) one(e); }
+        template<typename... T> void one(tuple<T...>& t) { apply([&](auto&... e) { (one(e), ...); }, t); }
+    };
+    void repeat(ConstDecl* d) {
+        vector<bool> given;
+        ExprList* last{};
+        Expr* lastType{};
+        for (size_t i = 0; i < d->idents.size(); i++) {
+            given.push_back(d->exprs[i] != nullptr);
+            if (given[i]) {
+                last = d->exprs[i];
+                lastType = d->type[i];
+            } else if (last != nullptr && d->type[i] == nullptr) {
+                Iota{ *this, true, static_cast<int64_t>(i) }.one(d->exprs[i] = last);
+                d->type[i] = lastType;
+            }
+        }
+        for (size_t i = 0; i < d->idents.size(); i++) if (given[i]) Iota{ *this, false, static_cast<int64_t>(i) }.one(d->exprs[i]);
+    }
+    optional<Constant> constant(Entry& e) {
+        if (e.state == Done) return e.value;
+        const Symbol name = e.decl->idents[e.spec][e.index];
+        if (e.state == Busy) return fail("initialization cycle: " + string(name.str()) + " refers to itself");
+        e.state = Busy;
+        auto savedScope = move(scope);
+        auto savedLocals = move(locals);
+        const auto savedUnit = unit;
+        const auto savedDecl = decl;
+        scope.clear(); locals.clear();
+        enter(e.unit, e.decl);
+        {
+            ArenaScope arena(e.unit->arena);
+            e.value = spec(e.decl, e.spec, e.index);
+        }
+        scope = move(savedScope);
+        locals = move(savedLocals);
+        enter(savedUnit, savedDecl);
+        e.state = Done;
+        return e.value;
+    }
+    // value of the k-th name of spec i, its expression is replaced by the literal
+    optional<Constant> spec(ConstDecl* d, size_t i, size_t k) {
+        if (d->exprs[i] == nullptr || k >= d->exprs[i]->exprs.size()) return nullopt;
+        Expr*& e = d->exprs[i]->exprs[k];
+        auto c = value(e);
+        if (!c) return nullopt;
+        if (d->type[i] != nullptr) {
+            auto* type = as<Name>(d->type[i]);
+            if (type == nullptr || !basic(type->name)) return nullopt;
+            if (!(c = convert(*c, type->name, false))) return nullopt;
+        }
+        if (!isLiteral(e)) e = literal(*c, d->type[i] == nullptr);
+        return c;
+    }
+    void declare(Symbol name, const optional<Constant>& c = nullopt) {
+        if (name == blank) return;
+        if (c) {
+            locals.push_back(*c);
+            named.set(name.id % named.size());
+        }
+        scope.emplace_back(name, c ? static_cast<uint32_t>(locals.size() - 1) : None);
+    }
+    bool declared(Symbol name) const {
+        return any_of(scope.begin(), scope.end(), [&](auto& s) { return s.first == name; });
+    }
+    optional<Constant> lookup(Symbol name) {
+        if (!named[name.id % named.size()]) return nullopt;
+        for (auto i = scope.rbegin(); i != scope.rend(); ++i)
+            if (i->first == name) return i->second != None ? optional<Constant>(locals[i->second]) : nullopt;
+        if (auto it = consts.find(name); it != consts.end()) return constant(it->second);
+        if (name != yes && name != no) return nullopt;
+        Constant c;
+        c.kind = Constant::Bool;
+        c.num = name == yes;
+        return c;
+    }
+    // underlying type of a type name the function doesn't declare, if it's a basic one
+    optional<BasicType> basic(Symbol type, int depth = 0) const {
+        if (declared(type)) return nullopt;
+        if (auto it = types.find(type); it != types.end()) {
+            auto* name = as<Name>(it->second);
+            return name != nullptr && depth < 16 ? basic(name->name, depth + 1) : nullopt;
+        }
+        static const map<string_view, BasicType> predeclared = {
+            { "int8", { BasicType::Signed, 8 } }, { "int16", { BasicType::Signed, 16 } }, { "int32", { BasicType::Signed, 32 } },
+            { "int64", { BasicType::Signed, 64 } }, { "int", { BasicType::Signed, 64 } }, { "rune", { BasicType::Signed, 32 } },
+            { "uint8", { BasicType::Unsigned, 8 } }, { "uint16", { BasicType::Unsigned, 16 } }, { "uint32", { BasicType::Unsigned, 32 } },
+            { "uint64", { BasicType::Unsigned, 64 } }, { "uint", { BasicType::Unsigned, 64 } }, { "uintptr", { BasicType::Unsigned, 64 } },
+            { "byte", { BasicType::Unsigned, 8 } }, { "float32", { BasicType::Float, 32 } }, { "float64", { BasicType::Float, 64 } },
+            { "string", { BasicType::String, 0 } }, { "bool", { BasicType::Bool, 0 } } };
+        auto it = predeclared.find(type.str());
+        return it != predeclared.end() ? optional<BasicType>(it->second) : nullopt;
+    }
+    Symbol identity(Symbol type) const {     // byte and rune are aliases
+        const string_view s = type.str();
+        return s == "byte" ? symbols.intern("uint8") : s == "rune" ? symbols.intern("int32") : type;
+    }
+#pragma endregion
+#pragma region Arithmetic
+    static void normalize(Constant& c) {
+        if (c.den.neg) { c.num = -c.num; c.den = -c.den; }
+        if (c.num.zero()) { c.den = 1; return; }
+        if (const BigInt g = BigInt::gcd(c.num, c.den); !g.one()) {
+            c.num = BigInt::divmod(c.num, g).first;
+            c.den = BigInt::divmod(c.den, g).first;
+        }
+    }
+    // rounds c to the nearest number of mant significant bits, bits below 2^minExp are lost. False if
+    // it's 2^(maxExp + 1) or more
+    static bool round(Constant& c, int mant, long maxExp, long minExp) {
+        if (c.num.zero()) return true;
+        const bool neg = c.num.neg;
+        BigInt a = c.num;
+        a.neg = false;
+        long e = static_cast<long>(a.bits()) - static_cast<long>(c.den.bits());   // 2^e <= a / den < 2^(e + 1)
+        if (e >= 0 ? compare(a, c.den << e) < 0 : compare(a << -e, c.den) < 0) e--;
+        if (e > maxExp) return false;
+        const long bits = e >= minExp ? mant : mant - (minExp - e);
+        if (bits <= 0) {
+            c.num = 0; c.den = 1;
+            return true;
+        }
+        const long s = bits - 1 - e;
+        const BigInt d = s < 0 ? c.den << -s : c.den;
+        auto[q, r] = BigInt::divmod(s > 0 ? a << s : a, d);
+        if (const int half = compare(r << 1, d); half > 0 || (half == 0 && !q.zero() && (q.mag[0] & 1))) q = q + 1;
+        if (static_cast<long>(q.bits()) > bits && e + 1 > maxExp) return false;
+        if (s <= 0) {
+            c.num = q << -s;
+            c.den = 1;
+        } else {
+            const size_t tz = min<size_t>(q.trailingZeros(), s);
+            c.num = q >> tz;
+            c.den = BigInt(1) << (s - tz);
+        }
+        c.num.neg = neg;
+        return true;
+    }
+    static bool fits(const BigInt& v, BasicType t) {
+        if (t.cls == BasicType::Unsigned) return !v.neg && v.bits() <= t.bits;
+        return v.bits() < t.bits || (v.neg && v.bits() == t.bits && v.trailingZeros() == t.bits - 1);
+    }
+    // c converted to type by T(c), or as it's assigned to a constant of the type if not explicitly
+    optional<Constant> convert(Constant c, Symbol type, bool explicitly) {
+        const auto t = basic(type);
+        if (!t) return nullopt;
+        if (!explicitly && c.type != Symbol{} && identity(c.type) != identity(type))
+            return fail("cannot use " + text(c) + " (constant of type " + string(c.type.str()) + ") as " + string(type.str()) + " value");
+        auto cannot = [&] { return fail("cannot convert " + text(c) + " (" + describe(c) + " constant) to type " + string(type.str())); };
+        switch (t->cls) {
+        case BasicType::Bool:
+            if (c.kind != Constant::Bool) return cannot();
+            break;
+        case BasicType::String:
+            if (c.kind == Constant::String) break;
+            if (!explicitly || !c.integer()) return cannot();
+            {
+                int64_t r;
+                if (!c.num.toInt64(r) || r < 0 || r > 0x10FFFF || inrange(r, 0xD800, 0xDFFF)) r = 0xFFFD;
+                c.str.clear();
+                utf8(c.str, static_cast<uint32_t>(r));
+                c.kind = Constant::String;
+                c.num = 0;
+            }
+            break;
+        case BasicType::Float:
+            if (!c.numeric()) return cannot();
+            if (!round(c, t->bits == 32 ? 24 : 53, t->bits == 32 ? 127 : 1023, t->bits == 32 ? -126 : -1022))
+                return fail("constant " + text(c) + " overflows " + string(type.str()));
+            c.kind = Constant::Float;
+            break;
+        default:
+            if (!c.numeric()) return cannot();
+            if (!c.integer()) return fail("constant " + text(c) + " truncated to integer");
+            if (!fits(c.num, *t)) return fail("constant " + text(c) + " overflows " + string(type.str()));
+            if (c.kind == Constant::Float) c.kind = Constant::Int;
+        }
+        c.type = type;
+        return c;
+    }
+    // typed results must be representable by their type, untyped ones are kept in bounds
+    optional<Constant> finish(Constant c) {
+        if (c.kind == Constant::Float) normalize(c);
+        if (c.type != Symbol{}) {
+            const Symbol type = c.type;
+            return convert(move(c), type, true);
+        }
+        if (c.kind != Constant::Float ? c.num.bits() > IntBits
+            : max(c.num.bits(), c.den.bits()) > FloatBits && !round(c, IntBits, 1L << 20, -(1L << 20)))
+            return fail("constant overflow");
+        return c;
+    }
+    // of two operands, the untyped one is converted to the type of the other, and the untyped number of
+    // a lower kind takes the kind of the other
+    bool match(Constant& x, Constant& y) {
+        if (x.type != Symbol{} && y.type != Symbol{}) {
+            if (identity(x.type) == identity(y.type)) return true;
+            fail("invalid operation: mismatched types " + string(x.type.str()) + " and " + string(y.type.str()));
+            return false;
+        }
+        if (x.type != Symbol{} || y.type != Symbol{}) {
+            Constant& u = x.type != Symbol{} ? y : x;
+            auto c = convert(u, (x.type != Symbol{} ? x : y).type, false);
+            if (c) u = move(*c);
+            return c.has_value();
+        }
+        if (x.numeric() && y.numeric()) x.kind = y.kind = max(x.kind, y.kind);
+        else if (x.kind != y.kind) {
+            fail("invalid operation: mismatched types " + describe(x) + " and " + describe(y));
+            return false;
+        }
+        return true;
+    }
+    optional<Constant> undefined(TokenType op, const Constant& x) {
+        return fail("invalid operation: operator " + string(spelling(op)) + " not defined on " + text(x) + " (" + describe(x) + " constant)");
+    }
+    optional<Constant> unary(TokenType op, Constant x) {
+        switch (op) {
+        case OP_ADD: if (x.numeric()) return x; break;
+        case OP_SUB:
+            if (!x.numeric()) break;
+            x.num = -x.num;
+            return finish(move(x));
+        case OP_XOR:
+            if (!anyone(x.kind, Constant::Int, Constant::Rune)) break;
+            if (auto t = x.type != Symbol{} ? basic(x.type) : nullopt; t && t->cls == BasicType::Unsigned)
+                x.num = BigInt::bitwise(x.num, (BigInt(1) << t->bits) - 1, OP_XOR);
+            else x.num = -x.num - 1;
+            return finish(move(x));
+        case OP_NOT:
+            if (x.kind != Constant::Bool) break;
+            x.num = x.num.zero();
+            return x;
+        default: return nullopt;    // & * <- take no constants
+        }
+        return undefined(op, x);
+    }
+    optional<Constant> shift(TokenType op, Constant x, const Constant& y) {
+        if (!y.integer() || (y.type != Symbol{} && y.kind == Constant::Float)) return fail("invalid shift count " + text(y));
+        if (y.num.neg) return fail("invalid negative shift count " + text(y));
+        if (!x.integer() || (x.type != Symbol{} && x.kind == Constant::Float)) return fail("invalid shift of " + text(x));
+        if (x.kind == Constant::Float) x.kind = Constant::Int;
+        int64_t n;
+        if (!y.num.toInt64(n) || n > static_cast<int64_t>(IntBits)) {
+            if (op == OP_LSHIFT && !x.num.zero()) return fail("shift count too large: " + text(y));
+            n = IntBits + 1;
+        }
+        x.num = op == OP_LSHIFT ? x.num << n : x.num >> n;
+        return finish(move(x));
+    }
+    optional<Constant> binary(TokenType op, Constant x, Constant y) {
+        if (anyone(op, OP_LSHIFT, OP_RSHIFT)) return shift(op, move(x), y);
+        if (!match(x, y)) return nullopt;
+        Constant r = x;
+        if (anyone(op, OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE)) {
+            int order;
+            if (x.kind == Constant::String) order = x.str.compare(y.str);
+            else if (x.numeric()) order = compare(x.num * y.den, y.num * x.den);
+            else if (anyone(op, OP_EQ, OP_NE)) order = compare(x.num, y.num);
+            else return undefined(op, x);
+            r = Constant{};
+            r.kind = Constant::Bool;
+            r.num = op == OP_EQ ? order == 0 : op == OP_NE ? order != 0 : op == OP_LT ? order < 0
+                : op == OP_LE ? order <= 0 : op == OP_GT ? order > 0 : order >= 0;
+            return r;
+        }
+        if (anyone(op, OP_AND, OP_OR)) {
+            if (x.kind != Constant::Bool) return undefined(op, x);
+            r.num = op == OP_AND ? !x.num.zero() && !y.num.zero() : !x.num.zero() || !y.num.zero();
+            return r;
+        }
+        if (x.kind == Constant::String && op == OP_ADD) {
+            r.str += y.str;
+            return r;
+        }
+        if (!x.numeric()) return undefined(op, x);
+        const bool fraction = x.kind == Constant::Float;
+        switch (op) {
+        case OP_ADD: r.num = x.num * y.den + y.num * x.den; r.den = x.den * y.den; break;
+        case OP_SUB: r.num = x.num * y.den - y.num * x.den; r.den = x.den * y.den; break;
+        case OP_MUL: r.num = x.num * y.num; r.den = x.den * y.den; break;
+        case OP_DIV: case OP_MOD:
+            if (y.num.zero()) return fail("invalid operation: division by zero");
+            if (!fraction) r.num = op == OP_DIV ? BigInt::divmod(x.num, y.num).first : BigInt::divmod(x.num, y.num).second;
+            else if (op == OP_MOD) return undefined(op, x);
+            else { r.num = x.num * y.den; r.den = x.den * y.num; }
+            break;
+        case OP_BITAND: case OP_BITOR: case OP_XOR: case OP_ANDXOR:
+            if (fraction) return undefined(op, x);
+            r.num = BigInt::bitwise(x.num, y.num, op);
+            break;
+        default: return nullopt;
+        }
+        return finish(move(r));
+    }
+#pragma endregion
+#pragma region Literal
+    static int digit(char c) { return inrange(c, '0', '9') ? c - '0' : inrange(c | 0x20, 'a', 'z') ? (c | 0x20) - 'a' + 10 : 99; }
+    static bool integer(string_view s, BigInt& v) {
+        int base = 10;
+        if (s.size() > 1 && s[0] == '0') {
+            switch (s[1] | 0x20) {
+            case 'x': base = 16; s.remove_prefix(2); break;
+            case 'b': base = 2;  s.remove_prefix(2); break;
+            case 'o': base = 8;  s.remove_prefix(2); break;
+            default:  base = 8;  s.remove_prefix(1); break;
+            }
+        }
+        v = 0;
+        int64_t chunk = 0, scale = 1;   // digits since v was last updated
+        for (char c : s) {
+            if (c == '_') continue;
+            const int d = digit(c);
+            if (d >= base) return false;
+            if (scale > INT64_MAX / 16 / base) {
+                v = v * BigInt(scale) + BigInt(chunk);
+                chunk = 0, scale = 1;
+            }
+            chunk = chunk * base + d, scale *= base;
+        }
+        v = v.zero() ? BigInt(chunk) : v * BigInt(scale) + BigInt(chunk);
+        return true;
+    }
+    // a decimal or hexadecimal float, exponents beyond what the evaluator keeps are not read
+    static bool floating(string_view s, Constant& c) {
+        const bool hex = s.size() > 1 && s[0] == '0' && (s[1] | 0x20) == 'x';
+        const int base = hex ? 16 : 10;
+        if (hex) s.remove_prefix(2);
+        long exp = 0, e = 0;
+        bool point = false;
+        size_t i = 0;
+        for (; i < s.size() && (s[i] | 0x20) != (hex ? 'p' : 'e'); i++) {
+            if (s[i] == '_') continue;
+            if (s[i] == '.') { point = true; continue; }
+            const int d = digit(s[i]);
+            if (d >= base) return false;
+            c.num = c.num * BigInt(base) + BigInt(d);
+            if (point) exp -= hex ? 4 : 1;
+        }
+        if (i < s.size()) {
+            const bool neg = ++i < s.size() && s[i] == '-';
+            if (i < s.size() && anyone(s[i], '-', '+')) i++;
+            for (; i < s.size(); i++) if (s[i] != '_' && (e = e * 10 + s[i] - '0') > 100000) return false;
+            exp += neg ? -e : e;
+        }
+        if (hex ? labs(exp) > 20000 : labs(exp) > 5000) return false;
+        if (hex) (exp >= 0 ? c.num : c.den) = (exp >= 0 ? c.num : c.den) << labs(exp);
+        else if (exp >= 0) c.num = c.num * BigInt::pow10(exp);
+        else c.den = BigInt::pow10(-exp);
+        normalize(c);
+        return true;
+    }
+    static void utf8(string& s, uint32_t r) {
+        if (r < 0x80) s += static_cast<char>(r);
+        else if (r < 0x800) { s += static_cast<char>(0xC0 | r >> 6); s += static_cast<char>(0x80 | (r & 0x3F)); }
+        else if (r < 0x10000) {
+            s += static_cast<char>(0xE0 | r >> 12); s += static_cast<char>(0x80 | (r >> 6 & 0x3F)); s += static_cast<char>(0x80 | (r & 0x3F));
+        } else {
+            s += static_cast<char>(0xF0 | r >> 18); s += static_cast<char>(0x80 | (r >> 12 & 0x3F));
+            s += static_cast<char>(0x80 | (r >> 6 & 0x3F)); s += static_cast<char>(0x80 | (r & 0x3F));
+        }
+    }
+    // contents of a string or rune literal, escapes resolved
+    static string unquote(string_view lit) {
+        string s;
+        if (lit.size() < 2) return s;
+        const char quote = lit[0];
+        lit = lit.substr(1, lit.size() - 2);
+        for (size_t i = 0; i < lit.size(); i++) {
+            char c = lit[i];
+            if (quote == '`' || c != '\\' || i + 1 >= lit.size()) {
+                if (c != '\r' || quote != '`') s += c;
+                continue;
+            }
+            switch (c = lit[++i]) {
+            case 'a': s += '\a'; break;
+            case 'b': s += '\b'; break;
+            case 'f': s += '\f'; break;
+            case 'n': s += '\n'; break;
+            case 'r': s += '\r'; break;
+            case 't': s += '\t'; break;
+            case 'v': s += '\v'; break;
+            case 'x': case 'u': case 'U': {
+                uint32_t r = 0;
+                for (int k = c == 'x' ? 2 : c == 'u' ? 4 : 8; k > 0 && i + 1 < lit.size(); k--) r = r * 16 + digit(lit[++i]);
+                if (c == 'x') s += static_cast<char>(r);
+                else utf8(s, r);
+                break;
+            }
+            default:
+                if (inrange(c, '0', '7')) {
+                    int r = c - '0';
+                    for (int k = 0; k < 2 && i + 1 < lit.size(); k++) r = r * 8 + lit[++i] - '0';
+                    s += static_cast<char>(r);
+                } else s += c;
+            }
+        }
+        return s;
+    }
+    static int64_t rune(string_view lit) {
+        const string s = unquote(lit);
+        if (s.size() <= 1) return s.empty() ? 0 : static_cast<unsigned char>(s[0]);    // a byte escape or ASCII
+        const auto lead = static_cast<unsigned char>(s[0]);
+        const int n = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : 1;
+        int64_t r = lead & (0x3F >> n);
+        for (int k = 1; k <= n && k < static_cast<int>(s.size()); k++) r = r << 6 | (s[k] & 0x3F);
+        return r;
+    }
+    // value of a literal, none if it's imaginary or malformed
+    static optional<Constant> parse(BasicLit* lit) {
+        const string_view s = lit->value.str();
+        Constant c;
+        switch (lit->type) {
+        case LIT_INT:   if (!integer(s, c.num)) return nullopt; break;
+        case LIT_RUNE:  c.kind = Constant::Rune; c.num = rune(s); break;
+        case LIT_FLOAT: c.kind = Constant::Float; if (!floating(s, c)) return nullopt; break;
+        case LIT_STR:   c.kind = Constant::String; c.str = unquote(s); break;
+        default:        return nullopt;
+        }
+        return c;
+    }
+    static string quote(const string& s) {
+        string q = "\"";
+        for (unsigned char c : s) {
+            if (c == '"' || c == '\\') q += '\\';
+            if (inrange(c, 0x20, 0x7E)) q += static_cast<char>(c);
+            else if (c == '\n') q += "\\n";
+            else if (c == '\t') q += "\\t";
+            else {
+                char hex[8];
+                snprintf(hex, sizeof(hex), "\\x%02x", c);
+                q += hex;
+            }
+        }
+        return q + '"';
+    }
+    // a float in positional notation if it's exact and short, else in 36 significant digits
+    static string decimal(const BigInt& num, const BigInt& den) {
+        BigInt rest = den >> den.trailingZeros();
+        size_t fives = 0;
+        for (pair<BigInt, BigInt> qr; (qr = BigInt::divmod(rest, 5)).second.zero(); fives++) rest = qr.first;
+        if (rest.one()) {
+            const size_t k = max(den.trailingZeros(), fives);
+            string digits = BigInt::divmod(num * BigInt::pow10(k), den).first.str();
+            if (digits.size() <= k) digits.insert(0, k + 1 - digits.size(), '0');
+            const string s = digits.substr(0, digits.size() - k) + "." + (k != 0 ? digits.substr(digits.size() - k) : "0");
+            if (s.size() <= 80) return s;
+        }
+        for (long e = static_cast<long>((static_cast<long>(num.bits()) - static_cast<long>(den.bits())) * 0.30103);;) {
+            const long p = 35 - e;
+            const BigInt a = p >= 0 ? num * BigInt::pow10(p) : num, b = p >= 0 ? den : den * BigInt::pow10(-p);
+            auto[q, r] = BigInt::divmod(a, b);
+            if (compare(r << 1, b) >= 0) q = q + 1;
+            string digits = q.str();
+            if (digits.size() != 36) {
+                e += digits.size() > 36 ? 1 : -1;
+                continue;
+            }
+            digits.erase(digits.find_last_not_of('0') + 1);
+            return digits.substr(0, 1) + "." + (digits.size() > 1 ? digits.substr(1) : "0") + "e" + to_string(e);
+        }
+    }
+    static string text(const Constant& c) {
+        switch (c.kind) {
+        case Constant::Bool:   return c.num.zero() ? "false" : "true";
+        case Constant::String: return quote(c.str);
+        case Constant::Float:  return (c.num.neg ? "-" : "") + decimal(c.num.neg ? -c.num : c.num, c.den);
+        default:               return c.num.str();
+        }
+    }
+    static string describe(const Constant& c) {
+        constexpr string_view kinds[] = { "bool", "string", "int", "rune", "float" };
+        return c.type != Symbol{} ? string(c.type.str()) : "untyped " + string(kinds[c.kind]);
+    }
+    // the literal of c, a typed constant is converted to its type when typed is set
+    Expr* literal(const Constant& c, bool typed) {
+        Expr* e;
+        int64_t r = -1;
+        if (c.kind == Constant::Bool) {
+            auto* name = new Name;
+            name->name = c.num.zero() ? no : yes;
+            e = name;
+        } else if (c.kind == Constant::String) e = new BasicLit(LIT_STR, symbols.intern(quote(c.str)));
+        else {
+            const BigInt abs = c.num.neg ? -c.num : c.num;
+            if (c.kind == Constant::Float) e = new BasicLit(LIT_FLOAT, symbols.intern(decimal(abs, c.den)));
+            else if (c.kind == Constant::Rune && abs.toInt64(r) && r <= 0x10FFFF && !inrange(r, 0xD800, 0xDFFF)) {
+                char spelled[16];
+                if (inrange(r, 0x20, 0x7E) && r != '\'' && r != '\\') snprintf(spelled, sizeof(spelled), "'%c'", static_cast<char>(r));
+                else snprintf(spelled, sizeof(spelled), r < 0x80 ? "'\\x%02x'" : r < 0x10000 ? "'\\u%04x'" : "'\\U%08x'", static_cast<unsigned>(r));
+                e = new BasicLit(LIT_RUNE, symbols.intern(spelled));
+            } else e = new BasicLit(LIT_INT, symbols.intern(abs.str()));
+            if (c.num.neg) {
+                auto* minus = new BasicExpr;
+                minus->lhs = e;
+                minus->op = OP_SUB;
+                e = minus;
+            }
+        }
+        if (!typed || c.type == Symbol{}) return e;
+        auto* call = new CallExpr;
+        auto* type = new Name;
+        type->name = c.type;
+        call->operand = type;
+        call->arguments = new ExprList;
+        call->arguments->exprs.push_back(e);
+        return call;
+    }
+    // a literal, maybe negated or converted, which folding would spell again
+    bool isLiteral(Expr* e) const {
+        if (auto* call = as<CallExpr>(e); call != nullptr && as<Name>(call->operand) != nullptr && !call->isVariadic
+            && call->arguments != nullptr && call->arguments->exprs.size() == 1) e = call->arguments->exprs[0];
+        if (auto* minus = as<BasicExpr>(e); minus != nullptr && minus->rhs == nullptr && minus->op == OP_SUB) e = minus->lhs;
+        auto* name = as<Name>(e);
+        return as<BasicLit>(e) != nullptr || (name != nullptr && (name->name == yes || name->name == no));
+    }
+#pragma endregion
+#pragma region Fold
+    // visits children of a node, constant expressions among them are replaced by literals
+    struct Visit {
+        Constants& c;
+        template<typename... T> void operator()(T&... xs) { (one(xs), ...); }
+        template<typename T> T* node(Node* n) { return static_cast<T*>(n); }
+        template<typename T> void one(T&) {}
+        template<typename T> void one(T*& p) {
+            if (p == nullptr) return;
+            if constexpr (is_base_of_v<Node, T>) {
+                Node* n = p;
+                const auto k = c.fold(n);
+                if constexpr (is_same_v<T, Expr> || is_same_v<T, Node>)
+                    if (k && !c.isLiteral(static_cast<Expr*>(n))) n = c.literal(*k, true);
+                p = static_cast<T*>(n);
+            } else fields(*this, p);
+        }
+        template<typename T, typename A> void one(vector<T, A>& list) { for (auto& e : list) one(e); }
+        template<typename... T> void one(tuple<T...>& t) { apply([&](auto&... e) { (one(e), ...); }, t); }
+    };
+    template<typename T> void visit(T*& p) { Visit{ *this }.one(p); }
+    optional<Constant> value(Expr*& e) {
+        Node* n = e;
+        auto c = fold(n);
+        e = static_cast<Expr*>(n);
+        return c;
+    }
+    void spell(Expr*& e, const optional<Constant>& c) { if (c && !isLiteral(e)) e = literal(*c, true); }
+    // keys of array, slice and map literals are values, a bare name may be a field of a struct otherwise
+    void elements(LitValue* v, bool valueKeys) {
+        if (v == nullptr) return;
+        for (auto&[key, elem] : v->keyedElement) {
+            if (key != nullptr && (valueKeys || as<Name>(key) == nullptr)) visit(key);
+            if (auto* inner = as<LitValue>(elem)) elements(inner, false);
+            else visit(elem);
+        }
+    }
+    // conversions of constants to basic types and len of constant strings are constants
+    optional<Constant> call(CallExpr* e) {
+        auto* name = as<Name>(e->operand);
+        visit(e->type);
+        if (name == nullptr || e->isVariadic || e->arguments == nullptr || e->arguments->exprs.size() != 1) {
+            if (name == nullptr) visit(e->operand);
+            visit(e->arguments);
+            return nullopt;
+        }
+        Expr*& arg = e->arguments->exprs[0];
+        const auto c = value(arg);
+        if (c && name->name == len && c->kind == Constant::String && !declared(len)) {
+            Constant n;
+            n.type = intType;
+            n.num = static_cast<int64_t>(c->str.size());
+            return n;
+        }
+        if (c && basic(name->name)) if (auto r = convert(*c, name->name, true)) return r;
+        spell(arg, c);
+        return nullopt;
+    }
+    // folds the constant expressions of n, and returns its value if n is one
+    optional<Constant> fold(Node*& n) {
+        if (n == nullptr) return nullopt;
+        switch (n->kind) {
+        case NodeKind::BasicLit: return parse(static_cast<BasicLit*>(n));
+        case NodeKind::Name: return lookup(static_cast<Name*>(n)->name);
+        case NodeKind::BasicExpr: {
+            auto* e = static_cast<BasicExpr*>(n);
+            const auto x = value(e->lhs);
+            const auto y = e->rhs != nullptr ? value(e->rhs) : nullopt;
+            if (x && e->rhs == nullptr) if (auto r = unary(e->op, *x)) return r;
+            if (x && y) if (auto r = binary(e->op, *x, *y)) return r;
+            spell(e->lhs, x);
+            if (e->rhs != nullptr) spell(e->rhs, y);
+            return nullopt;
+        }
+        case NodeKind::CallExpr: return call(static_cast<CallExpr*>(n));
+        case NodeKind::CompositeLit: {
+            auto* e = static_cast<CompositeLit*>(n);
+            visit(e->litName);
+            elements(e->litValue, e->litName != nullptr && anyone(e->litName->kind, NodeKind::ArrayType, NodeKind::SliceType, NodeKind::MapType));
+            return nullopt;
+        }
+        case NodeKind::LitValue: elements(static_cast<LitValue*>(n), false); return nullopt;
+        case NodeKind::StmtList: {
+            Mark m(*this);
+            for (auto*& s : static_cast<StmtList*>(n)->stmts) visit(s);
+            return nullopt;
+        }
+        case NodeKind::IfStmt: {
+            auto* s = static_cast<IfStmt*>(n);
+            Mark m(*this);
+            visit(s->init); visit(s->cond); visit(s->ifBlock); visit(s->elseBlock);
+            return nullopt;
+        }
+        case NodeKind::ForStmt: {
+            auto* s = static_cast<ForStmt*>(n);
+            Mark m(*this);
+            visit(s->init); visit(s->cond); visit(s->post); visit(s->block);
+            return nullopt;
+        }
+        case NodeKind::SwitchStmt: {
+            auto* s = static_cast<SwitchStmt*>(n);
+            Mark m(*this);
+            visit(s->init); visit(s->cond);
+            for (auto&[exprs, stmts] : s->caseList) { Mark clause(*this); visit(exprs); visit(stmts); }
+            return nullopt;
+        }
+        case NodeKind::SelectStmt:
+            for (auto&[comm, stmts] : static_cast<SelectStmt*>(n)->caseList) { Mark clause(*this); visit(comm); visit(stmts); }
+            return nullopt;
+        case NodeKind::SAssignStmt: {
+            auto* s = static_cast<SAssignStmt*>(n);
+            visit(s->rhs);
+            for (auto name : s->lhs) declare(name);
+            return nullopt;
+        }
+        case NodeKind::SRangeClause: {
+            auto* s = static_cast<SRangeClause*>(n);
+            visit(s->rhs);
+            for (auto name : s->lhs) declare(name);
+            return nullopt;
+        }
+        case NodeKind::AssignStmt: case NodeKind::RangeClause: {   // names assigned to stay names
+            auto* lhs = n->kind == NodeKind::AssignStmt ? static_cast<AssignStmt*>(n)->lhs : static_cast<RangeClause*>(n)->lhs;
+            if (lhs != nullptr) for (auto*& e : lhs->exprs) if (as<Name>(e) == nullptr) visit(e);
+            if (n->kind == NodeKind::AssignStmt) visit(static_cast<AssignStmt*>(n)->rhs);
+            else visit(static_cast<RangeClause*>(n)->rhs);
+            return nullopt;
+        }
+        case NodeKind::IncDecStmt:
+            if (as<Name>(static_cast<IncDecStmt*>(n)->expr) == nullptr) visit(static_cast<IncDecStmt*>(n)->expr);
+            return nullopt;
+        case NodeKind::VarDecl:
+            for (auto* spec : static_cast<VarDecl*>(n)->varSpec) {
+                if (spec == nullptr) continue;
+                visit(spec->type); visit(spec->exprs);
+                for (auto name : spec->idents) declare(name);
+            }
+            return nullopt;
+        case NodeKind::TypeDecl:
+            for (auto&[name, type] : static_cast<TypeDecl*>(n)->typeSpec) { declare(name); visit(type); }
+            return nullopt;
+        case NodeKind::ConstDecl: {     // of a function, package ones are folded by fold()
+            auto* d = static_cast<ConstDecl*>(n);
+            repeat(d);
+            for (size_t i = 0; i < d->idents.size(); i++) {
+                vector<optional<Constant>> values;
+                for (size_t k = 0; k < d->idents[i].size(); k++) values.push_back(spec(d, i, k));
+                for (size_t k = 0; k < d->idents[i].size(); k++) declare(d->idents[i][k], values[k]);
+            }
+            return nullopt;
+        }
+        case NodeKind::FuncDecl: {
+            auto* f = static_cast<FuncDecl*>(n);
+            Mark m(*this);
+            auto params = [&](Param* p) {
+                if (p != nullptr) for (auto* d : p->paramList) { visit(d->type); if (d->hasName) declare(d->name); }
+            };
+            params(f->receiver);
+            if (f->signature != nullptr) { params(f->signature->param); params(f->signature->resultParam); visit(f->signature->resultType); }
+            StmtList* body = f->funcBody;
+            visit(body);
+            return nullopt;
+        }
+        default: {
+            Visit v{ *this };
+            fields(v, n->kind, n);
+            return nullopt;
+        }
+        }
+    }
+#pragma endregion
+};
+#pragma endregion
+
+#pragma region Codegen
+// Register bytecode that codegen() emits. An instruction is an opcode and three 16-bit operands,
+// they are registers of the frame, an index into constants or strings, an immediate or a target:
+//   LoadI a b         R[a] = int16(b)              LoadK a b         R[a] = consts[b]
+//   Move a b          R[a] = R[b]                  Add..Le a b c     R[a] = R[b] op R[c]
+//   AddI a b c        R[a] = R[b] + int16(c)       Neg/Not/Com a b   R[a] = op R[b]
+//   Jump c            goto c                       JumpIf(Not) a c   goto c if R[a] is (not) 0
+//   JumpEq..Le a b c  goto c if R[a] op R[b]       Call a b c        R[a] = funcs[b](R[c], ...)
+//   Ret a b           return R[a] if b is 1        Print a b c       print R[a], strings[a], nothing
+//   Go b c            go funcs[b](R[c], ...)                         or bool R[a] as b is 0..3, then char c
+//   Yield             runtime.Gosched()            MakeChan a b      R[a] = make(chan int, R[b])
+//   Send a b          R[a] <- R[b]                 Recv a b          R[a] = <-R[b]
+//   Close a           close(R[a])                  Select a b c      R[a] = the case selects[b] chose, its
+//   Received a        R[a] = what the last select                    channels and values are R[c], ...
+//                     received                     MakeSlice a b     R[a] = make([]int, R[b])
+//   Index a b c       R[a] = R[b][R[c]]            SetIndex a b c    R[a][R[b]] = R[c]
+//   Len a b           R[a] = len(R[b])             MakeMap a b       R[a] = make(map[int]int, R[b])
+//   MapIndex a b c    R[a] = R[b][R[c]] of a map   MapHas a b c      R[a] = R[c] is a key of map R[b]
+//   SetMap a b c      R[a][R[b]] = R[c] of a map   Delete a b        delete(R[a], R[b])
+//   MapIter a b       R[a] = range over map R[b]   IterNext a b      R[a] = range R[b] went on to an entry
+//   IterKey a b       R[a] = the key of range R[b] IterValue a b     R[a] = the value of range R[b]
+//   Stack a           the stack holds a registers from R[0] on, else it grows. Each function starts with it
+// A slice is the address of a heap object that holds its length and then its elements, a map is the
+// address of the header of a SwissMap, whose count leads it.
+// The frame of a callee starts at register c of its caller, so arguments are already its leading registers
+#define G5_OPCODES(X) X(LoadI) X(LoadK) X(Move) X(Add) X(AddI) X(Sub) X(Mul) X(Div) X(Mod) X(And) X(Or) \
+    X(Xor) X(AndNot) X(Shl) X(Shr) X(Eq) X(Ne) X(Lt) X(Le) X(Neg) X(Not) X(Com) X(Jump) X(JumpIf) \
+    X(JumpIfNot) X(JumpEq) X(JumpNe) X(JumpLt) X(JumpLe) X(Call) X(Ret) X(Print) X(Go) X(Yield) \
+    X(MakeChan) X(Send) X(Recv) X(Close) X(Select) X(Received) X(MakeSlice) X(Index) X(SetIndex) X(Len) \
+    X(MakeMap) X(MapIndex) X(MapHas) X(SetMap) X(Delete) X(MapIter) X(IterNext) X(IterKey) X(IterValue) X(Stack)
+enum class Op : uint8_t {
+#define G5_OPCODE(NAME) NAME,
+    G5_OPCODES(G5_OPCODE)
+#undef G5_OPCODE
+};
+struct Insn { Op op; uint16_t a, b, c; };
+struct Function {
+    Symbol name;
+    uint16_t params{}, registers{};     // parameters are the leading registers
+    bool result{};
+    vector<Insn> code;
+};
+// cases of a select statement in source order, a case that sends takes a channel and a value, one
+// that receives a channel. The default case is chosen as cases.size()
+struct SelectCases {
+    vector<bool> sends;
+    bool fallback{};
+};
+struct Program {
+    vector<Function> funcs;
+    vector<int64_t> consts;
+    vector<string> strings;
+    vector<SelectCases> selects;
+    int entry = -1;     // main.main, or -1 if there is nothing to run
+    string note;        // why main.main could not be lowered
+};
+// SSA form of a function between the AST and the bytecode. The Emitter builds it from funcBody,
+// optimize() rewrites it pass by pass and Lowering allocates registers for it. Phis lead their block
+// and hold one argument per predecessor, in the order of preds
+#define G5_SSA_OPCODES(X) X(Const) X(Param) X(Phi) X(Copy) X(Add) X(AddI) X(Sub) X(Mul) X(Div) X(Mod) X(And) \
+    X(Or) X(Xor) X(AndNot) X(Shl) X(Shr) X(Eq) X(Ne) X(Lt) X(Le) X(Neg) X(Not) X(Com) X(Call) X(Print) X(Go) \
+    X(Yield) X(MakeChan) X(Send) X(Recv) X(Close) X(Select) X(Received) X(MakeSlice) X(Index) X(SetIndex) X(Len) \
+    X(MakeMap) X(MapIndex) X(MapHas) X(SetMap) X(Delete) X(MapIter) X(IterNext) X(IterKey) X(IterValue) X(MapLen)
+enum class SsaOp : uint8_t {
+#define G5_OPCODE(NAME) NAME,
+    G5_SSA_OPCODES(G5_OPCODE)
+#undef G5_OPCODE
+};
+constexpr string_view ssaOpName[] = {
+#define G5_OPCODE(NAME) #NAME,
+    G5_SSA_OPCODES(G5_OPCODE)
+#undef G5_OPCODE
+};
+struct Value {
+    SsaOp op;
+    uint32_t block;         // Ssa::None once a pass removed it
+    int64_t aux;            // the constant, parameter index, immediate of AddI, callee of Call and Go, what Print
+                            // prints or the cases of Select
+    vector<uint32_t> args;
+};
+struct Block {
+    enum Exit : uint8_t { Jump, If, Ret };
+    vector<uint32_t> values;
+    vector<uint32_t> preds, succs;      // If goes to succs[0] when control isn't 0, else to succs[1]
+    Exit exit = Ret;
+    uint32_t control = UINT32_MAX;      // condition of If, result of Ret or None
+};
+struct Ssa {
+    static constexpr uint32_t None = UINT32_MAX;
+    Symbol name;
+    uint32_t params{};
+    vector<Value> values;
+    vector<Block> blocks;
+    vector<uint32_t> order;             // layout of the blocks in use, the entry is first
+
+    uint32_t add(SsaOp op, uint32_t block, vector<uint32_t> args = {}, int64_t aux = 0) {
+        values.push_back({ op, block, aux, move(args) });
+        return static_cast<uint32_t>(values.size() - 1);
+    }
+    uint32_t block() {
+        blocks.emplace_back();
+        return static_cast<uint32_t>(blocks.size() - 1);
+    }
+    size_t phis(uint32_t b) const {
+        size_t n = 0;
+        while (n < blocks[b].values.size() && values[blocks[b].values[n]].op == SsaOp::Phi) n++;
+        return n;
+    }
+    // a division or shift whose operand isn't a known safe constant may panic, it must stay, and so
+    // must an index that may be out of range. Reads of maps may go
+    bool sideEffect(const Value& v) const {
+        if (anyone(v.op, SsaOp::Call, SsaOp::Print, SsaOp::Go, SsaOp::Yield, SsaOp::MakeChan, SsaOp::Send, SsaOp::Recv,
+            SsaOp::Close, SsaOp::Select, SsaOp::MakeSlice, SsaOp::Index, SsaOp::SetIndex, SsaOp::MakeMap, SsaOp::SetMap,
+            SsaOp::Delete, SsaOp::MapIter, SsaOp::IterNext)) return true;
+        if (!anyone(v.op, SsaOp::Div, SsaOp::Mod, SsaOp::Shl, SsaOp::Shr)) return false;
+        const Value& by = values[v.args[1]];
+        return by.op != SsaOp::Const || (anyone(v.op, SsaOp::Div, SsaOp::Mod) ? by.aux == 0 : by.aux < 0);
+    }
+    // drops the edge from -> to with the phi arguments for it, succs of from are the caller's
+    void removeEdge(uint32_t from, uint32_t to) {
+        auto& preds = blocks[to].preds;
+        const size_t i = preds.rend() - find(preds.rbegin(), preds.rend(), from) - 1;
+        preds.erase(preds.begin() + i);
+        for (size_t k = 0, n = phis(to); k < n; k++) {
+            auto& args = values[blocks[to].values[k]].args;
+            args.erase(args.begin() + i);
+        }
+    }
+    // uses of v become uses of to[v], and the values replaced go away
+    void replace(vector<uint32_t>& to) {
+        auto find = [&](uint32_t v) {
+            while (to[v] != v) v = to[v] = to[to[v]];
+            return v;
+        };
+        for (auto b : order) {
+            auto& block = blocks[b];
+            if (block.control != None) block.control = find(block.control);
+            block.values.erase(remove_if(block.values.begin(), block.values.end(), [&](uint32_t v) {
+                if (find(v) == v) return false;
+                values[v].block = None;
+                return true;
+            }), block.values.end());
+            for (auto v : block.values) for (auto& a : values[v].args) a = find(a);
+        }
+    }
+    void removeBlock(uint32_t b) {
+        for (auto v : blocks[b].values) values[v].block = None;
+        blocks[b] = Block{};
+        order.erase(find(order.begin(), order.end(), b));
+    }
+    void print(ostream& os, const Program& program) const;
+};
+// the value of op over constants as the VM computes it, false if it panics
+static bool fold(SsaOp op, int64_t x, int64_t y, int64_t& r) {
+    const auto ux = static_cast<uint64_t>(x), uy = static_cast<uint64_t>(y);
+    switch (op) {
+    case SsaOp::Add: case SsaOp::AddI: r = static_cast<int64_t>(ux + uy); return true;
+    case SsaOp::Sub:    r = static_cast<int64_t>(ux - uy); return true;
+    case SsaOp::Mul:    r = static_cast<int64_t>(ux * uy); return true;
+    case SsaOp::Div:    r = y == -1 ? static_cast<int64_t>(0 - ux) : y != 0 ? x / y : 0; return y != 0;
+    case SsaOp::Mod:    r = y == -1 || y == 0 ? 0 : x % y; return y != 0;
+    case SsaOp::And:    r = x & y; return true;
+    case SsaOp::Or:     r = x | y; return true;
+    case SsaOp::Xor:    r = x ^ y; return true;
+    case SsaOp::AndNot: r = x & ~y; return true;
+    case SsaOp::Shl:    r = y >= 64 ? 0 : static_cast<int64_t>(ux << (y & 63)); return y >= 0;
+    case SsaOp::Shr:    r = x >> min<int64_t>(y & INT64_MAX, 63); return y >= 0;
+    case SsaOp::Eq:     r = x == y; return true;
+    case SsaOp::Ne:     r = x != y; return true;
+    case SsaOp::Lt:     r = x < y; return true;
+    case SsaOp::Le:     r = x <= y; return true;
+    case SsaOp::Neg:    r = static_cast<int64_t>(0 - ux); return true;
+    case SsaOp::Not:    r = x == 0; return true;
+    case SsaOp::Com:    r = ~x; return true;
+    default:            return false;
+    }
+}
+void Ssa::print(ostream& os, const Program& program) const {
+    auto character = [&](int64_t c) -> string { return c == '\n' ? "'\\n'" : "'" + string(1, static_cast<char>(c)) + "'"; };
+    for (auto b : order) {
+        auto& block = blocks[b];
+        os << "  b" << b << ":";
+        if (!block.preds.empty()) os << " <-";
+        for (auto p : block.preds) os << " b" << p;
+        os << "\n";
+        for (auto v : block.values) {
+            auto& value = values[v];
+            os << "    ";
+            if (!anyone(value.op, SsaOp::Print, SsaOp::Go, SsaOp::Yield, SsaOp::Send, SsaOp::Close, SsaOp::SetIndex,
+                SsaOp::SetMap, SsaOp::Delete))
+                os << "v" << v << " = ";
+            os << ssaOpName[static_cast<size_t>(value.op)];
+            if (anyone(value.op, SsaOp::Const, SsaOp::Param, SsaOp::Select)) os << " " << value.aux;
+            if (anyone(value.op, SsaOp::Call, SsaOp::Go)) os << " " << program.funcs[value.aux].name.str();
+            for (auto a : value.args) os << " v" << a;
+            if (value.op == SsaOp::AddI) os << " " << value.aux;
+            if (value.op == SsaOp::Print) {
+                if ((value.aux & 3) == 1) {
+                    os << " \"";
+                    for (char c : program.strings[value.aux >> 32]) os << (c == '\n' ? "\\n" : string(1, c));
+                    os << "\"";
+                }
+                os << " " << character(value.aux >> 8 & 0xFF);
+            }
+            os << "\n";
+        }
+        switch (block.exit) {
+        case Block::Jump: os << "    Jump b" << block.succs[0] << "\n"; break;
+        case Block::If:   os << "    If v" << block.control << " b" << block.succs[0] << " b" << block.succs[1] << "\n"; break;
+        case Block::Ret:  os << "    Ret" << (block.control != None ? " v" + to_string(block.control) : "") << "\n"; break;
+        }
+    }
+}
+#pragma region Passes
+// folds values whose operands are constants, and Ifs of a constant condition become Jumps
+void constprop(Ssa& f) {
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto b : f.order) {
+            for (auto v : f.blocks[b].values) {
+                auto& value = f.values[v];
+                if (anyone(value.op, SsaOp::Const, SsaOp::Param, SsaOp::Copy, SsaOp::Call, SsaOp::Print, SsaOp::Go) || value.args.empty())
+                    continue;
+                bool constant = true;
+                for (auto a : value.args) constant = constant && f.values[a].op == SsaOp::Const;
+                if (!constant) continue;
+                const int64_t x = f.values[value.args[0]].aux;
+                int64_t r = x;
+                if (value.op == SsaOp::Phi) {
+                    for (auto a : value.args) constant = constant && f.values[a].aux == x;
+                } else {
+                    const int64_t y = value.op == SsaOp::AddI ? value.aux : value.args.size() > 1 ? f.values[value.args[1]].aux : 0;
+                    constant = fold(value.op, x, y, r);
+                }
+                if (!constant) continue;
+                value.op = SsaOp::Const;
+                value.aux = r;
+                value.args.clear();
+                changed = true;
+            }
+            auto& values = f.blocks[b].values;     // phis that became constants leave the head of the block
+            stable_partition(values.begin(), values.end(), [&](uint32_t v) { return f.values[v].op == SsaOp::Phi; });
+        }
+        for (auto b : f.order) {
+            auto& block = f.blocks[b];
+            if (block.exit != Block::If || f.values[block.control].op != SsaOp::Const) continue;
+            const bool taken = f.values[block.control].aux != 0;
+            f.removeEdge(b, block.succs[taken ? 1 : 0]);
+            block.succs.erase(block.succs.begin() + (taken ? 1 : 0));
+            block.exit = Block::Jump;
+            block.control = Ssa::None;
+            changed = true;
+        }
+    }
+}
+// a copy, or a phi whose arguments are one value besides itself, is replaced by that value
+void copyprop(Ssa& f) {
+    vector<uint32_t> to(f.values.size());
+    for (uint32_t v = 0; v < to.size(); v++) to[v] = v;
+    auto find = [&](uint32_t v) {
+        while (to[v] != v) v = to[v];
+        return v;
+    };
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto b : f.order) {
+            for (auto v : f.blocks[b].values) {
+                auto& value = f.values[v];
+                if (to[v] != v || !anyone(value.op, SsaOp::Copy, SsaOp::Phi)) continue;
+                uint32_t same = Ssa::None;
+                for (auto a : value.args) {
+                    a = find(a);
+                    if (a == v || a == same) continue;
+                    same = same == Ssa::None ? a : Ssa::None - 1;
+                }
+                if (same >= Ssa::None - 1) continue;
+                to[v] = same;
+                changed = true;
+            }
+        }
+    }
+    f.replace(to);
+}
+// values that nothing with an effect depends on go away
+void dce(Ssa& f) {
+    vector<bool> live(f.values.size());
+    vector<uint32_t> work;
+    auto mark = [&](uint32_t v) { if (v != Ssa::None && !live[v]) { live[v] = true; work.push_back(v); } };
+    for (auto b : f.order) {
+        mark(f.blocks[b].control);
+        for (auto v : f.blocks[b].values) if (f.sideEffect(f.values[v])) mark(v);
+    }
+    while (!work.empty()) {
+        const auto v = work.back();
+        work.pop_back();
+        for (auto a : f.values[v].args) mark(a);
+    }
+    for (auto b : f.order) {
+        auto& values = f.blocks[b].values;
+        values.erase(remove_if(values.begin(), values.end(), [&](uint32_t v) {
+            if (live[v]) return false;
+            f.values[v].block = Ssa::None;
+            return true;
+        }), values.end());
+    }
+}
+// immediate dominators by the iterative algorithm of Cooper, Harvey and Kennedy, None where unreachable
+vector<uint32_t> dominators(const Ssa& f) {
+    vector<uint32_t> post, number(f.blocks.size(), Ssa::None), idom(f.blocks.size(), Ssa::None);
+    vector<pair<uint32_t, size_t>> stack{ { f.order[0], 0 } };
+    number[f.order[0]] = 0;
+    while (!stack.empty()) {
+        auto&[b, next] = stack.back();
+        if (next < f.blocks[b].succs.size()) {
+            const auto s = f.blocks[b].succs[next++];
+            if (number[s] == Ssa::None) { number[s] = 0; stack.emplace_back(s, 0); }
+            continue;
+        }
+        number[b] = static_cast<uint32_t>(post.size());
+        post.push_back(b);
+        stack.pop_back();
+    }
+    idom[f.order[0]] = f.order[0];
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto i = post.rbegin() + 1; i < post.rend(); ++i) {
+            uint32_t dom = Ssa::None;
+            for (auto p : f.blocks[*i].preds) {
+                if (idom[p] == Ssa::None) continue;
+                if (dom == Ssa::None) { dom = p; continue; }
+                for (uint32_t a = p; a != dom;) {
+                    while (number[a] < number[dom]) a = idom[a];
+                    while (number[dom] < number[a]) dom = idom[dom];
+                }
+            }
+            if (idom[*i] != dom) { idom[*i] = dom; changed = true; }
+        }
+    }
+    return idom;
+}
+// a pure value computed by a dominating one already is replaced by it, operands of commutative
+// operators are sorted so that a+b and b+a are the same. Elements and entries of maps may change
+// in between, the length of a slice may not
+void cse(Ssa& f) {
+    const auto idom = dominators(f);
+    vector<vector<uint32_t>> children(f.blocks.size());
+    for (auto b : f.order) if (idom[b] != Ssa::None && idom[b] != b) children[idom[b]].push_back(b);
+    vector<uint32_t> to(f.values.size());
+    for (uint32_t v = 0; v < to.size(); v++) to[v] = v;
+    map<tuple<SsaOp, int64_t, vector<uint32_t>>, uint32_t> known;
+    vector<decltype(known)::iterator> scoped;
+    vector<pair<uint32_t, size_t>> stack{ { f.order[0], 0 } };
+    auto enter = [&](uint32_t b) {
+        stack.back().second = scoped.size();
+        for (auto v : f.blocks[b].values) {
+            const Value& value = f.values[v];
+            if (anyone(value.op, SsaOp::Phi, SsaOp::Copy, SsaOp::Call, SsaOp::Print, SsaOp::Go, SsaOp::Yield, SsaOp::MakeChan,
+                SsaOp::Send, SsaOp::Recv, SsaOp::Close, SsaOp::Select, SsaOp::Received, SsaOp::MakeSlice, SsaOp::Index,
+                SsaOp::SetIndex, SsaOp::MakeMap, SsaOp::MapIndex, SsaOp::MapHas, SsaOp::SetMap, SsaOp::Delete, SsaOp::MapIter,
+                SsaOp::IterNext, SsaOp::IterKey, SsaOp::IterValue, SsaOp::MapLen)) continue;
+            vector<uint32_t> args;
+            for (auto a : value.args) args.push_back(to[a]);
+            if (anyone(value.op, SsaOp::Add, SsaOp::Mul, SsaOp::And, SsaOp::Or, SsaOp::Xor, SsaOp::Eq, SsaOp::Ne))
+                sort(args.begin(), args.end());
+            auto[at, added] = known.emplace(make_tuple(value.op, value.aux, move(args)), v);
+            if (added) scoped.push_back(at);
+            else to[v] = at->second;
+        }
+    };
+    // a dominator tree walk, what a block adds is forgotten when its subtree is done
+    vector<size_t> child{ 0 };
+    enter(f.order[0]);
+    while (!stack.empty()) {
+        const auto b = stack.back().first;
+        if (child.back() < children[b].size()) {
+            const auto c = children[b][child.back()++];
+            stack.emplace_back(c, 0);
+            child.push_back(0);
+            enter(c);
+            continue;
+        }
+        for (size_t n = stack.back().second; scoped.size() > n; scoped.pop_back()) known.erase(scoped.back());
+        stack.pop_back();
+        child.pop_back();
+    }
+    f.replace(to);
+}
+// unreachable blocks go, a block is merged into its only predecessor, and an empty block that jumps
+// somewhere is skipped by its predecessors
+void simplifycfg(Ssa& f) {
+    for (bool changed = true; changed;) {
+        changed = false;
+        vector<bool> seen(f.blocks.size());
+        vector<uint32_t> work{ f.order[0] };
+        seen[f.order[0]] = true;
+        while (!work.empty()) {
+            const auto b = work.back();
+            work.pop_back();
+            for (auto s : f.blocks[b].succs) if (!seen[s]) { seen[s] = true; work.push_back(s); }
+        }
+        for (auto b : vector<uint32_t>(f.order)) {
+            if (seen[b]) continue;
+            for (auto s : f.blocks[b].succs) if (seen[s]) f.removeEdge(b, s);
+            f.removeBlock(b);
+        }
+        for (auto b : f.order) {
+            auto& block = f.blocks[b];
+            if (block.exit == Block::If && block.succs[0] == block.succs[1]) {
+                f.removeEdge(b, block.succs[1]);
+                block.succs.pop_back();
+                block.exit = Block::Jump;
+                block.control = Ssa::None;
+                changed = true;
+            }
+            if (block.exit != Block::Jump) continue;
+            const auto s = block.succs[0];
+            if (s == b || s == f.order[0]) continue;
+            if (f.blocks[s].preds.size() == 1) {
+                vector<uint32_t> to(f.values.size());
+                for (uint32_t v = 0; v < to.size(); v++) to[v] = v;
+                for (size_t k = 0, n = f.phis(s); k < n; k++) to[f.blocks[s].values[k]] = f.values[f.blocks[s].values[k]].args[0];
+                f.replace(to);
+                auto& into = f.blocks[b];
+                auto& next = f.blocks[s];
+                for (auto v : next.values) f.values[v].block = b;
+                into.values.insert(into.values.end(), next.values.begin(), next.values.end());
+                into.exit = next.exit;
+                into.control = next.control;
+                into.succs = next.succs;
+                for (auto t : into.succs) replace(f.blocks[t].preds.begin(), f.blocks[t].preds.end(), s, b);
+                next.values.clear();
+                f.removeBlock(s);
+                changed = true;
+                break;
+            }
+            if (!block.values.empty() || b == f.order[0]) continue;
+            auto& target = f.blocks[s];
+            const bool phis = f.phis(s) != 0;
+            if (phis && (block.preds.size() != 1 || find(target.preds.begin(), target.preds.end(), block.preds[0]) != target.preds.end()))
+                continue;
+            for (auto p : block.preds) replace(f.blocks[p].succs.begin(), f.blocks[p].succs.end(), b, s);
+            const auto at = find(target.preds.begin(), target.preds.end(), b);
+            if (phis) *at = block.preds[0];
+            else {
+                target.preds.erase(at);
+                target.preds.insert(target.preds.end(), block.preds.begin(), block.preds.end());
+            }
+            f.removeBlock(b);
+            changed = true;
+            break;
+        }
+    }
+    copyprop(f);    // phis of blocks that lost predecessors may have one argument left
+}
+// runs the passes in order, with dump the function is printed before them and after each one
+void optimize(Ssa& f, const Program& program, ostream* dump) {
+    constexpr pair<const char*, void(*)(Ssa&)> passes[] = { {"constprop", constprop}, {"copyprop", copyprop},
+        {"dce", dce}, {"cse", cse}, {"simplifycfg", simplifycfg} };
+    const auto precision = dump != nullptr ? dump->precision() : 0;
+    if (dump != nullptr) {
+        *dump << "main." << f.name.str() << " built\n";
+        f.print(*dump, program);
+    }
+    for (auto[name, pass] : passes) {
+        const auto start = chrono::steady_clock::now();
+        pass(f);
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (dump == nullptr) continue;
+        *dump << "main." << f.name.str() << " after " << name << ", " << fixed << setprecision(1) << seconds * 1e6 << " us\n";
+        dump->unsetf(ios::floatfield);
+        dump->precision(precision);
+        f.print(*dump, program);
+    }
+}
+#pragma endregion
+// Builds the SSA of main.main and then of every function it calls. Values are 64-bit integers for
+// now, locals are variables whose value in a block is looked up through its predecessors, by the
+// algorithm of Braun et al.; a block is sealed when all its predecessors are known
+struct Emitter {
+    struct Unsupported { string what; };
+    Program& program;
+    Constants& constants;
+    map<Symbol, FuncDecl*> decls;           // functions of the package
+    map<Symbol, uint16_t> index;            // into program.funcs, assigned on the first call
+    vector<pair<FuncDecl*, uint16_t>> todo;
+    const Symbol print = symbols.intern("g5print"), yes = symbols.intern("true"), no = symbols.intern("false"),
+        blank = symbols.intern("_"), runtime = symbols.intern("runtime"), gosched = symbols.intern("Gosched"),
+        make = symbols.intern("make"), close = symbols.intern("close"), length = symbols.intern("len"),
+        remove = symbols.intern("delete");
+    map<Symbol, Expr*> named;               // types the package declares
+    Name boolean;                           // the type of comparisons and logical operations
+    // the function being built
+    FuncDecl* decl{};
+    Ssa f;
+    uint32_t current = 0, variables = 0;
+    vector<pair<Symbol, uint32_t>> locals;  // variables in scope
+    vector<Expr*> types;                    // of each variable as far as it's spelled out, maps are told from slices by it
+    size_t scope = 0;                       // locals of the innermost block start here
+    vector<map<uint32_t, uint32_t>> defs;   // value of each variable at the end of a block so far
+    vector<bool> sealed;
+    vector<vector<pair<uint32_t, uint32_t>>> incomplete;    // phis of unsealed blocks and their variables
+    struct Loop { uint32_t breakTo, continueTo; };
+    vector<Loop> loops;
+    struct Scope {
+        Emitter& e;
+        size_t scope, locals;
+        explicit Scope(Emitter& e) :e(e), scope(e.scope), locals(e.locals.size()) { e.scope = locals; }
+        ~Scope() { e.scope = scope; e.locals.resize(locals); }
+    };
+
+    Emitter(const Package& pkg, Program& program, Constants& constants) :program(program), constants(constants) {
+        boolean.name = symbols.intern("bool");
+        for (auto* func : pkg.funcDecl) if (func->receiver == nullptr) decls.emplace(func->funcName, func);
+        for (auto* decl : pkg.typeDecl) for (auto[name, type] : decl->typeSpec) named.emplace(name, type);
+    }
+    [[noreturn]] static void unsupported(string what) { throw Unsupported{ move(what) }; }
+    uint16_t function(Symbol name) {
+        if (auto it = index.find(name); it != index.end()) return it->second;
+        auto decl = decls.find(name);
+        if (decl == decls.end()) unsupported("undefined: " + string(name.str()));
+        Function fn{ name };
+        if (auto* sig = decl->second->signature; sig != nullptr) {
+            if (sig->param != nullptr) {
+                for (auto* p : sig->param->paramList) {
+                    if (p->isVariadic) unsupported("variadic functions are not supported yet");
+                    checkType(p->type);
+                }
+                fn.params = static_cast<uint16_t>(sig->param->paramList.size());
+            }
+            if (auto* results = sig->resultParam; results != nullptr && !results->paramList.empty()) {
+                if (results->paramList.size() > 1 || results->paramList[0]->hasName)
+                    unsupported("multiple or named results are not supported yet");
+                checkType(results->paramList[0]->type);
+                fn.result = true;
+            } else {
+                checkType(sig->resultType);
+                fn.result = sig->resultType != nullptr;
+            }
+        }
+        if (program.funcs.size() >= UINT16_MAX) unsupported("too many functions");
+        const auto at = static_cast<uint16_t>(program.funcs.size());
+        program.funcs.push_back(move(fn));
+        todo.emplace_back(decl->second, at);
+        return index[name] = at;
+    }
+    Ssa build(FuncDecl* decl, uint16_t at) {
+        this->decl = decl;
+        f = Ssa{ decl->funcName, program.funcs[at].params };
+        locals.clear(); types.clear(); loops.clear(); defs.clear(); sealed.clear(); incomplete.clear();
+        scope = 0; variables = 0;
+        enter(newBlock());
+        seal(current);
+        if (auto* sig = decl->signature; sig != nullptr && sig->param != nullptr)
+            for (auto* p : sig->param->paramList) {
+                const auto v = value(SsaOp::Param, {}, static_cast<int64_t>(locals.size()));
+                write(declare(p->name, p->type), v);
+            }
+        constants.function(decl);
+        block(decl->funcBody);
+        return move(f);
+    }
+#pragma region Emit
+    uint32_t value(SsaOp op, vector<uint32_t> args = {}, int64_t aux = 0) {
+        const auto v = f.add(op, current, move(args), aux);
+        f.blocks[current].values.push_back(v);
+        return v;
+    }
+    uint32_t constant(int64_t k) { return value(SsaOp::Const, {}, k); }
+    uint32_t newBlock() {
+        defs.emplace_back(); sealed.push_back(false); incomplete.emplace_back();
+        return f.block();
+    }
+    // blocks are laid out in the order they are entered
+    void enter(uint32_t b) {
+        current = b;
+        f.order.push_back(b);
+    }
+    void edge(uint32_t from, uint32_t to) {
+        f.blocks[from].succs.push_back(to);
+        f.blocks[to].preds.push_back(from);
+    }
+    void jump(uint32_t to) {
+        f.blocks[current].exit = Block::Jump;
+        edge(current, to);
+    }
+    void branch(uint32_t cond, uint32_t then, uint32_t otherwise) {
+        f.blocks[current].exit = Block::If;
+        f.blocks[current].control = cond;
+        edge(current, then);
+        edge(current, otherwise);
+    }
+    // code after a jump goes to a block nothing reaches
+    void unreachable() {
+        enter(newBlock());
+        seal(current);
+    }
+    void write(uint32_t var, uint32_t v) { defs[current][var] = v; }
+    uint32_t phi(uint32_t b) {
+        const auto v = f.add(SsaOp::Phi, b);
+        auto& values = f.blocks[b].values;
+        values.insert(values.begin() + f.phis(b), v);
+        return v;
+    }
+    uint32_t read(uint32_t var, uint32_t b) {
+        if (auto it = defs[b].find(var); it != defs[b].end()) return it->second;
+        uint32_t v;
+        if (!sealed[b]) incomplete[b].emplace_back(var, v = phi(b));
+        else if (f.blocks[b].preds.size() == 1) v = read(var, f.blocks[b].preds[0]);
+        else if (f.blocks[b].preds.empty()) {        // in code nothing reaches
+            v = f.add(SsaOp::Const, b);
+            auto& values = f.blocks[b].values;
+            values.insert(values.begin() + f.phis(b), v);
+        } else {
+            v = defs[b][var] = phi(b);
+            for (size_t i = 0; i < f.blocks[b].preds.size(); i++) {
+                const auto arg = read(var, f.blocks[b].preds[i]);
+                f.values[v].args.push_back(arg);
+            }
+        }
+        return defs[b][var] = v;
+    }
+    void seal(uint32_t b) {
+        for (auto[var, v] : incomplete[b])
+            for (size_t i = 0; i < f.blocks[b].preds.size(); i++) {
+                const auto arg = read(var, f.blocks[b].preds[i]);
+                f.values[v].args.push_back(arg);
+            }
+        incomplete[b].clear();
+        sealed[b] = true;
+    }
+    const uint32_t* lookup(Symbol name) const {
+        for (auto i = locals.rbegin(); i != locals.rend(); ++i) if (i->first == name) return &i->second;
+        return nullptr;
+    }
+    static TokenType compound(TokenType agn) {     // operator of x op= y
+        constexpr pair<TokenType, TokenType> ops[] = { {OP_ADDAGN, OP_ADD}, {OP_SUBAGN, OP_SUB}, {OP_MULAGN, OP_MUL},
+            {OP_DIVAGN, OP_DIV}, {OP_MODAGN, OP_MOD}, {OP_ANDAGN, OP_BITAND}, {OP_ORAGN, OP_BITOR}, {OP_XORAGN, OP_XOR},
+            {OP_LSFTAGN, OP_LSHIFT}, {OP_RSFTAGN, OP_RSHIFT}, {OP_ANDXORAGN, OP_ANDXOR} };
+        for (auto[op, plain] : ops) if (op == agn) return plain;
+        return agn;
+    }
+    uint32_t binary(TokenType op, uint32_t lhs, uint32_t rhs) {
+        switch (op) {
+        case OP_ADD:    return value(SsaOp::Add, { lhs, rhs });
+        case OP_SUB:    return value(SsaOp::Sub, { lhs, rhs });
+        case OP_MUL:    return value(SsaOp::Mul, { lhs, rhs });
+        case OP_DIV:    return value(SsaOp::Div, { lhs, rhs });
+        case OP_MOD:    return value(SsaOp::Mod, { lhs, rhs });
+        case OP_BITAND: return value(SsaOp::And, { lhs, rhs });
+        case OP_BITOR:  return value(SsaOp::Or, { lhs, rhs });
+        case OP_XOR:    return value(SsaOp::Xor, { lhs, rhs });
+        case OP_ANDXOR: return value(SsaOp::AndNot, { lhs, rhs });
+        case OP_LSHIFT: return value(SsaOp::Shl, { lhs, rhs });
+        case OP_RSHIFT: return value(SsaOp::Shr, { lhs, rhs });
+        case OP_EQ:     return value(SsaOp::Eq, { lhs, rhs });
+        case OP_NE:     return value(SsaOp::Ne, { lhs, rhs });
+        case OP_LT:     return value(SsaOp::Lt, { lhs, rhs });
+        case OP_LE:     return value(SsaOp::Le, { lhs, rhs });
+        case OP_GT:     return value(SsaOp::Lt, { rhs, lhs });
+        case OP_GE:     return value(SsaOp::Le, { rhs, lhs });
+        default:        unsupported("operator " + string(spelling(op)) + " is not supported yet");
+        }
+    }
+#pragma endregion
+#pragma region Literal
+    // values are 64-bit integers, a literal may be negated as constant folding spells negative ones
+    static Constant integer(BasicLit* lit, bool negate = false) {
+        auto c = Constants::parse(lit);
+        if (!c || !anyone(c->kind, Constant::Int, Constant::Rune)) unsupported(string(spelling(lit->type)) + "s are not supported yet");
+        if (negate) c->num = -c->num;
+        return *c;
+    }
+    // an integer that doesn't fit is a constant error of the function
+    int64_t literal(BasicLit* lit, bool negate = false) {
+        const Constant c = integer(lit, negate);
+        int64_t v;
+        if (!c.num.toInt64(v)) {
+            constants.overflows(decl, c);
+            unsupported("constant " + Constants::text(c) + " overflows int");
+        }
+        return v;
+    }
+#pragma endregion
+#pragma region Statement
+    void block(StmtList* b) {
+        if (b == nullptr) return;
+        Scope inner(*this);
+        for (auto* s : b->stmts) stmt(s);
+    }
+    void stmt(Stmt* s) {
+        if (s == nullptr) return;
+        switch (s->kind) {
+        case NodeKind::StmtList: block(static_cast<StmtList*>(s)); break;
+        case NodeKind::ExprStmt: {
+            auto* e = static_cast<ExprStmt*>(s)->expr;
+            if (received(s) != nullptr) {
+                expr(e);
+                break;
+            }
+            auto* call = as<CallExpr>(e);
+            if (call == nullptr) unsupported("expression statements besides calls are not supported yet");
+            if (isPrint(call)) printCall(call);
+            else if (isGosched(call)) value(SsaOp::Yield);
+            else if (isBuiltin(call, close)) {
+                if (call->arguments == nullptr || call->arguments->exprs.size() != 1) unsupported("wrong argument count in call to close");
+                value(SsaOp::Close, { expr(call->arguments->exprs[0]) });
+            } else if (isBuiltin(call, remove)) {
+                if (call->arguments == nullptr || call->arguments->exprs.size() != 2) unsupported("wrong argument count in call to delete");
+                const auto m = expr(call->arguments->exprs[0]);
+                value(SsaOp::Delete, { m, expr(call->arguments->exprs[1]) });
+            } else this->call(call, false);
+            break;
+        }
+        case NodeKind::SendStmt: {
+            auto* send = static_cast<SendStmt*>(s);
+            const auto ch = expr(send->receiver);
+            value(SsaOp::Send, { ch, expr(send->sender) });
+            break;
+        }
+        case NodeKind::SelectStmt: selectStmt(static_cast<SelectStmt*>(s)); break;
+        case NodeKind::GoStmt: {
+            auto* call = as<CallExpr>(static_cast<GoStmt*>(s)->expr);
+            if (call == nullptr) unsupported("expression in go must be function call");
+            if (isPrint(call) || isGosched(call)) unsupported("go of builtins is not supported yet");
+            this->call(call, false, SsaOp::Go);
+            break;
+        }
+        case NodeKind::SAssignStmt: {
+            auto* a = static_cast<SAssignStmt*>(s);
+            define(a->lhs, a->rhs, true);
+            break;
+        }
+        case NodeKind::VarDecl:
+            for (auto* spec : static_cast<VarDecl*>(s)->varSpec) {
+                if (spec == nullptr) continue;
+                if (spec->exprs != nullptr) {
+                    define(spec->idents, spec->exprs, false, spec->type);
+                    continue;
+                }
+                for (auto name : spec->idents) if (name != blank) write(declare(name, spec->type), constant(0));
+            }
+            break;
+        case NodeKind::ConstDecl: break;    // folding spelled out every use
+        case NodeKind::AssignStmt: assign(static_cast<AssignStmt*>(s)); break;
+        case NodeKind::IncDecStmt: {
+            auto* i = static_cast<IncDecStmt*>(s);
+            const Place at = place(i->expr);
+            store(at, value(SsaOp::Add, { load(at), constant(i->isInc ? 1 : -1) }));
+            break;
+        }
+        case NodeKind::IfStmt: {
+            auto* i = static_cast<IfStmt*>(s);
+            Scope outer(*this);     // names of init are seen by both branches
+            stmt(i->init);
+            const auto then = newBlock(), otherwise = newBlock(), join = i->elseBlock != nullptr ? newBlock() : otherwise;
+            condition(i->cond, then, otherwise);
+            seal(then);
+            enter(then);
+            stmt(i->ifBlock);
+            jump(join);
+            if (i->elseBlock != nullptr) {
+                seal(otherwise);
+                enter(otherwise);
+                stmt(i->elseBlock);
+                jump(join);
+            }
+            seal(join);
+            enter(join);
+            break;
+        }
+        case NodeKind::ForStmt: forStmt(static_cast<ForStmt*>(s)); break;
+        case NodeKind::ReturnStmt: {
+            auto* exprs = static_cast<ReturnStmt*>(s)->exprs;
+            if (exprs != nullptr && exprs->exprs.size() != 1) unsupported("multiple results are not supported yet");
+            f.blocks[current].control = exprs != nullptr ? expr(exprs->exprs[0]) : Ssa::None;
+            unreachable();
+            break;
+        }
+        case NodeKind::BreakStmt: case NodeKind::ContinueStmt: {
+            const bool isBreak = s->kind == NodeKind::BreakStmt;
+            if ((isBreak ? static_cast<BreakStmt*>(s)->label : static_cast<ContinueStmt*>(s)->label) != Symbol{})
+                unsupported("labeled break and continue are not supported yet");
+            if (loops.empty() || (!isBreak && loops.back().continueTo == Ssa::None))
+                unsupported(string(isBreak ? "break" : "continue") + " is not in a loop");
+            jump(isBreak ? loops.back().breakTo : loops.back().continueTo);
+            unreachable();
+            break;
+        }
+        default: unsupported(string(kindName[static_cast<size_t>(s->kind)]) + " is not supported yet");
+        }
+    }
+    // names := values, a name declared by the innermost block already is assigned when redeclare.
+    // Values are evaluated before any name is bound, new names are of type or else of their values
+    void define(const avector<Symbol>& names, ExprList* values, bool redeclare, Expr* type = nullptr) {
+        if (values == nullptr || (values->exprs.size() != names.size() && (names.size() != 2 || values->exprs.size() != 1)))
+            unsupported("multi-value assignments are not supported yet");
+        vector<uint32_t> held;
+        vector<Expr*> typed;
+        for (auto* e : values->exprs) typed.push_back(type != nullptr ? type : typeOf(e));
+        if (values->exprs.size() != names.size()) {
+            const auto[v, ok] = commaOk(values->exprs[0]);
+            held = { v, ok };
+            typed.push_back(&boolean);
+        } else for (auto* e : values->exprs) held.push_back(expr(e));
+        for (size_t i = 0; i < names.size(); i++) {
+            if (names[i] == blank) continue;
+            auto same = find_if(locals.begin() + scope, locals.end(), [&](auto& l) { return l.first == names[i]; });
+            if (!redeclare || same == locals.end()) {
+                declare(names[i], typed[i]);
+                same = locals.end() - 1;
+            }
+            write(same->second, held[i]);
+        }
+    }
+    // a new variable in scope
+    uint32_t declare(Symbol name, Expr* type) {
+        checkType(type);
+        locals.emplace_back(name, variables);
+        types.push_back(type);
+        return variables++;
+    }
+    // v, ok = m[k] tells whether m holds k
+    pair<uint32_t, uint32_t> commaOk(Expr* e) {
+        auto* i = as<IndexExpr>(e);
+        if (i == nullptr || !isMap(i->operand)) unsupported("multi-value assignments are not supported yet");
+        const auto m = expr(i->operand), k = expr(i->index);
+        return { value(SsaOp::MapIndex, { m, k }), value(SsaOp::MapHas, { m, k }) };
+    }
+    void assign(AssignStmt* a) {
+        if (a->lhs == nullptr || a->rhs == nullptr || (a->lhs->exprs.size() != a->rhs->exprs.size()
+            && (a->op != OP_AGN || a->lhs->exprs.size() != 2 || a->rhs->exprs.size() != 1)))
+            unsupported("multi-value assignments are not supported yet");
+        if (a->op != OP_AGN) {
+            const Place at = place(a->lhs->exprs[0]);
+            const auto x = load(at);
+            return store(at, binary(compound(a->op), x, expr(a->rhs->exprs[0])));
+        }
+        vector<Place> to;
+        for (auto* e : a->lhs->exprs) {
+            auto* name = as<Name>(e);
+            to.push_back(name != nullptr && name->name == blank ? Place{} : place(e));
+        }
+        vector<uint32_t> held;
+        if (to.size() != a->rhs->exprs.size()) {
+            const auto[v, ok] = commaOk(a->rhs->exprs[0]);
+            held = { v, ok };
+        } else for (auto* e : a->rhs->exprs) held.push_back(expr(e));
+        for (size_t i = 0; i < to.size(); i++) store(to[i], held[i]);
+    }
+    // what an assignment writes, a variable or an element whose slice or map and index are evaluated first
+    struct Place { uint32_t var = Ssa::None, slice = Ssa::None, index = Ssa::None; bool keyed = false; };
+    Place place(Expr* e) {
+        if (auto* i = as<IndexExpr>(e)) {
+            const bool keyed = isMap(i->operand);
+            const auto slice = expr(i->operand);
+            return { Ssa::None, slice, expr(i->index), keyed };
+        }
+        return { variable(e) };
+    }
+    uint32_t load(const Place& at) {
+        if (at.var != Ssa::None) return read(at.var, current);
+        return value(at.keyed ? SsaOp::MapIndex : SsaOp::Index, { at.slice, at.index });
+    }
+    void store(const Place& at, uint32_t v) {
+        if (at.var != Ssa::None) write(at.var, v);
+        else if (at.slice != Ssa::None) value(at.keyed ? SsaOp::SetMap : SsaOp::SetIndex, { at.slice, at.index, v });
+    }
+    uint32_t variable(Expr* e) {
+        auto* name = as<Name>(e);
+        if (name == nullptr) unsupported("assigning to " + string(kindName[static_cast<size_t>(e->kind)]) + " is not supported yet");
+        if (auto* var = lookup(name->name)) return *var;
+        unsupported("undefined: " + string(name->name.str()));
+    }
+    // the condition is tested at the bottom, blocks are laid out as body, post, condition and exit
+    void forStmt(ForStmt* s) {
+        Node* cond = s->cond;
+        if (auto* e = as<ExprStmt>(cond)) cond = e->expr;
+        if (cond != nullptr && anyone(cond->kind, NodeKind::SRangeClause, NodeKind::RangeClause)) return rangeStmt(cond, s->block);
+        Scope outer(*this);
+        stmt(static_cast<Stmt*>(s->init));
+        const auto body = newBlock(), post = newBlock(), test = cond != nullptr ? newBlock() : body, exit = newBlock();
+        jump(test);
+        loops.push_back({ exit, post });
+        enter(body);
+        block(s->block);
+        jump(post);
+        seal(post);
+        enter(post);
+        stmt(static_cast<Stmt*>(s->post));
+        jump(test);
+        if (cond != nullptr) {
+            seal(test);
+            enter(test);
+            condition(static_cast<Expr*>(cond), body, exit);
+        }
+        seal(body);
+        loops.pop_back();
+        seal(exit);
+        enter(exit);
+    }
+    // x of for k, v := range x is evaluated once, a slice is indexed up to the length it had then and
+    // a map is iterated in the order of the slots of its table. Blocks are laid out as of for loops
+    void rangeStmt(Node* clause, StmtList* body) {
+        Scope outer(*this);
+        auto* defined = as<SRangeClause>(clause);
+        auto* assigned = as<RangeClause>(clause);
+        if (assigned != nullptr && assigned->op != OP_AGN) unsupported("range clause permits only = or :=");
+        Expr* over = defined != nullptr ? defined->rhs : assigned->rhs;
+        const size_t n = defined != nullptr ? defined->lhs.size() : assigned->lhs->exprs.size();
+        if (n > 2) unsupported("range clause permits at most two iteration variables");
+        Expr* type = typeOf(over);
+        if (type != nullptr && !anyone(type->kind, NodeKind::SliceType, NodeKind::MapType))
+            unsupported("range over " + string(kindName[static_cast<size_t>(type->kind)]) + " is not supported yet");
+        auto* keyed = isMap(over) ? static_cast<MapType*>(type) : nullptr;
+        const auto x = expr(over);
+        uint32_t iter = Ssa::None, length = Ssa::None, index = Ssa::None;
+        if (keyed != nullptr) iter = value(SsaOp::MapIter, { x });
+        else {
+            length = value(SsaOp::Len, { x });
+            write(index = declare(Symbol{}, nullptr), constant(0));
+        }
+        const auto first = newBlock(), post = newBlock(), test = newBlock(), exit = newBlock();
+        jump(test);
+        loops.push_back({ exit, post });
+        enter(first);
+        {
+            Scope inner(*this);
+            uint32_t held[2];
+            if (n > 0) held[0] = keyed != nullptr ? value(SsaOp::IterKey, { iter }) : read(index, current);
+            if (n > 1) held[1] = keyed != nullptr ? value(SsaOp::IterValue, { iter }) : value(SsaOp::Index, { x, held[0] });
+            Expr* const typed[] = { keyed != nullptr ? keyed->type : nullptr,
+                keyed != nullptr ? keyed->elem : static_cast<SliceType*>(type)->elem };
+            for (size_t i = 0; i < n; i++) {
+                if (defined != nullptr) {
+                    if (defined->lhs[i] != blank) write(declare(defined->lhs[i], typed[i]), held[i]);
+                    continue;
+                }
+                auto* name = as<Name>(assigned->lhs->exprs[i]);
+                if (name == nullptr || name->name != blank) store(place(assigned->lhs->exprs[i]), held[i]);
+            }
+            block(body);
+        }
+        jump(post);
+        seal(post);
+        enter(post);
+        if (keyed == nullptr) write(index, value(SsaOp::Add, { read(index, current), constant(1) }));
+        jump(test);
+        seal(test);
+        enter(test);
+        if (keyed != nullptr) branch(value(SsaOp::IterNext, { iter }), first, exit);
+        else branch(value(SsaOp::Lt, { read(index, current), length }), first, exit);
+        seal(first);
+        loops.pop_back();
+        seal(exit);
+        enter(exit);
+    }
+    // channels and values of the cases are evaluated in source order, then the case Select chose is
+    // found by comparing its index. break leaves the select, continue goes to the enclosing loop
+    void selectStmt(SelectStmt* s) {
+        SelectCases cases;
+        vector<uint32_t> args;
+        vector<pair<Stmt*, StmtList*>> clauses;     // the default one is last
+        StmtList* fallback = nullptr;
+        for (auto&[comm, body] : s->caseList) {
+            if (comm == nullptr) {
+                cases.fallback = true;
+                fallback = body;
+                continue;
+            }
+            if (auto* send = as<SendStmt>(comm)) {
+                args.push_back(expr(send->receiver));
+                args.push_back(expr(send->sender));
+            } else if (Expr* ch = received(comm)) args.push_back(expr(ch));
+            else unsupported("select case must be receive, send or assign recv");
+            cases.sends.push_back(comm->kind == NodeKind::SendStmt);
+            clauses.emplace_back(comm, body);
+        }
+        if (cases.fallback) clauses.emplace_back(nullptr, fallback);
+        if (program.selects.size() >= UINT16_MAX) unsupported("too many selects");
+        program.selects.push_back(move(cases));
+        const auto chosen = value(SsaOp::Select, move(args), static_cast<int64_t>(program.selects.size() - 1));
+        const auto join = newBlock();
+        loops.push_back({ join, loops.empty() ? Ssa::None : loops.back().continueTo });
+        for (size_t i = 0; i < clauses.size(); i++) {
+            if (i + 1 < clauses.size()) {
+                const auto body = newBlock(), rest = newBlock();
+                branch(value(SsaOp::Eq, { chosen, constant(static_cast<int64_t>(i)) }), body, rest);
+                seal(body);
+                enter(body);
+                clause(clauses[i].first, clauses[i].second);
+                jump(join);
+                seal(rest);
+                enter(rest);
+            } else clause(clauses[i].first, clauses[i].second);
+        }
+        jump(join);
+        loops.pop_back();
+        seal(join);
+        enter(join);
+    }
+    // v := <-ch and v = <-ch take what the select received, v is of the type of its elements
+    void clause(Stmt* comm, StmtList* body) {
+        Scope inner(*this);
+        if (auto* a = as<SAssignStmt>(comm)) {
+            if (a->lhs.size() != 1) unsupported("multi-value receives are not supported yet");
+            const auto v = value(SsaOp::Received);
+            if (a->lhs[0] != blank) write(declare(a->lhs[0], typeOf(a->rhs->exprs[0])), v);
+        } else if (auto* a = as<AssignStmt>(comm)) {
+            if (a->lhs->exprs.size() != 1) unsupported("multi-value receives are not supported yet");
+            const auto v = value(SsaOp::Received);
+            if (auto* name = as<Name>(a->lhs->exprs[0]); name == nullptr || name->name != blank) write(variable(a->lhs->exprs[0]), v);
+        }
+        block(body);
+    }
+    // the channel s receives from, if it's a receive statement of a select case
+    static Expr* received(Stmt* s) {
+        ExprList* rhs = nullptr;
+        if (auto* e = as<ExprStmt>(s)) {
+            auto* b = as<BasicExpr>(e->expr);
+            return b != nullptr && b->rhs == nullptr && b->op == OP_CHAN ? b->lhs : nullptr;
+        }
+        if (auto* a = as<SAssignStmt>(s)) rhs = a->rhs;
+        else if (auto* a = as<AssignStmt>(s); a != nullptr && a->op == OP_AGN && a->lhs != nullptr) rhs = a->rhs;
+        if (rhs == nullptr || rhs->exprs.size() != 1) return nullptr;
+        auto* b = as<BasicExpr>(rhs->exprs[0]);
+        return b != nullptr && b->rhs == nullptr && b->op == OP_CHAN ? b->lhs : nullptr;
+    }
+    // ends the block by going to then if e is true, else to otherwise; && and || short-circuit
+    void condition(Expr* e, uint32_t then, uint32_t otherwise) {
+        if (auto* b = as<BasicExpr>(e); b != nullptr && b->rhs == nullptr && b->op == OP_NOT) return condition(b->lhs, otherwise, then);
+        if (auto* b = as<BasicExpr>(e); b != nullptr && b->rhs != nullptr && anyone(b->op, OP_AND, OP_OR)) {
+            const auto rest = newBlock();
+            if (b->op == OP_AND) condition(b->lhs, rest, otherwise);
+            else condition(b->lhs, then, rest);
+            seal(rest);
+            enter(rest);
+            return condition(b->rhs, then, otherwise);
+        }
+        branch(expr(e), then, otherwise);
+    }
+#pragma endregion
+#pragma region Expression
+    bool isBuiltin(CallExpr* call, Symbol builtin) const {
+        auto* name = as<Name>(call->operand);
+        return name != nullptr && name->name == builtin && lookup(builtin) == nullptr && decls.count(builtin) == 0;
+    }
+    bool isPrint(CallExpr* call) const { return isBuiltin(call, print); }
+    // what a type name of the package stands for
+    Expr* underlying(Expr* type) const {
+        for (size_t depth = 0; depth <= named.size(); depth++) {
+            auto* name = as<Name>(type);
+            auto it = name != nullptr ? named.find(name->name) : named.end();
+            if (it == named.end()) break;
+            type = it->second;
+        }
+        return type;
+    }
+    // the type of e as far as variables, make, composite literals and results of functions spell it
+    // out, bool of comparisons, logical operations, true and false, or nullptr
+    Expr* typeOf(Expr* e) {
+        switch (e->kind) {
+        case NodeKind::Name: {
+            const Symbol name = static_cast<Name*>(e)->name;
+            if (auto* var = lookup(name)) return underlying(types[*var]);
+            return name == yes || name == no ? &boolean : nullptr;
+        }
+        case NodeKind::CompositeLit: return underlying(static_cast<CompositeLit*>(e)->litName);
+        case NodeKind::BasicExpr: {
+            auto* b = static_cast<BasicExpr*>(e);
+            if (b->rhs == nullptr ? b->op == OP_NOT : anyone(b->op, OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE, OP_AND, OP_OR))
+                return &boolean;
+            auto* ch = b->rhs == nullptr && b->op == OP_CHAN ? as<ChanType>(typeOf(b->lhs)) : nullptr;
+            return ch != nullptr ? underlying(ch->elem) : nullptr;
+        }
+        case NodeKind::IndexExpr: {
+            Expr* t = typeOf(static_cast<IndexExpr*>(e)->operand);
+            if (auto* slice = as<SliceType>(t)) return underlying(slice->elem);
+            if (auto* m = as<MapType>(t)) return underlying(m->elem);
+            return nullptr;
+        }
+        case NodeKind::CallExpr: {
+            auto* call = static_cast<CallExpr*>(e);
+            if (isBuiltin(call, make))
+                return call->arguments != nullptr && !call->arguments->exprs.empty() ? underlying(call->arguments->exprs[0]) : nullptr;
+            auto* name = as<Name>(call->operand);
+            auto decl = name != nullptr && lookup(name->name) == nullptr ? decls.find(name->name) : decls.end();
+            auto* sig = decl != decls.end() ? decl->second->signature : nullptr;
+            if (sig == nullptr) return nullptr;
+            if (auto* results = sig->resultParam) return results->paramList.size() == 1 ? underlying(results->paramList[0]->type) : nullptr;
+            return underlying(sig->resultType);
+        }
+        default: return nullptr;
+        }
+    }
+    // whether e is a comparison, a logical operation, true or false, or of a type that is bool
+    bool isBool(Expr* e) {
+        auto* type = as<Name>(typeOf(e));
+        auto t = type != nullptr ? constants.basic(type->name) : nullopt;
+        return t && t->cls == BasicType::Bool;
+    }
+    // whether e is a map or else a slice. Slices and maps look alike to the VM, so what can't be
+    // typed is neither
+    bool isMap(Expr* e) {
+        Expr* type = typeOf(e);
+        if (type == nullptr) unsupported("the type of " + string(kindName[static_cast<size_t>(e->kind)]) + " is not known, it must be a slice or a map");
+        if (!anyone(type->kind, NodeKind::SliceType, NodeKind::MapType))
+            unsupported(string(kindName[static_cast<size_t>(type->kind)]) + " is not a slice or a map");
+        return type->kind == NodeKind::MapType;
+    }
+    // values are int64 that wrap, so of the basic types only int and int64 and bool behave as Go's do.
+    // Slices, maps and channels of them do too, named types are what they name
+    void checkType(Expr* type, size_t depth = 0) {
+        if (type == nullptr || depth > 2 * named.size() + 16) return;     // a recursive type was checked once around
+        if (auto* name = as<Name>(type)) {
+            if (auto it = named.find(name->name); it != named.end()) return checkType(it->second, depth + 1);
+            auto t = constants.basic(name->name);
+            if (t && ((t->cls == BasicType::Signed && t->bits == 64) || t->cls == BasicType::Bool)) return;
+            unsupported("type " + string(name->name.str()) + " is not supported yet");
+        }
+        if (auto* slice = as<SliceType>(type)) return checkType(slice->elem, depth + 1);
+        if (auto* m = as<MapType>(type)) {
+            checkType(m->type, depth + 1);
+            return checkType(m->elem, depth + 1);
+        }
+        if (auto* ch = as<ChanType>(type)) return checkType(ch->elem, depth + 1);
+        unsupported(string(kindName[static_cast<size_t>(type->kind)]) + " is not supported yet");
+    }
+    bool isGosched(CallExpr* call) const {
+        auto* sel = as<SelectorExpr>(call->operand);
+        auto* pkg = sel != nullptr ? as<Name>(sel->operand) : nullptr;
+        return pkg != nullptr && pkg->name == runtime && sel->selector == gosched && lookup(runtime) == nullptr
+            && (call->arguments == nullptr || call->arguments->exprs.empty());
+    }
+    // Print prints an integer, strings[aux >> 32], nothing or a bool as aux & 3 is 0, 1, 2 or 3, then
+    // the character aux >> 8 & 0xFF
+    void printCall(CallExpr* call) {
+        const size_t n = call->arguments != nullptr ? call->arguments->exprs.size() : 0;
+        if (n == 0) value(SsaOp::Print, {}, 2 | '\n' << 8);
+        for (size_t i = 0; i < n; i++) {
+            const int64_t after = (i + 1 < n ? ' ' : '\n') << 8;
+            auto* lit = as<BasicLit>(call->arguments->exprs[i]);
+            if (lit != nullptr && lit->type == LIT_STR) {
+                if (program.strings.size() >= UINT16_MAX) unsupported("too many strings");
+                program.strings.push_back(Constants::unquote(lit->value.str()));
+                value(SsaOp::Print, {}, 1 | after | static_cast<int64_t>(program.strings.size() - 1) << 32);
+            } else value(SsaOp::Print, { expr(call->arguments->exprs[i]) }, (isBool(call->arguments->exprs[i]) ? 3 : 0) | after);
+        }
+    }
+    // a call of a package function, or a goroutine that runs one
+    uint32_t call(CallExpr* e, bool valued, SsaOp op = SsaOp::Call) {
+        auto* name = as<Name>(e->operand);
+        if (name == nullptr) unsupported("calls of " + string(kindName[static_cast<size_t>(e->operand->kind)]) + " are not supported yet");
+        if (lookup(name->name) != nullptr) unsupported("calls of function values are not supported yet");
+        const auto callee = function(name->name);
+        const Function& fn = program.funcs[callee];
+        const size_t n = e->arguments != nullptr ? e->arguments->exprs.size() : 0;
+        if (e->isVariadic || n != fn.params) unsupported("wrong argument count in call to " + string(name->name.str()));
+        if (valued && !fn.result) unsupported(string(name->name.str()) + "() used as value");
+        vector<uint32_t> args;
+        for (size_t i = 0; i < n; i++) args.push_back(expr(e->arguments->exprs[i]));
+        return value(op, move(args), callee);
+    }
+    uint32_t expr(Expr* e) {
+        if (e == nullptr) unsupported("missing expression");
+        switch (e->kind) {
+        case NodeKind::Name: {
+            const Symbol name = static_cast<Name*>(e)->name;
+            if (auto* var = lookup(name)) return read(*var, current);
+            if (name != yes && name != no) unsupported("undefined: " + string(name.str()));
+            return constant(name == yes);
+        }
+        case NodeKind::BasicLit: return constant(literal(static_cast<BasicLit*>(e)));
+        case NodeKind::CallExpr: {
+            auto* call = static_cast<CallExpr*>(e);
+            if (isPrint(call)) unsupported("g5print() used as value");
+            if (isBuiltin(call, make)) {
+                const size_t n = call->arguments != nullptr ? call->arguments->exprs.size() : 0;
+                if (n == 0 || n > 3) unsupported("wrong argument count in call to make");
+                auto* type = underlying(call->arguments->exprs[0]);
+                if (type != nullptr && type->kind == NodeKind::MapType) {
+                    if (n == 3) unsupported("wrong argument count in call to make");
+                    return value(SsaOp::MakeMap, { n == 2 ? expr(call->arguments->exprs[1]) : constant(0) });
+                }
+                if (type != nullptr && type->kind == NodeKind::SliceType) {
+                    if (n == 1) unsupported("missing len argument to make");
+                    const auto len = expr(call->arguments->exprs[1]);
+                    if (n == 3) expr(call->arguments->exprs[2]);     // the capacity is the length until append exists
+                    return value(SsaOp::MakeSlice, { len });
+                }
+                if (type == nullptr || type->kind != NodeKind::ChanType || n == 3)
+                    unsupported("make of types besides channels, slices and maps is not supported yet");
+                return value(SsaOp::MakeChan, { n == 2 ? expr(call->arguments->exprs[1]) : constant(0) });
+            }
+            if (isBuiltin(call, length)) {
+                if (call->arguments == nullptr || call->arguments->exprs.size() != 1) unsupported("wrong argument count in call to len");
+                auto* x = call->arguments->exprs[0];
+                return value(isMap(x) ? SsaOp::MapLen : SsaOp::Len, { expr(x) });
+            }
+            if (auto* type = as<Name>(call->operand); type != nullptr && lookup(type->name) == nullptr && decls.count(type->name) == 0
+                && call->arguments != nullptr && call->arguments->exprs.size() == 1 && constants.isLiteral(call->arguments->exprs[0]))
+                if (auto t = constants.basic(type->name)) {
+                    // a typed constant, folding checked it fits. Only int is what the VM computes in
+                    if (t->cls != BasicType::Signed || t->bits != 64) unsupported("conversion to " + string(type->name.str()) + " is not supported yet");
+                    return expr(call->arguments->exprs[0]);
+                }
+            return this->call(call, true);
+        }
+        case NodeKind::BasicExpr: {
+            auto* b = static_cast<BasicExpr*>(e);
+            if (b->rhs == nullptr) {
+                switch (b->op) {
+                case OP_ADD: return expr(b->lhs);
+                case OP_SUB:
+                    if (auto* lit = as<BasicLit>(b->lhs)) return constant(literal(lit, true));
+                    return value(SsaOp::Neg, { expr(b->lhs) });
+                case OP_NOT: return value(SsaOp::Not, { expr(b->lhs) });
+                case OP_XOR: return value(SsaOp::Com, { expr(b->lhs) });
+                case OP_CHAN: return value(SsaOp::Recv, { expr(b->lhs) });
+                default:     unsupported("unary " + string(spelling(b->op)) + " is not supported yet");
+                }
+            }
+            if (anyone(b->op, OP_AND, OP_OR)) {    // the value of lhs decides unless it's true for &&, false for ||
+                const auto lhs = expr(b->lhs), from = current, rest = newBlock(), join = newBlock();
+                if (b->op == OP_AND) branch(lhs, rest, join);
+                else branch(lhs, join, rest);
+                seal(rest);
+                enter(rest);
+                const auto rhs = expr(b->rhs);
+                jump(join);
+                seal(join);
+                enter(join);
+                const auto v = phi(join);
+                f.values[v].args = f.blocks[join].preds[0] == from ? vector<uint32_t>{ lhs, rhs } : vector<uint32_t>{ rhs, lhs };
+                return v;
+            }
+            const auto lhs = expr(b->lhs);
+            return binary(b->op, lhs, expr(b->rhs));
+        }
+        case NodeKind::IndexExpr: {
+            auto* i = static_cast<IndexExpr*>(e);
+            const bool keyed = isMap(i->operand);
+            const auto slice = expr(i->operand);
+            return value(keyed ? SsaOp::MapIndex : SsaOp::Index, { slice, expr(i->index) });
+        }
+        case NodeKind::CompositeLit: {
+            auto* lit = static_cast<CompositeLit*>(e);
+            return composite(lit->litName, lit->litValue);
+        }
+        default: unsupported(string(kindName[static_cast<size_t>(e->kind)]) + " is not supported yet");
+        }
+    }
+    // []T{...} is made with its length and then filled, map[K]V{...} entry by entry. Elements of [][]T
+    // and of map[K][]T may leave out their type
+    uint32_t composite(Expr* type, LitValue* lit) {
+        type = underlying(type);
+        const size_t n = lit != nullptr ? lit->keyedElement.size() : 0;
+        if (auto* m = as<MapType>(type)) {
+            const auto v = value(SsaOp::MakeMap, { constant(static_cast<int64_t>(n)) });
+            for (size_t i = 0; i < n; i++) {
+                auto[key, elem] = lit->keyedElement[i];
+                if (key == nullptr) unsupported("missing key in map literal");
+                const auto k = expr(key);
+                const auto x = elem->kind == NodeKind::LitValue ? composite(m->elem, static_cast<LitValue*>(elem)) : expr(elem);
+                value(SsaOp::SetMap, { v, k, x });
+            }
+            return v;
+        }
+        auto* slice = as<SliceType>(type);
+        if (slice == nullptr) unsupported("composite literals besides slices and maps are not supported yet");
+        const auto v = value(SsaOp::MakeSlice, { constant(static_cast<int64_t>(n)) });
+        for (size_t i = 0; i < n; i++) {
+            auto[key, elem] = lit->keyedElement[i];
+            if (key != nullptr) unsupported("keyed elements are not supported yet");
+            const auto x = elem->kind == NodeKind::LitValue ? composite(slice->elem, static_cast<LitValue*>(elem)) : expr(elem);
+            value(SsaOp::SetIndex, { v, constant(static_cast<int64_t>(i)), x });
+        }
+        return v;
+    }
+#pragma endregion
+};
+#pragma region Lowering
+// Turns optimized SSA into bytecode. Registers are colored greedily from an interference graph,
+// a phi shares the register of its arguments where they don't interfere, a value that only feeds
+// the next call is computed where the frame of the callee starts, and a comparison that only
+// feeds an If becomes a jump
+struct Lowering {
+    Program& program;
+    map<int64_t, uint16_t> constIndex;
+    // the function being lowered
+    vector<Insn> code;
+    vector<uint32_t> reg;          // of each value, None for values that need none
+
+    explicit Lowering(Program& program) :program(program) {}
+    size_t emit(Op op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0) {
+        code.push_back({ op, a, b, c });
+        return code.size() - 1;
+    }
+    void load(uint16_t dst, int64_t v) {
+        if (v >= INT16_MIN && v <= INT16_MAX) {
+            emit(Op::LoadI, dst, static_cast<uint16_t>(v));
+            return;
+        }
+        auto[k, added] = constIndex.emplace(v, static_cast<uint16_t>(program.consts.size()));
+        if (added) {
+            if (program.consts.size() >= UINT16_MAX) Emitter::unsupported("too many constants");
+            program.consts.push_back(v);
+        }
+        emit(Op::LoadK, dst, k->second);
+    }
+    uint16_t r(uint32_t v) const { return static_cast<uint16_t>(reg[v]); }
+    // additions of small constants become AddI, a block that jumps to phis gets a block of its own
+    // for the copies when it has another successor
+    static void select(Ssa& f) {
+        auto small = [&](uint32_t v, bool negate) {
+            const Value& k = f.values[v];
+            return k.op == SsaOp::Const && k.aux > INT16_MIN && k.aux <= INT16_MAX && (!negate || k.aux != INT16_MIN);
+        };
+        for (auto b : f.order)
+            for (auto v : f.blocks[b].values) {
+                auto& value = f.values[v];
+                if (value.op == SsaOp::Add && (small(value.args[1], false) || small(value.args[0], false))) {
+                    const bool right = small(value.args[1], false);
+                    value.aux = f.values[value.args[right ? 1 : 0]].aux;
+                    value.args = { value.args[right ? 0 : 1] };
+                    value.op = SsaOp::AddI;
+                } else if (value.op == SsaOp::Sub && small(value.args[1], true)) {
+                    value.aux = -f.values[value.args[1]].aux;
+                    value.args = { value.args[0] };
+                    value.op = SsaOp::AddI;
+                }
+            }
+        dce(f);
+        for (auto b : vector<uint32_t>(f.order)) {
+            if (f.blocks[b].succs.size() < 2) continue;
+            for (size_t i = 0; i < f.blocks[b].succs.size(); i++) {
+                const auto s = f.blocks[b].succs[i];
+                if (f.phis(s) == 0) continue;
+                const auto split = f.block();
+                f.blocks[split].exit = Block::Jump;
+                f.blocks[split].preds = { b };
+                f.blocks[split].succs = { s };
+                f.blocks[b].succs[i] = split;
+                *find(f.blocks[s].preds.begin(), f.blocks[s].preds.end(), b) = split;
+                f.order.push_back(split);
+            }
+        }
+    }
+    void lower(Ssa& f, Function& fn) {
+        select(f);
+        const size_t n = f.values.size();
+        vector<uint32_t> uses(n), position(n);
+        for (auto b : f.order) {
+            const auto& block = f.blocks[b];
+            if (block.control != Ssa::None) uses[block.control]++;
+            for (size_t i = 0; i < block.values.size(); i++) {
+                position[block.values[i]] = static_cast<uint32_t>(i);
+                for (auto a : f.values[block.values[i]].args) uses[a]++;
+            }
+        }
+        // fused comparisons and call arguments get no color, arguments go above every colored register
+        vector<bool> fused(n);
+        vector<uint32_t> outgoing(n, Ssa::None);
+        for (auto b : f.order) {
+            auto& block = f.blocks[b];
+            const auto c = block.control;
+            if (block.exit == Block::If && f.values[c].block == b && uses[c] == 1
+                && anyone(f.values[c].op, SsaOp::Eq, SsaOp::Ne, SsaOp::Lt, SsaOp::Le)) {
+                fused[c] = true;
+                block.values.erase(find(block.values.begin(), block.values.end(), c));
+                block.values.push_back(c);
+            }
+            uint32_t lastCall = 0;
+            for (uint32_t i = 0; i < block.values.size(); i++) {
+                position[block.values[i]] = i;
+                const Value& value = f.values[block.values[i]];
+                if (!anyone(value.op, SsaOp::Call, SsaOp::Go, SsaOp::Select)) continue;
+                for (size_t k = 0; k < value.args.size(); k++) {
+                    const auto a = value.args[k];
+                    if (f.values[a].block == b && uses[a] == 1 && position[a] >= lastCall && position[a] < i
+                        && !anyone(f.values[a].op, SsaOp::Phi, SsaOp::Param)) outgoing[a] = static_cast<uint32_t>(k);
+                }
+                lastCall = i;
+            }
+        }
+        auto colored = [&](uint32_t v) {
+            return !anyone(f.values[v].op, SsaOp::Print, SsaOp::Go, SsaOp::Yield, SsaOp::Send, SsaOp::Close, SsaOp::SetIndex,
+                SsaOp::SetMap, SsaOp::Delete) && !fused[v]
+                && outgoing[v] == Ssa::None;
+        };
+        // liveness, live-in of a block leaves out its phis, whose arguments are live out of predecessors
+        const size_t words = (n + 63) / 64;
+        vector<vector<uint64_t>> liveIn(f.blocks.size(), vector<uint64_t>(words)), liveOut = liveIn;
+        auto set = [](vector<uint64_t>& s, uint32_t v) { s[v / 64] |= uint64_t{ 1 } << v % 64; };
+        auto reset = [](vector<uint64_t>& s, uint32_t v) { s[v / 64] &= ~(uint64_t{ 1 } << v % 64); };
+        auto each = [&](const vector<uint64_t>& s, auto&& fn) {
+            for (size_t w = 0; w < words; w++)
+                for (uint64_t bits = s[w]; bits != 0; bits &= bits - 1) fn(static_cast<uint32_t>(w * 64 + __builtin_ctzll(bits)));
+        };
+        auto backward = [&](uint32_t b, vector<uint64_t>& live, auto&& def) {
+            const auto& block = f.blocks[b];
+            if (block.control != Ssa::None) set(live, block.control);
+            for (size_t i = block.values.size(), phis = f.phis(b); i-- > phis;) {
+                const auto v = block.values[i];
+                def(v, live);
+                reset(live, v);
+                for (auto a : f.values[v].args) set(live, a);
+            }
+            for (size_t i = 0, phis = f.phis(b); i < phis; i++) reset(live, block.values[i]);
+        };
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (auto k = f.order.rbegin(); k != f.order.rend(); ++k) {
+                const auto b = *k;
+                vector<uint64_t> out(words);
+                for (auto s : f.blocks[b].succs) {
+                    for (size_t w = 0; w < words; w++) out[w] |= liveIn[s][w];
+                    const size_t at = find(f.blocks[s].preds.begin(), f.blocks[s].preds.end(), b) - f.blocks[s].preds.begin();
+                    for (size_t i = 0, phis = f.phis(s); i < phis; i++) set(out, f.values[f.blocks[s].values[i]].args[at]);
+                }
+                liveOut[b] = out;
+                backward(b, out, [](uint32_t, auto&) {});
+                if (out != liveIn[b]) { liveIn[b] = move(out); changed = true; }
+            }
+        }
+        vector<vector<uint32_t>> adj(n);
+        auto interfere = [&](uint32_t v, uint32_t w) {
+            if (v == w || !colored(v) || !colored(w)) return;
+            adj[v].push_back(w);
+            adj[w].push_back(v);
+        };
+        for (auto b : f.order) {
+            auto live = liveOut[b];
+            backward(b, live, [&](uint32_t v, auto& now) { each(now, [&](uint32_t w) { interfere(v, w); }); });
+            const auto& values = f.blocks[b].values;
+            for (size_t i = 0, phis = f.phis(b); i < phis; i++) {
+                each(live, [&](uint32_t w) { interfere(values[i], w); });
+                for (size_t j = 0; j < i; j++) interfere(values[i], values[j]);
+            }
+        }
+        // phis and copies join the classes of their arguments, a parameter fixes the register of its class
+        vector<uint32_t> parent(n), fixed(n, Ssa::None);
+        vector<vector<uint32_t>> members(n);
+        for (uint32_t v = 0; v < n; v++) {
+            parent[v] = v;
+            members[v] = { v };
+            if (f.values[v].op == SsaOp::Param && f.values[v].block != Ssa::None) fixed[v] = static_cast<uint32_t>(f.values[v].aux);
+        }
+        auto root = [&](uint32_t v) {
+            while (parent[v] != v) v = parent[v] = parent[parent[v]];
+            return v;
+        };
+        auto coalesce = [&](uint32_t x, uint32_t y) {
+            x = root(x); y = root(y);
+            if (x == y || !colored(x) || !colored(y) || (fixed[x] != Ssa::None && fixed[y] != Ssa::None)) return;
+            if (members[x].size() < members[y].size()) swap(x, y);
+            for (auto m : members[y]) for (auto w : adj[m]) if (root(w) == x) return;
+            parent[y] = x;
+            if (fixed[x] == Ssa::None) fixed[x] = fixed[y];
+            members[x].insert(members[x].end(), members[y].begin(), members[y].end());
+            members[y].clear();
+        };
+        for (auto b : f.order)
+            for (auto v : f.blocks[b].values)
+                if (anyone(f.values[v].op, SsaOp::Phi, SsaOp::Copy)) for (auto a : f.values[v].args) coalesce(v, a);
+        reg.assign(n, Ssa::None);
+        uint32_t registers = f.params;
+        vector<uint32_t> taken;
+        for (auto b : f.order)
+            for (auto v : f.blocks[b].values) {
+                const auto c = root(v);
+                if (!colored(v) || reg[c] != Ssa::None) continue;
+                uint32_t color = fixed[c];
+                if (color == Ssa::None) {
+                    taken.clear();
+                    for (auto m : members[c]) for (auto w : adj[m]) if (reg[root(w)] != Ssa::None) taken.push_back(reg[root(w)]);
+                    sort(taken.begin(), taken.end());
+                    color = 0;
+                    for (auto t : taken) if (t == color) color++; else if (t > color) break;
+                }
+                reg[c] = color;
+                registers = max(registers, color + 1);
+            }
+        const uint32_t base = registers;
+        for (uint32_t v = 0; v < n; v++) {
+            if (f.values[v].block == Ssa::None) continue;
+            if (colored(v)) reg[v] = reg[root(v)];
+            else if (outgoing[v] != Ssa::None) reg[v] = base + outgoing[v];
+        }
+        // code, a block falls through to the next one where it can. The check of the stack leads it,
+        // jumps back to the entry block go past it
+        code.clear();
+        const size_t check = emit(Op::Stack);
+        vector<size_t> start(f.blocks.size());
+        vector<pair<size_t, uint32_t>> jumps;
+        uint32_t frame = base + 1;     // base is also the scratch register of phi copies
+        for (size_t k = 0; k < f.order.size(); k++) {
+            const auto b = f.order[k];
+            const auto& block = f.blocks[b];
+            const auto next = k + 1 < f.order.size() ? f.order[k + 1] : Ssa::None;
+            start[b] = code.size();
+            for (auto v : block.values) {
+                const Value& value = f.values[v];
+                switch (value.op) {
+                case SsaOp::Const: load(r(v), value.aux); break;
+                case SsaOp::Param: case SsaOp::Phi: break;
+                case SsaOp::Copy:  if (reg[v] != reg[value.args[0]]) emit(Op::Move, r(v), r(value.args[0])); break;
+                case SsaOp::AddI:  emit(Op::AddI, r(v), r(value.args[0]), static_cast<uint16_t>(value.aux)); break;
+                case SsaOp::Call: case SsaOp::Go: case SsaOp::Select: {
+                    for (size_t i = 0; i < value.args.size(); i++)
+                        if (reg[value.args[i]] != base + i) emit(Op::Move, static_cast<uint16_t>(base + i), r(value.args[i]));
+                    frame = max(frame, base + static_cast<uint32_t>(value.args.size()));
+                    const auto op = value.op == SsaOp::Go ? Op::Go : value.op == SsaOp::Select ? Op::Select : Op::Call;
+                    emit(op, value.op == SsaOp::Go ? 0 : r(v), static_cast<uint16_t>(value.aux), static_cast<uint16_t>(base));
+                    break;
+                }
+                case SsaOp::Yield:    emit(Op::Yield); break;
+                case SsaOp::MakeChan: emit(Op::MakeChan, r(v), r(value.args[0])); break;
+                case SsaOp::Send:     emit(Op::Send, r(value.args[0]), r(value.args[1])); break;
+                case SsaOp::Recv:     emit(Op::Recv, r(v), r(value.args[0])); break;
+                case SsaOp::Close:    emit(Op::Close, r(value.args[0])); break;
+                case SsaOp::Received: emit(Op::Received, r(v)); break;
+                case SsaOp::MakeSlice: emit(Op::MakeSlice, r(v), r(value.args[0])); break;
+                case SsaOp::Index:    emit(Op::Index, r(v), r(value.args[0]), r(value.args[1])); break;
+                case SsaOp::SetIndex: emit(Op::SetIndex, r(value.args[0]), r(value.args[1]), r(value.args[2])); break;
+                case SsaOp::Len: case SsaOp::MapLen: emit(Op::Len, r(v), r(value.args[0])); break;
+                case SsaOp::MakeMap:  emit(Op::MakeMap, r(v), r(value.args[0])); break;
+                case SsaOp::MapIndex: emit(Op::MapIndex, r(v), r(value.args[0]), r(value.args[1])); break;
+                case SsaOp::MapHas:   emit(Op::MapHas, r(v), r(value.args[0]), r(value.args[1])); break;
+                case SsaOp::SetMap:   emit(Op::SetMap, r(value.args[0]), r(value.args[1]), r(value.args[2])); break;
+                case SsaOp::Delete:   emit(Op::Delete, r(value.args[0]), r(value.args[1])); break;
+                case SsaOp::MapIter:  emit(Op::MapIter, r(v), r(value.args[0])); break;
+                case SsaOp::IterNext: emit(Op::IterNext, r(v), r(value.args[0])); break;
+                case SsaOp::IterKey:  emit(Op::IterKey, r(v), r(value.args[0])); break;
+                case SsaOp::IterValue: emit(Op::IterValue, r(v), r(value.args[0])); break;
+                case SsaOp::Print: {
+                    const auto kind = static_cast<uint16_t>(value.aux & 3), after = static_cast<uint16_t>(value.aux >> 8 & 0xFF);
+                    emit(Op::Print, kind == 0 || kind == 3 ? r(value.args[0]) : static_cast<uint16_t>(value.aux >> 32), kind, after);
+                    break;
+                }
+                default: {
+                    if (fused[v]) break;
+                    constexpr pair<SsaOp, Op> ops[] = { {SsaOp::Add, Op::Add}, {SsaOp::Sub, Op::Sub}, {SsaOp::Mul, Op::Mul},
+                        {SsaOp::Div, Op::Div}, {SsaOp::Mod, Op::Mod}, {SsaOp::And, Op::And}, {SsaOp::Or, Op::Or},
+                        {SsaOp::Xor, Op::Xor}, {SsaOp::AndNot, Op::AndNot}, {SsaOp::Shl, Op::Shl}, {SsaOp::Shr, Op::Shr},
+                        {SsaOp::Eq, Op::Eq}, {SsaOp::Ne, Op::Ne}, {SsaOp::Lt, Op::Lt}, {SsaOp::Le, Op::Le},
+                        {SsaOp::Neg, Op::Neg}, {SsaOp::Not, Op::Not}, {SsaOp::Com, Op::Com} };
+                    for (auto[from, to] : ops)
+                        if (from == value.op) emit(to, r(v), r(value.args[0]), value.args.size() > 1 ? r(value.args[1]) : 0);
+                }
+                }
+            }
+            if (block.exit == Block::Jump) copies(f, b, base);
+            auto go = [&](Op op, uint32_t target, uint16_t x = 0, uint16_t y = 0) { jumps.emplace_back(emit(op, x, y), target); };
+            switch (block.exit) {
+            case Block::Jump:
+                if (block.succs[0] != next) go(Op::Jump, block.succs[0]);
+                break;
+            case Block::If: {
+                const auto c = block.control, then = block.succs[0], otherwise = block.succs[1];
+                const bool flip = then == next;
+                if (fused[c]) {
+                    const Value& cmp = f.values[c];
+                    auto x = r(cmp.args[0]), y = r(cmp.args[1]);
+                    Op op = cmp.op == SsaOp::Eq ? Op::JumpEq : cmp.op == SsaOp::Ne ? Op::JumpNe : cmp.op == SsaOp::Lt ? Op::JumpLt : Op::JumpLe;
+                    if (flip) {     // x < y is false when y <= x
+                        switch (op) {
+                        case Op::JumpEq: op = Op::JumpNe; break;
+                        case Op::JumpNe: op = Op::JumpEq; break;
+                        case Op::JumpLt: op = Op::JumpLe; swap(x, y); break;
+                        default:         op = Op::JumpLt; swap(x, y); break;
+                        }
+                    }
+                    go(op, flip ? otherwise : then, x, y);
+                } else go(flip ? Op::JumpIfNot : Op::JumpIf, flip ? otherwise : then, r(c));
+                if (!flip && otherwise != next) go(Op::Jump, otherwise);
+                break;
+            }
+            case Block::Ret:
+                if (block.control != Ssa::None) emit(Op::Ret, r(block.control), 1);
+                else emit(Op::Ret);
+                break;
+            }
+        }
+        for (auto[at, target] : jumps) code[at].c = static_cast<uint16_t>(start[target]);
+        if (code.size() > UINT16_MAX) Emitter::unsupported(string(f.name.str()) + " is too large");
+        if (frame >= UINT16_MAX) Emitter::unsupported("more than 65535 registers in " + string(f.name.str()));
+        fn.registers = static_cast<uint16_t>(frame);
+        code[check].a = fn.registers;
+        fn.code = move(code);
+    }
+    // the phis of the successor take their arguments at once, a cycle goes through the scratch register
+    void copies(const Ssa& f, uint32_t b, uint32_t scratch) {
+        const auto s = f.blocks[b].succs[0];
+        const size_t at = find(f.blocks[s].preds.begin(), f.blocks[s].preds.end(), b) - f.blocks[s].preds.begin();
+        vector<pair<uint32_t, uint32_t>> moves;     // to, from
+        for (size_t i = 0, phis = f.phis(s); i < phis; i++) {
+            const auto v = f.blocks[s].values[i];
+            if (reg[v] != reg[f.values[v].args[at]]) moves.emplace_back(reg[v], reg[f.values[v].args[at]]);
+        }
+        while (!moves.empty()) {
+            auto ready = find_if(moves.begin(), moves.end(), [&](auto& m) {
+                return none_of(moves.begin(), moves.end(), [&](auto& other) { return other.second == m.first; });
+            });
+            if (ready == moves.end()) {
+                const auto saved = moves[0].first;
+                emit(Op::Move, static_cast<uint16_t>(scratch), static_cast<uint16_t>(saved));
+                for (auto& m : moves) if (m.second == saved) m.second = scratch;
+                continue;
+            }
+            emit(Op::Move, static_cast<uint16_t>(ready->first), static_cast<uint16_t>(ready->second));
+            moves.erase(ready);
+        }
+    }
+};
+#pragma endregion
+#pragma endregion
+// Folds constants of the package and lowers the program of package main, functions are lowered as
+// main.main reaches them. With dump the SSA of each function is printed around every pass
+Program codegen(const Package& pkg, ostream* dump = nullptr) {
+    Program program;
+    Constants constants(pkg);
+    constants.fold();
+    if (pkg.name != symbols.intern("main")) return program;
+    Emitter e(pkg, program, constants);
+    Lowering lowering(program);
+    try {
+        if (e.decls.count(symbols.intern("main")) == 0) Emitter::unsupported("function main is undeclared in the main package");
+        const auto main = e.function(symbols.intern("main"));
+        if (program.funcs[main].params != 0 || program.funcs[main].result)
+            Emitter::unsupported("func main must have no arguments and no return values");
+        while (!e.todo.empty()) {
+            const auto[decl, at] = e.todo.back();
+            e.todo.pop_back();
+            Ssa f = e.build(decl, at);
+            optimize(f, program, dump);
+            lowering.lower(f, program.funcs[at]);
+        }
+        program.entry = main;
+    } catch (Emitter::Unsupported& u) {
+        program.note = move(u.what);
+    }
+    return program;
+}
+
+#pragma region Runtime
+// Maps are Swiss tables. Slots are in groups of 16 with a control byte each: 0 while the slot is
+// empty, 1 once its entry was deleted and 2 once growth moved it on, else 0x80 and 7 bits of the hash
+// of its key. A lookup compares those bits with the bytes of a whole group at once, by SSE2 where it's
+// there, and probes groups quadratically from the one the rest of the hash picks until a group has an
+// empty slot. A table that fills up is moved to a new one a few groups on each write, so no write pays
+// for all of them, and lookups try both meanwhile. Memory hands out zeroed blocks, takes them back and
+// is told of every key, value and table a store overwrites
+template<class K, class Memory> class SwissMap {
+public:
+    struct Slot { K key; int64_t value; };
+    struct Group { uint8_t ctrl[16]; Slot slots[16]; };
+    struct Table {
+        uint64_t mask, reserved;            // groups - 1, the groups follow
+        Group* groups() { return reinterpret_cast<Group*>(this + 1); }
+        uint64_t slots() const { return (mask + 1) * 16; }
+    };
+    struct Header {
+        int64_t count;                      // leads like the length of a slice does, len() reads both
+        Table* table, *old;                 // groups of old below moved were moved to table
+        uint64_t moved;
+        int64_t growth;                     // empty slots of table that may still be filled
+        uint64_t seed;
+    };
+    // where range is in table. Once the map moved on to another table, entries are looked up again
+    struct Iterator { Header* map; Table* table; uint64_t pos; K key; int64_t value; };
+    enum : uint8_t { Empty = 0, Deleted = 1, Moved = 2, Full = 0x80 };
+    static constexpr uint64_t Evacuate = 2;     // groups of the old table a write moves
+
+    SwissMap(Header& h, Memory memory) :h(h), memory(memory) {}
+    Slot* find(const K& key) const { return h.count != 0 ? locate(key, hash(key, h.seed)) : nullptr; }
+    void set(const K& key, int64_t value) {
+        if (h.old != nullptr) evacuate(Evacuate);
+        const uint64_t at = hash(key, h.seed);
+        if (Slot* s = locate(key, at)) {
+            memory.overwrite(s->value);
+            s->value = value;
+            return;
+        }
+        if (h.table == nullptr || h.growth == 0) grow();
+        insert(key, at, value);
+        h.count++;
+    }
+    bool erase(const K& key) {
+        if (h.count == 0) return false;
+        if (h.old != nullptr) evacuate(Evacuate);
+        const uint64_t at = hash(key, h.seed);
+        for (Table* t : { h.table, h.old }) {
+            Slot* s = t != nullptr ? lookup(*t, key, at) : nullptr;
+            if (s == nullptr) continue;
+            const size_t offset = reinterpret_cast<char*>(s) - reinterpret_cast<char*>(t->groups());
+            Group& group = t->groups()[offset / sizeof(Group)];
+            const size_t i = s - group.slots;
+            memory.overwrite(s->key);
+            memory.overwrite(s->value);
+            *s = Slot{};
+            // no probe went on past a group with an empty slot, the slot may be empty again
+            if (t == h.table && match(group.ctrl, Empty) != 0) {
+                group.ctrl[i] = Empty;
+                h.growth++;
+            } else group.ctrl[i] = Deleted;
+            h.count--;
+            return true;
+        }
+        return false;
+    }
+    // room for n entries before the table grows
+    void reserve(int64_t n) {
+        if (n <= 0 || h.table != nullptr) return;
+        uint64_t groups = 1;
+        while (groups * 14 < static_cast<uint64_t>(min<int64_t>(n, int64_t{ 1 } << 26))) groups *= 2;
+        h.table = table(groups);
+        h.growth = static_cast<int64_t>(groups * 14);
+    }
+    // range starts on a table nothing is moved to
+    void start(Iterator& it) {
+        if (h.old != nullptr) evacuate(UINT64_MAX);
+        it.map = &h;
+        it.table = h.table;
+        it.pos = 0;
+    }
+    // the next entry in the order of slots, false once there is none. An entry of a table the map
+    // moved on from is only produced if the map still has it, with the value it has now
+    static bool next(Iterator& it, Memory memory) {
+        if (it.map == nullptr || it.table == nullptr) return false;
+        SwissMap map(*it.map, memory);
+        const bool current = it.table == it.map->table;
+        Group* groups = it.table->groups();
+        while (it.pos < it.table->slots()) {
+            Group& group = groups[it.pos / 16];
+            const uint32_t candidates = current ? full(group.ctrl) : full(group.ctrl) | match(group.ctrl, Moved);
+            const uint32_t m = candidates & 0xFFFFu << it.pos % 16;
+            if (m == 0) {
+                it.pos = (it.pos / 16 + 1) * 16;
+                continue;
+            }
+            const int i = __builtin_ctz(m);
+            it.pos = it.pos / 16 * 16 + i + 1;
+            const Slot* s = current ? &group.slots[i] : map.find(group.slots[i].key);
+            if (s == nullptr) continue;
+            memory.overwrite(it.key);
+            memory.overwrite(it.value);
+            it.key = s->key;
+            it.value = s->value;
+            return true;
+        }
+        return false;
+    }
+    static uint64_t mix(uint64_t x) {
+        x = (x ^ x >> 33) * 0xFF51AFD7ED558CCDull;
+        x = (x ^ x >> 33) * 0xC4CEB9FE1A85EC53ull;
+        return x ^ x >> 33;
+    }
+    // keys of integers are mixed at once, strings are multiplied in 8 bytes at a time, the last 8 of
+    // them may overlap the ones before
+    static uint64_t hash(int64_t key, uint64_t seed) { return mix(static_cast<uint64_t>(key) ^ seed); }
+    static uint64_t hash(string_view key, uint64_t seed) {
+        auto word = [&](size_t at, size_t bytes) {
+            uint64_t w = 0;
+            memcpy(&w, key.data() + at, bytes);
+            return w;
+        };
+        const size_t n = key.size();
+        uint64_t h = seed ^ n * 0x9E3779B97F4A7C15ull;
+        if (n < 8) return mix(h ^ (n >= 4 ? word(0, 4) << 32 | word(n - 4, 4) : word(0, n)));
+        for (size_t i = 0; i + 8 < n; i += 8) h = (h ^ word(i, 8)) * 0xFF51AFD7ED558CCDull, h ^= h >> 32;
+        return mix(h ^ word(n - 8, 8));
+    }
+private:
+    Header& h;
+    Memory memory;
+
+    // bits of the bytes of a group that are b, and of the full ones
+    static uint32_t match(const uint8_t* ctrl, uint8_t b) {
+#ifdef G5_SSE2
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(b)))));
+#else
+        uint32_t m = 0;
+        for (int i = 0; i < 16; i++) m |= uint32_t{ ctrl[i] == b } << i;
+        return m;
+#endif
+    }
+    static uint32_t full(const uint8_t* ctrl) {
+#ifdef G5_SSE2
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))));
+#else
+        uint32_t m = 0;
+        for (int i = 0; i < 16; i++) m |= uint32_t{ ctrl[i] >> 7u } << i;
+        return m;
+#endif
+    }
+    static Slot* lookup(Table& t, const K& key, uint64_t at) {
+        const auto tag = static_cast<uint8_t>(Full | (at & 0x7F));
+        Group* groups = t.groups();
+        for (uint64_t g = at >> 7 & t.mask, step = 1;; g = (g + step++) & t.mask) {
+            Group& group = groups[g];
+            for (uint32_t m = match(group.ctrl, tag); m != 0; m &= m - 1)
+                if (group.slots[__builtin_ctz(m)].key == key) return &group.slots[__builtin_ctz(m)];
+            if (match(group.ctrl, Empty) != 0) return nullptr;
+        }
+    }
+    Slot* locate(const K& key, uint64_t at) const {
+        Slot* s = h.table != nullptr ? lookup(*h.table, key, at) : nullptr;
+        return s != nullptr || h.old == nullptr ? s : lookup(*h.old, key, at);
+    }
+    // into the first slot of table on the probe of a key it doesn't hold
+    void insert(const K& key, uint64_t at, int64_t value) {
+        Group* groups = h.table->groups();
+        for (uint64_t g = at >> 7 & h.table->mask, step = 1;; g = (g + step++) & h.table->mask) {
+            Group& group = groups[g];
+            if (const uint32_t open = ~full(group.ctrl) & 0xFFFF) {
+                const int i = __builtin_ctz(open);
+                if (group.ctrl[i] == Empty) h.growth--;
+                group.ctrl[i] = static_cast<uint8_t>(Full | (at & 0x7F));
+                group.slots[i] = { key, value };
+                return;
+            }
+        }
+    }
+    Table* table(uint64_t groups) {
+        auto* t = static_cast<Table*>(memory.allocate(sizeof(Table) + groups * sizeof(Group)));
+        t->mask = groups - 1;
+        return t;
+    }
+    // a full table is moved to one of twice the groups, or of as many if deleted entries take the room
+    void grow() {
+        if (h.old != nullptr) evacuate(UINT64_MAX);
+        uint64_t groups = 1;
+        if (h.table != nullptr) groups = (h.table->mask + 1) * (static_cast<uint64_t>(h.count) * 32 > h.table->slots() * 25 ? 2 : 1);
+        Table* t = table(groups);
+        h.growth = static_cast<int64_t>(groups * 14);
+        if (h.table != nullptr) {
+            h.old = h.table;
+            h.moved = 0;
+            memory.overwrite(reinterpret_cast<int64_t>(h.table));
+        }
+        h.table = t;
+    }
+    // up to n groups of old go to table, and old goes away once all did
+    void evacuate(uint64_t n) {
+        Table& from = *h.old;
+        Group* groups = from.groups();
+        for (; n != 0 && h.moved <= from.mask; n--, h.moved++) {
+            Group& group = groups[h.moved];
+            for (uint32_t m = full(group.ctrl); m != 0; m &= m - 1) {
+                const int i = __builtin_ctz(m);
+                insert(group.slots[i].key, hash(group.slots[i].key, h.seed), group.slots[i].value);
+                group.ctrl[i] = Moved;
+            }
+        }
+        if (h.moved <= from.mask) return;
+        memory.overwrite(reinterpret_cast<int64_t>(h.old));
+        memory.release(h.old, sizeof(Table) + from.slots() / 16 * sizeof(Group));
+        h.old = nullptr;
+    }
+};
+// Runtime environment of compiled programs, it interprets the bytecode of codegen(). Goroutines are
+// multiplexed onto one worker thread per core, or GOMAXPROCS of them. A worker runs goroutines from
+// its own Chase-Lev deque, falls back to the global queue and to stealing from other workers, and
+// parks when there is nothing to run. The workers besides the calling thread are only started by the
+// first go statement. A goroutine that blocks on a channel leaves the VM before it is parked, so
+// whoever completes its operation later can run it again at once. Frames are windows of the register
+// stack of a goroutine, which starts small and is moved to a larger one when a call doesn't fit, and
+// dispatch is threaded by computed goto where it's available
+struct goruntime {
+    static constexpr size_t MaxFrames = 1 << 20;
+    // stacks are powers of 2 of bytes from MinStack to MaxStack, a segment of address space holds
+    // those of one size. From GuardedStack on each is followed by a guard page, smaller ones share the
+    // one at the end of their segment
+    static constexpr size_t MinStack = 2 << 10, MaxStack = size_t{ 8 } << 20, StackClasses = 13;
+    static constexpr size_t GuardedStack = 64 << 10, SegmentBytes = 1 << 20, WorkerStacks = 16;
+    static constexpr int Slice = 1 << 12;   // calls and backward jumps a goroutine makes before it may be preempted
+    struct Frame { const Insn* code, *pc; int64_t* base; };
+    struct Chan;
+    // a goroutine, where it stopped and the frames of its callers. One that didn't run yet has no pc
+    // and holds the arguments of fn, it only gets a stack when it first runs. Main's is a goroutine too
+    struct G {
+        const Insn* code{}, *pc{};
+        int64_t* r{}, *stack{}, *limit{};
+        vector<Frame> frames;
+        const Function* fn{};
+        vector<int64_t> args;
+        string out;                         // the line being printed, it moves with the goroutine
+        G* next{};                          // in the global queue or a free list
+        // of the waiters it left while parked, 0 once one of them was claimed or it runs
+        atomic<uint64_t> ticket{ 0 };
+        uint64_t tickets{};
+        int64_t received{};                 // by the last select
+        vector<Chan*> selecting;            // channels a parked select waits on
+        bool live{};                        // spawned and not finished, its stack and arguments are roots
+    };
+    class SpinLock {
+        atomic<bool> held{ false };
+    public:
+        void lock() {
+            for (int spins = 0; held.exchange(true, memory_order_acquire);)
+                while (held.load(memory_order_relaxed)) if (++spins > 64) this_thread::yield();
+        }
+        void unlock() { held.store(false, memory_order_release); }
+    };
+    // a parked goroutine in a queue of a channel, with what it sends and the select case it stands for
+    struct Waiter {
+        G* g;
+        uint64_t ticket;
+        uint32_t index;
+        int64_t value;
+    };
+    // A buffered channel is Vyukov's bounded queue: senders and receivers claim a position and the
+    // sequence of its slot tells whether it's free for that turn, 2 * position, or holds its value,
+    // 2 * position + 1, so neither takes the lock while no one waits. Goroutines that wait and the handoff of unbuffered channels go
+    // through the lock. Whoever waits counts itself in sending or receiving and then tries the queue
+    // again, whoever went through the queue looks at the count after it; one of both sees the other
+    struct Chan {
+        struct Slot { atomic<uint64_t> seq; int64_t value; };
+        const uint64_t size;
+        unique_ptr<Slot[]> slots;
+        alignas(64) atomic<uint64_t> head{ 0 };
+        alignas(64) atomic<uint64_t> tail{ 0 };
+        alignas(64) SpinLock lock;
+        deque<Waiter> senders, receivers;
+        atomic<size_t> sending{ 0 }, receiving{ 0 };   // waiters, some of which may be stale
+        atomic<bool> closed{ false };
+
+        explicit Chan(uint64_t size) :size(size), slots(size != 0 ? new Slot[size] : nullptr) {
+            for (uint64_t i = 0; i < size; i++) slots[i].seq.store(2 * i, memory_order_relaxed);
+        }
+        bool push(int64_t v) {
+            if (size == 0) return false;
+            for (uint64_t pos = tail.load(memory_order_relaxed);;) {
+                Slot& slot = slots[pos % size];
+                const auto turn = static_cast<int64_t>(slot.seq.load(memory_order_acquire) - 2 * pos);
+                if (turn < 0) return false;
+                if (turn > 0) pos = tail.load(memory_order_relaxed);
+                else if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    slot.value = v;
+                    slot.seq.store(2 * pos + 1, memory_order_release);
+                    return true;
+                }
+            }
+        }
+        bool pop(int64_t& v) {
+            if (size == 0) return false;
+            for (uint64_t pos = head.load(memory_order_relaxed);;) {
+                Slot& slot = slots[pos % size];
+                const auto turn = static_cast<int64_t>(slot.seq.load(memory_order_acquire) - (2 * pos + 1));
+                if (turn < 0) return false;
+                if (turn > 0) pos = head.load(memory_order_relaxed);
+                else if (head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    v = slot.value;
+                    slot.seq.store(2 * (pos + size), memory_order_release);
+                    return true;
+                }
+            }
+        }
+    };
+    // Chase-Lev deque of runnable goroutines. Its owner pushes and pops at the bottom without atomic
+    // read-modify-writes unless one goroutine is left, thieves take from the top. A full ring is copied
+    // to one of twice the size, and the old one stays valid for thieves that still read it
+    class Deque {
+        struct Ring {
+            const int64_t mask;
+            unique_ptr<atomic<G*>[]> slots;
+            explicit Ring(int64_t size) :mask(size - 1), slots(new atomic<G*>[size]) {}
+            G* get(int64_t i) const { return slots[i & mask].load(memory_order_relaxed); }
+            void put(int64_t i, G* g) { slots[i & mask].store(g, memory_order_relaxed); }
+        };
+        alignas(64) atomic<int64_t> top{ 0 };
+        alignas(64) atomic<int64_t> bottom{ 0 };
+        atomic<Ring*> ring;
+        vector<unique_ptr<Ring>> rings;     // the current ring is last
+    public:
+        Deque() { rings.push_back(make_unique<Ring>(256)); ring = rings.back().get(); }
+        void push(G* g) {
+            const int64_t b = bottom.load(memory_order_relaxed), t = top.load(memory_order_acquire);
+            Ring* a = ring.load(memory_order_relaxed);
+            if (b - t > a->mask) {
+                rings.push_back(make_unique<Ring>(2 * (a->mask + 1)));
+                for (int64_t i = t; i < b; i++) rings.back()->put(i, a->get(i));
+                a = rings.back().get();
+                ring.store(a, memory_order_release);
+            }
+            a->put(b, g);
+            bottom.store(b + 1, memory_order_release);
+        }
+        G* pop() {
+            const int64_t b = bottom.load(memory_order_relaxed) - 1;
+            Ring* a = ring.load(memory_order_relaxed);
+            bottom.store(b, memory_order_relaxed);
+            atomic_thread_fence(memory_order_seq_cst);
+            int64_t t = top.load(memory_order_relaxed);
+            if (t > b) {
+                bottom.store(b + 1, memory_order_relaxed);
+                return nullptr;
+            }
+            G* g = a->get(b);
+            if (t == b) {   // the last one, a thief may take it first
+                if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) g = nullptr;
+                bottom.store(b + 1, memory_order_relaxed);
+            }
+            return g;
+        }
+        G* steal() {
+            int64_t t = top.load(memory_order_acquire);
+            atomic_thread_fence(memory_order_seq_cst);
+            const int64_t b = bottom.load(memory_order_acquire);
+            if (t >= b) return nullptr;
+            G* g = ring.load(memory_order_acquire)->get(t);
+            return top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed) ? g : nullptr;
+        }
+        bool empty() const { return bottom.load(memory_order_acquire) <= top.load(memory_order_acquire); }
+    };
+    // Size classes of the heap are those of Go's runtime, see sizeclasses.go in test/parser/official:
+    // the bytes of an object and the pages of a span of them. Class 0 stands for large objects, each
+    // of which is alone in its span
+    static constexpr uint16_t ClassSize[] = { 0, 8, 16, 32, 48, 64, 80, 96, 112, 128, 144, 160, 176, 192, 208, 224,
+        240, 256, 288, 320, 352, 384, 416, 448, 480, 512, 576, 640, 704, 768, 896, 1024, 1152, 1280, 1408, 1536, 1792,
+        2048, 2304, 2688, 3072, 3200, 3456, 4096, 4864, 5376, 6144, 6528, 6784, 6912, 8192, 9472, 9728, 10240, 10880,
+        12288, 13568, 14336, 16384, 18432, 19072, 20480, 21760, 24576, 27264, 28672, 32768 };
+    static constexpr uint8_t ClassPages[] = { 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 2, 1, 2, 1, 3, 2, 3, 1, 3, 2, 3, 4, 5, 6, 1, 7, 6, 5, 4, 3, 5, 7, 2, 9, 7,
+        5, 8, 3, 10, 7, 4 };
+    static constexpr size_t Classes = size(ClassSize), MaxSmall = 32768, PageShift = 13, PageSize = size_t{ 1 } << PageShift;
+    static constexpr size_t ArenaBytes = size_t{ 1 } << 34, CommitBytes = size_t{ 64 } << 20, MinHeap = size_t{ 4 } << 20;
+    // the class of a small object by its size rounded up to 8 bytes, or to 128 above 1024
+    static constexpr auto ClassBy8 = [] {
+        array<uint8_t, 1024 / 8 + 1> by{};
+        for (size_t i = 0, c = 0; i < by.size(); by[i++] = static_cast<uint8_t>(c)) while (ClassSize[c] < i * 8) c++;
+        return by;
+    }();
+    static constexpr auto ClassBy128 = [] {
+        array<uint8_t, (MaxSmall - 1024) / 128 + 1> by{};
+        for (size_t i = 0, c = 0; i < by.size(); by[i++] = static_cast<uint8_t>(c)) while (ClassSize[c] < 1024 + i * 128) c++;
+        return by;
+    }();
+    // pages of the heap with objects of one class, or with one large object. Bitmaps tell which
+    // objects are allocated and which the collector marked, free ones are taken in address order
+    struct Span {
+        char* start{};
+        size_t pages{}, size{}, count{};    // size of an object and how many there are
+        size_t next{};                      // objects before it were taken since the last sweep
+        size_t live{};                      // allocated objects when the span was swept or handed back
+        bool zeroed{};                      // the pages were never used, objects need no clearing
+        size_t words{}, capacity{};         // of the bitmaps
+        unique_ptr<atomic<uint64_t>[]> allocated, marks;
+    };
+    // spans of a class that no worker caches: those with free objects, full ones, and the ones the
+    // collector has yet to sweep
+    struct Central {
+        mutex lock;
+        vector<Span*> partial, full, unswept;
+    };
+    // An arena of address space reserved at once and committed as spans need it, with the span of
+    // each page. Freed runs of pages are merged with their neighbors, or given back to the end
+    struct Heap {
+        char* arena{};
+        atomic<Span*>* spans{};
+        atomic<size_t> used{ 0 };           // bytes of the arena up to the last span
+        size_t committed{}, touched{};      // pages past touched were never used since the arena was mapped
+        mutex lock;
+        map<char*, size_t> free;            // runs of pages below used, by address
+        deque<Span> store;
+        vector<Span*> unused;
+        vector<Span*> large, unswept;       // spans of large objects
+        array<Central, Classes> central;
+    };
+    // stacks no goroutine uses, by size, and the rest of the segment each size is carved from
+    struct StackPool {
+        mutex lock;
+        array<vector<int64_t*>, StackClasses> free;
+        array<char*, StackClasses> next{};
+        array<size_t, StackClasses> left{};
+        size_t page{};
+    };
+    enum class Phase { Off, Mark, Sweep };
+    // an OS thread and the goroutines it holds
+    struct alignas(64) Worker {
+        Deque runq;
+        G* free{};                          // finished goroutines
+        size_t frees{};
+        array<vector<int64_t*>, StackClasses> stacks;   // free ones of each size, up to WorkerStacks
+        deque<G> owned;                     // every goroutine this worker allocated
+        deque<Chan> chans;                  // every channel made here
+        vector<pair<Chan*, uint32_t>> cases;    // of the select being run, in the order they are tried
+        vector<Chan*> locked;
+        array<Span*, Classes> cache{};      // small objects are allocated from these without locks
+        vector<int64_t*> grey;              // objects the write barrier shaded
+        size_t steps{}, switches{}, spawns{}, ticks{};
+        uint64_t seed{};
+        bool spinning{};                    // looking for work to steal
+        thread th;
+    };
+    enum class Exit { Done, Yield, Preempt, Block };
+
+    int procs = 0;                          // workers, 0 takes GOMAXPROCS or the number of cores
+    size_t steps = 0, switches = 0, spawns = 0;     // instructions run<true>() executed, goroutines resumed and started
+    const Program* program{};
+    vector<unique_ptr<Worker>> workers;
+    G root;                                 // runs the entry function
+    int64_t result{};
+    bool threaded{};                        // the other workers are started
+    atomic<bool> exited{ false };
+    mutex lock;                             // of the global queue and of parking
+    condition_variable parked;
+    G* head{}, *tail{};
+    atomic<size_t> queued{ 0 };
+    atomic<int> idle{ 0 }, spinning{ 0 };
+    int wakeups{};                          // parked workers told to look for work
+    mutex pool;
+    G* spare{};                             // finished goroutines workers with many of them handed over
+    atomic<size_t> spares{ 0 };
+    StackPool stackPool;
+    // the heap and its collector, which runs on a thread of its own once the heap grew to its trigger
+    Heap heap;
+    atomic<Phase> phase{ Phase::Off };
+    atomic<bool> marking{ false };          // the write barrier is on and new objects are black
+    atomic<size_t> heapLive{ 0 };           // bytes allocated, or free in spans that workers cache
+    atomic<size_t> trigger{ MinHeap };
+    size_t goal = MinHeap;
+    double ratio = 0.7;                     // of the way from the marked heap to the goal where the next cycle starts
+    int gogc = 100, gctrace = 0;            // GOGC, -1 if it's off, and gctrace of GODEBUG
+    mutex greyLock;
+    vector<int64_t*> grey;                  // objects marked whose slots are not scanned yet
+    thread collector;
+    mutex gcLock;
+    condition_variable gcWake;
+    bool gcWanted{}, gcQuit{};
+    atomic<bool> stopping{ false };         // the collector stops the world, workers wait at safepoints
+    int stopped{};
+    condition_variable world;
+    vector<pair<const Insn*, uint16_t>> extents;   // registers of a frame by the code of its function
+    chrono::steady_clock::time_point started;
+    struct GcStats {
+        size_t cycles{};
+        atomic<size_t> allocated{ 0 }, peak{ 0 };  // bytes allocated and the largest heap
+        chrono::nanoseconds pause{}, maxPause{};
+    } gc;
+    static inline mutex output;
+    static inline thread_local G* running = nullptr;
+    static inline thread_local Worker* self = nullptr;
+
+    [[noreturn]] static void panic(const string& what) {
+        lock_guard<mutex> hold(output);
+        if (running != nullptr) cout << running->out;
+        cout.flush();
+        cerr << what << "\n";
+        _Exit(2);   // other workers may still run, nothing may be destroyed under them
+    }
+    // integers wrap around like Go's
+    static int64_t add(int64_t x, int64_t y) { return static_cast<int64_t>(static_cast<uint64_t>(x) + static_cast<uint64_t>(y)); }
+    static int64_t sub(int64_t x, int64_t y) { return static_cast<int64_t>(static_cast<uint64_t>(x) - static_cast<uint64_t>(y)); }
+    static int64_t mul(int64_t x, int64_t y) { return static_cast<int64_t>(static_cast<uint64_t>(x) * static_cast<uint64_t>(y)); }
+    static int64_t div(int64_t x, int64_t y) {
+        if (y == 0) panic("panic: runtime error: integer divide by zero");
+        return y == -1 ? sub(0, x) : x / y;
+    }
+    static int64_t mod(int64_t x, int64_t y) {
+        if (y == 0) panic("panic: runtime error: integer divide by zero");
+        return y == -1 ? 0 : x % y;
+    }
+    static int64_t shl(int64_t x, int64_t n) {
+        if (n < 0) panic("panic: runtime error: negative shift amount");
+        return n >= 64 ? 0 : static_cast<int64_t>(static_cast<uint64_t>(x) << n);
+    }
+    static int64_t shr(int64_t x, int64_t n) {
+        if (n < 0) panic("panic: runtime error: negative shift amount");
+        return x >> min<int64_t>(n, 63);
+    }
+    // runs funcs[entry] without arguments as the main goroutine and returns its result once it returns,
+    // goroutines that are left are dropped. Count makes it count steps
+    template<bool Count = false> int64_t run(const Program& program, int entry) {
+        const char* env = getenv("GOMAXPROCS");
+        const int n = procs > 0 ? procs : env != nullptr && atoi(env) > 0 ? atoi(env) : max(1, static_cast<int>(thread::hardware_concurrency()));
+        workers.resize(n);
+        for (int i = 0; i < n; i++) {
+            if (workers[i] == nullptr) workers[i] = make_unique<Worker>();
+            workers[i]->seed = 0x9E3779B97F4A7C15ull * (i + 1);
+        }
+        this->program = &program;
+        threaded = false;
+        exited = false;
+        const char* percent = getenv("GOGC");
+        gogc = percent == nullptr ? 100 : string_view(percent) == "off" ? -1 : max(atoi(percent), 1);
+        const char* debug = getenv("GODEBUG");
+        const char* trace = debug != nullptr ? strstr(debug, "gctrace=") : nullptr;
+        gctrace = trace != nullptr && (trace == debug || trace[-1] == ',') ? atoi(trace + 8) : 0;
+        extents.clear();
+        for (auto& f : program.funcs) extents.emplace_back(f.code.data(), f.registers);
+        sort(extents.begin(), extents.end());
+        started = chrono::steady_clock::now();
+        root.fn = &program.funcs[entry];
+        root.args.clear();
+        root.pc = nullptr;
+        root.selecting.clear();
+        root.ticket = 0;
+        workers[0]->runq.push(&root);
+        schedule<Count>(*workers[0]);
+        for (auto& w : workers) if (w->th.joinable()) w->th.join();
+        if (collector.joinable()) {
+            {
+                lock_guard<mutex> hold(gcLock);
+                gcQuit = true;
+            }
+            gcWake.notify_one();
+            collector.join();
+            gcWanted = gcQuit = false;
+        }
+        // the workers are gone, what they left behind is dropped. Stacks go back to the pool
+        flush(root);
+        freeStack(nullptr, root);
+        freeHeap();
+        for (auto& w : workers) {
+            for (auto& g : w->owned) flush(g), freeStack(nullptr, g);
+            idleStacks(*w);
+            while (w->runq.pop() != nullptr) {}
+            w->free = nullptr;
+            w->frees = 0;
+            w->owned.clear();
+            w->chans.clear();
+            steps += w->steps; switches += w->switches; spawns += w->spawns;
+            w->steps = w->switches = w->spawns = 0;
+            w->spinning = false;
+            w->cache.fill(nullptr);
+            w->grey.clear();
+        }
+        scavenge();
+        head = tail = spare = nullptr;
+        queued = spares = 0;
+        idle = spinning = 0;
+        wakeups = 0;
+        return result;
+    }
+#pragma region Scheduler
+    template<bool Count> void schedule(Worker& w) {
+        self = &w;
+        while (G* g = find(w)) {
+            w.switches++;
+            if (g->pc == nullptr) start(w, *g);
+            if (!g->selecting.empty()) withdraw(*g);
+            int64_t value = 0;
+            running = g;
+            const Exit exit = execute<Count>(*g, w, value);
+            running = nullptr;
+            switch (exit) {
+            case Exit::Done:
+                flush(*g);
+                if (g != &root) release(w, g);
+                else {
+                    result = value;
+                    lock_guard<mutex> hold(lock);
+                    exited = true;
+                    parked.notify_all();
+                    world.notify_all();
+                }
+                break;
+            case Exit::Yield: case Exit::Preempt: enqueue(g); break;
+            case Exit::Block: if (block(w, *g)) w.runq.push(g); break;
+            }
+        }
+    }
+    // the next goroutine to run, or nullptr once main returned. The global queue is looked at first now
+    // and then so that busy deques don't starve it. Looking for one is a safepoint
+    G* find(Worker& w) {
+        for (;;) {
+            if (stopping.load(memory_order_relaxed)) safepoint();
+            if (exited.load(memory_order_acquire)) return nullptr;
+            G* g = nullptr;
+            if (++w.ticks % 61 == 0) g = dequeue();
+            if (g == nullptr) g = w.runq.pop();
+            if (g == nullptr) g = dequeue();
+            if (g == nullptr && threaded) g = steal(w);
+            if (g != nullptr) return g;
+            park(w);
+        }
+    }
+    G* steal(Worker& w) {
+        if (!w.spinning) {
+            w.spinning = true;
+            spinning++;
+        }
+        for (int round = 0; round < 4; round++) {
+            w.seed ^= w.seed << 13; w.seed ^= w.seed >> 7; w.seed ^= w.seed << 17;
+            for (size_t i = 0, from = w.seed % workers.size(); i < workers.size(); i++) {
+                Worker& victim = *workers[(from + i) % workers.size()];
+                G* g = &victim != &w ? victim.runq.steal() : nullptr;
+                if (g == nullptr && (g = dequeue()) == nullptr) continue;
+                // the last spinning worker that found work wakes another one, in case there is more
+                w.spinning = false;
+                if (--spinning == 0) wake();
+                return g;
+            }
+        }
+        return nullptr;
+    }
+    // sleeps until there may be work, a worker that is still spinning stops. Whoever makes work
+    // runnable looks at idle after a fence, and the work is looked for again after idle went up
+    void park(Worker& w) {
+        idleStacks(w);
+        unique_lock<mutex> hold(lock);
+        if (w.spinning) {
+            w.spinning = false;
+            spinning--;
+        }
+        idle++;
+        if (stopping.load(memory_order_relaxed)) world.notify_all();
+        atomic_thread_fence(memory_order_seq_cst);
+        bool work = queued.load(memory_order_relaxed) != 0;
+        for (auto& other : workers) work = work || !other->runq.empty();
+        if (!work && !exited.load(memory_order_relaxed)) {
+            if (idle.load(memory_order_relaxed) == (threaded ? static_cast<int>(workers.size()) : 1))
+                panic("fatal error: all goroutines are asleep - deadlock!");
+            parked.wait(hold);
+            if (wakeups > 0) {
+                wakeups--;
+                w.spinning = true;      // spinning was counted by wake()
+            }
+        }
+        idle--;
+    }
+    // gets a parked worker up for work just made runnable, unless one is spinning already
+    void wake() {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (idle.load(memory_order_relaxed) == 0 || spinning.load(memory_order_relaxed) != 0) return;
+        int none = 0;
+        if (!spinning.compare_exchange_strong(none, 1)) return;
+        lock_guard<mutex> hold(lock);
+        if (idle.load(memory_order_relaxed) == 0) {
+            spinning--;
+            return;
+        }
+        wakeups++;
+        parked.notify_one();
+    }
+    void enqueue(G* g) {
+        {
+            lock_guard<mutex> hold(lock);
+            g->next = nullptr;
+            (tail != nullptr ? tail->next : head) = g;
+            tail = g;
+            queued++;
+        }
+        wake();
+    }
+    G* dequeue() {
+        if (queued.load(memory_order_relaxed) == 0) return nullptr;
+        lock_guard<mutex> hold(lock);
+        G* g = head;
+        if (g == nullptr) return nullptr;
+        head = g->next;
+        if (head == nullptr) tail = nullptr;
+        queued--;
+        return g;
+    }
+    // go fn(args...), the goroutine is pushed to the deque of the worker and may be stolen from there
+    template<bool Count> void spawn(Worker& w, const Function& fn, const int64_t* args) {
+        G* g = acquire(w);
+        g->fn = &fn;
+        g->args.assign(args, args + fn.params);
+        g->pc = nullptr;
+        g->live = true;
+        w.spawns++;
+        w.runq.push(g);
+        if (threaded) return wake();
+        threaded = true;
+        for (size_t i = 1; i < workers.size(); i++) workers[i]->th = thread([this, i] { schedule<Count>(*workers[i]); });
+    }
+    // finished goroutines are reused, a worker that holds many of them hands half over to the others.
+    // Stacks stay with the worker, which starts the goroutines it takes
+    G* acquire(Worker& w) {
+        if (w.free == nullptr && spares.load(memory_order_relaxed) != 0) {
+            lock_guard<mutex> hold(pool);
+            for (; spare != nullptr && w.frees < 32; w.frees++) {
+                G* g = spare;
+                spare = g->next;
+                g->next = w.free;
+                w.free = g;
+                spares--;
+            }
+        }
+        if (G* g = w.free) {
+            w.free = g->next;
+            w.frees--;
+            return g;
+        }
+        return &w.owned.emplace_back();
+    }
+    // the first stack is the smallest that holds the frame of fn
+    void start(Worker& w, G& g) {
+        const size_t cls = stackClass(g.fn->registers);
+        if (cls >= StackClasses) panic("fatal error: stack overflow");
+        g.stack = newStack(&w, cls);
+        g.limit = g.stack + (MinStack / 8 << cls);
+        copy(g.args.begin(), g.args.end(), g.stack);
+        g.code = g.pc = g.fn->code.data();
+        g.r = g.stack;
+        g.frames.clear();
+    }
+    void release(Worker& w, G* g) {
+        freeStack(&w, *g);
+        g->live = false;
+        g->next = w.free;
+        w.free = g;
+        if (++w.frees < 64) return;
+        lock_guard<mutex> hold(pool);
+        for (; w.frees > 32; w.frees--) {
+            G* f = w.free;
+            w.free = f->next;
+            f->next = spare;
+            spare = f;
+            spares++;
+        }
+    }
+#pragma region Channel
+    static Chan* chan(int64_t handle) { return reinterpret_cast<Chan*>(handle); }
+    // a goroutine woken from a channel runs next on the worker that woke it
+    void ready(G* g) {
+        self->runq.push(g);
+        wake();
+    }
+    // a parked goroutine whose operation the caller carried out goes on after it, a receive or a
+    // select takes its results
+    void finish(const Waiter& w, int64_t value) {
+        G& g = *w.g;
+        if (g.pc->op == Op::Recv) g.r[g.pc->a] = value;
+        else if (g.pc->op == Op::Select) {
+            g.r[g.pc->a] = w.index;
+            g.received = value;
+        }
+        g.pc++;
+        ready(&g);
+    }
+    // the first waiter of a queue no one else claimed yet. Waiters of a select that went on are stale
+    static optional<Waiter> claim(deque<Waiter>& queue, atomic<size_t>& count) {
+        while (!queue.empty()) {
+            Waiter w = queue.front();
+            queue.pop_front();
+            count--;
+            uint64_t ticket = w.ticket;
+            if (w.g->ticket.compare_exchange_strong(ticket, 0)) return w;
+        }
+        return nullopt;
+    }
+    // under the lock of c: gives v to a waiting receiver or the buffer, false if neither takes it.
+    // Values already buffered go to receivers first
+    bool sendLocked(Chan& c, int64_t v) {
+        if (c.closed.load(memory_order_relaxed)) panic("panic: send on closed channel");
+        while (auto w = claim(c.receivers, c.receiving)) {
+            int64_t x;
+            if (!c.pop(x)) {
+                finish(*w, v);
+                return true;
+            }
+            finish(*w, x);
+        }
+        return c.push(v);
+    }
+    // under the lock of c: takes v from the buffer or a waiting sender, or 0 once c is closed
+    bool recvLocked(Chan& c, int64_t& v) {
+        if (c.pop(v)) {
+            refill(c);
+            return true;
+        }
+        if (auto w = claim(c.senders, c.sending)) {
+            v = w->value;
+            finish(*w, 0);
+            return true;
+        }
+        if (!c.closed.load(memory_order_relaxed)) return false;
+        v = 0;
+        return true;
+    }
+    // a slot of c was freed, a waiting sender fills it or tries again
+    void refill(Chan& c) {
+        if (auto w = claim(c.senders, c.sending)) {
+            if (c.push(w->value)) finish(*w, 0);
+            else ready(w->g);
+        }
+    }
+    // a value was buffered, a waiting receiver takes it or tries again
+    void drain(Chan& c) {
+        if (auto w = claim(c.receivers, c.receiving)) {
+            int64_t x;
+            if (c.pop(x)) finish(*w, x);
+            else ready(w->g);
+        }
+    }
+    bool send(Chan& c, int64_t v) {
+        if (c.receiving.load(memory_order_relaxed) == 0 && !c.closed.load(memory_order_relaxed) && c.push(v)) {
+            atomic_thread_fence(memory_order_seq_cst);
+            if (c.receiving.load(memory_order_relaxed) != 0) {
+                lock_guard<SpinLock> hold(c.lock);
+                drain(c);
+            }
+            return true;
+        }
+        lock_guard<SpinLock> hold(c.lock);
+        return sendLocked(c, v);
+    }
+    bool receive(Chan& c, int64_t& v) {
+        if (c.pop(v)) {
+            atomic_thread_fence(memory_order_seq_cst);
+            if (c.sending.load(memory_order_relaxed) != 0) {
+                lock_guard<SpinLock> hold(c.lock);
+                refill(c);
+            }
+            return true;
+        }
+        lock_guard<SpinLock> hold(c.lock);
+        return recvLocked(c, v);
+    }
+    void close(Chan* c) {
+        if (c == nullptr) panic("panic: close of nil channel");
+        lock_guard<SpinLock> hold(c->lock);
+        if (c->closed.load(memory_order_relaxed)) panic("panic: close of closed channel");
+        c->closed.store(true, memory_order_release);
+        while (auto w = claim(c->receivers, c->receiving)) finish(*w, 0);
+        while (auto w = claim(c->senders, c->sending)) ready(w->g);     // to panic
+    }
+    // the case of a select that can go on now, or what default stands for, or -1
+    int64_t select(Worker& w, G& g, const SelectCases& cases, const int64_t* ops) {
+        prepare(w, cases, ops);
+        const int64_t chosen = trySelect(w, g, cases, ops);
+        unlockAll(w);
+        return chosen < 0 && cases.fallback ? static_cast<int64_t>(cases.sends.size()) : chosen;
+    }
+    // puts the cases of a select on non-nil channels in a random order, and locks their channels in
+    // the order of their addresses
+    static void prepare(Worker& w, const SelectCases& cases, const int64_t* ops) {
+        auto& order = w.cases;
+        order.clear();
+        for (uint32_t i = 0, k = 0; i < cases.sends.size(); k += cases.sends[i] ? 2 : 1, i++)
+            if (ops[k] != 0) order.emplace_back(chan(ops[k]), k);
+        for (size_t i = order.size(); i > 1; i--) {
+            w.seed ^= w.seed << 13; w.seed ^= w.seed >> 7; w.seed ^= w.seed << 17;
+            swap(order[i - 1], order[w.seed % i]);
+        }
+        lockAll(w);
+    }
+    int64_t trySelect(Worker& w, G& g, const SelectCases& cases, const int64_t* ops) {
+        for (auto[c, k] : w.cases) {
+            const uint32_t index = caseOf(cases, k);
+            if (cases.sends[index] ? sendLocked(*c, ops[k + 1]) : recvLocked(*c, g.received)) return index;
+        }
+        return -1;
+    }
+    static uint32_t caseOf(const SelectCases& cases, uint32_t k) {
+        uint32_t i = 0;
+        for (uint32_t at = 0; at < k; at += cases.sends[i] ? 2 : 1) i++;
+        return i;
+    }
+    static void lockAll(Worker& w) {
+        w.locked.clear();
+        for (auto& c : w.cases) w.locked.push_back(c.first);
+        sort(w.locked.begin(), w.locked.end());
+        w.locked.erase(unique(w.locked.begin(), w.locked.end()), w.locked.end());
+        for (auto* c : w.locked) c->lock.lock();
+    }
+    static void unlockAll(Worker& w) { for (auto i = w.locked.rbegin(); i != w.locked.rend(); ++i) (*i)->lock.unlock(); }
+    // g left the VM at a channel operation that could not go on. It tries once more under the locks
+    // and waits in the queues of the channels, or it's done and goes on. Nil channels block forever
+    bool block(Worker& w, G& g) {
+        const Insn& i = *g.pc;
+        const uint64_t ticket = ++g.tickets;
+        if (i.op == Op::Select) {
+            const SelectCases& cases = program->selects[i.b];
+            const int64_t* ops = g.r + i.c;
+            prepare(w, cases, ops);
+            int64_t chosen = trySelect(w, g, cases, ops);
+            if (chosen < 0) {
+                g.ticket = ticket;
+                for (auto[c, k] : w.cases) {
+                    const uint32_t index = caseOf(cases, k);
+                    if (cases.sends[index]) c->senders.push_back({ &g, ticket, index, ops[k + 1] });
+                    else c->receivers.push_back({ &g, ticket, index, 0 });
+                    (cases.sends[index] ? c->sending : c->receiving)++;
+                }
+                atomic_thread_fence(memory_order_seq_cst);
+                for (auto[c, k] : w.cases) {
+                    const uint32_t index = caseOf(cases, k);
+                    if (!(cases.sends[index] ? c->push(ops[k + 1]) : c->pop(g.received))) continue;
+                    g.ticket = 0;
+                    for (auto* locked : w.locked) withdraw(g, *locked);
+                    if (cases.sends[index]) drain(*c);
+                    else refill(*c);
+                    chosen = index;
+                    break;
+                }
+                if (chosen < 0) g.selecting = w.locked;
+            }
+            unlockAll(w);
+            if (chosen < 0) return false;
+            g.r[i.a] = chosen;
+            g.pc++;
+            return true;
+        }
+        Chan* c = i.op == Op::Send ? chan(g.r[i.a]) : chan(g.r[i.b]);
+        if (c == nullptr) return false;
+        lock_guard<SpinLock> hold(c->lock);
+        const bool sends = i.op == Op::Send;
+        const int64_t v = sends ? g.r[i.b] : 0;
+        int64_t x = 0;
+        if (sends ? sendLocked(*c, v) : recvLocked(*c, x)) {
+            if (!sends) g.r[i.a] = x;
+            g.pc++;
+            return true;
+        }
+        g.ticket = ticket;
+        (sends ? c->senders : c->receivers).push_back({ &g, ticket, 0, v });
+        (sends ? c->sending : c->receiving)++;
+        atomic_thread_fence(memory_order_seq_cst);
+        if (sends ? !c->push(v) : !c->pop(x)) return false;
+        g.ticket = 0;
+        withdraw(g, *c);
+        if (sends) drain(*c);
+        else {
+            g.r[i.a] = x;
+            refill(*c);
+        }
+        g.pc++;
+        return true;
+    }
+    // drops the waiters of g from c, whose lock is held
+    static void withdraw(G& g, Chan& c) {
+        for (auto* queue : { &c.senders, &c.receivers }) {
+            const auto stale = remove_if(queue->begin(), queue->end(), [&](const Waiter& w) { return w.g == &g; });
+            (queue == &c.senders ? c.sending : c.receiving) -= queue->end() - stale;
+            queue->erase(stale, queue->end());
+        }
+    }
+    // a select that was woken drops the waiters it left in the other channels
+    static void withdraw(G& g) {
+        for (auto* c : g.selecting) {
+            lock_guard<SpinLock> hold(c->lock);
+            withdraw(g, *c);
+        }
+        g.selecting.clear();
+    }
+#pragma endregion
+#pragma region Stack
+    // Stacks are carved from segments that are mapped once and never unmapped. A free stack stays with
+    // the worker up to WorkerStacks of its size, the others are pooled for every worker. The collector
+    // halves stacks that are used a quarter or less and gives the pages of pooled ones back to the OS
+    static size_t stackClass(size_t slots) {
+        size_t cls = 0;
+        while ((MinStack / 8 << cls) < slots && cls < StackClasses) cls++;
+        return cls;
+    }
+    int64_t* newStack(Worker* w, size_t cls) {
+        if (w != nullptr && !w->stacks[cls].empty()) {
+            int64_t* s = w->stacks[cls].back();
+            w->stacks[cls].pop_back();
+            return s;
+        }
+        StackPool& pool = stackPool;
+        lock_guard<mutex> hold(pool.lock);
+        if (!pool.free[cls].empty()) {
+            int64_t* s = pool.free[cls].back();
+            pool.free[cls].pop_back();
+            return s;
+        }
+        if (pool.page == 0) {
+#ifdef _WIN32
+            pool.page = 4096;
+#else
+            pool.page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+        }
+        const size_t bytes = MinStack << cls, guarded = bytes >= GuardedStack, stride = bytes + guarded * pool.page;
+        if (pool.left[cls] == 0) {
+            const size_t count = max<size_t>(1, SegmentBytes / stride);
+            char* segment = reserve(count * stride + !guarded * pool.page);
+            bool committed = segment != nullptr;
+            if (guarded) for (size_t i = 0; i < count && committed; i++) committed = commit(segment + i * stride, bytes);
+            else committed = committed && commit(segment, count * stride);
+            if (!committed) panic("fatal error: out of memory allocating a stack");
+            pool.next[cls] = segment;
+            pool.left[cls] = count;
+        }
+        auto* s = reinterpret_cast<int64_t*>(pool.next[cls]);
+        pool.next[cls] += stride;
+        pool.left[cls]--;
+        return s;
+    }
+    void freeStack(Worker* w, int64_t* s, size_t cls) {
+        if (w != nullptr && w->stacks[cls].size() < WorkerStacks) return w->stacks[cls].push_back(s);
+        lock_guard<mutex> hold(stackPool.lock);
+        stackPool.free[cls].push_back(s);
+    }
+    void freeStack(Worker* w, G& g) {
+        if (g.stack == nullptr) return;
+        freeStack(w, g.stack, stackClass(g.limit - g.stack));
+        g.stack = g.limit = g.r = nullptr;
+    }
+    // a worker that runs out of goroutines hands its stacks over
+    void idleStacks(Worker& w) {
+        if (all_of(w.stacks.begin(), w.stacks.end(), [](auto& free) { return free.empty(); })) return;
+        lock_guard<mutex> hold(stackPool.lock);
+        for (size_t cls = 0; cls < StackClasses; cls++) {
+            stackPool.free[cls].insert(stackPool.free[cls].end(), w.stacks[cls].begin(), w.stacks[cls].end());
+            w.stacks[cls].clear();
+        }
+    }
+    // g goes on with a stack of class cls, the slots it uses are copied and its frames point into it
+    void moveStack(Worker* w, G& g, size_t cls, size_t used) {
+        int64_t* to = newStack(w, cls);
+        copy(g.stack, g.stack + used, to);
+        const ptrdiff_t by = to - g.stack;
+        for (auto& f : g.frames) f.base += by;
+        g.r += by;
+        freeStack(w, g.stack, stackClass(g.limit - g.stack));
+        g.stack = to;
+        g.limit = to + (MinStack / 8 << cls);
+    }
+    // the frame at g.r needs registers it doesn't fit in, the stack doubles until it does
+    void grow(Worker& w, G& g, size_t registers) {
+        const size_t cls = stackClass(g.r + registers - g.stack);
+        if (cls >= StackClasses) panic("fatal error: stack overflow");
+        moveStack(&w, g, cls, min(g.r + registers, g.limit) - g.stack);
+    }
+    // the end of the frame g stopped in. A goroutine preempted as it called may not have checked the
+    // stack for its callee yet
+    int64_t* top(const G& g) const {
+        const auto frame = lower_bound(extents.begin(), extents.end(), make_pair(g.code, uint16_t{ 0 }));
+        return min(g.r + (frame != extents.end() && frame->first == g.code ? frame->second : 0), g.limit);
+    }
+    // while the world is stopped
+    void shrink(G& g) {
+        if (g.pc == nullptr || g.stack == nullptr) return;
+        const size_t size = g.limit - g.stack, used = top(g) - g.stack, cls = stackClass(size);
+        if (cls > 0 && used * 4 <= size) moveStack(nullptr, g, cls - 1, used);
+    }
+    // runs of free stacks in the pool give their whole pages back, the stacks stay pooled
+    void scavenge() {
+        lock_guard<mutex> hold(stackPool.lock);
+        const size_t page = stackPool.page;
+        for (size_t cls = 0; cls < StackClasses; cls++) {
+            auto& free = stackPool.free[cls];
+            const size_t bytes = MinStack << cls;
+            sort(free.begin(), free.end());
+            for (size_t i = 0, j; i < free.size(); i = j) {
+                for (j = i + 1; j < free.size() && reinterpret_cast<char*>(free[j]) == reinterpret_cast<char*>(free[j - 1]) + bytes;) j++;
+                const auto begin = (reinterpret_cast<uintptr_t>(free[i]) + page - 1) / page * page,
+                    end = (reinterpret_cast<uintptr_t>(free[j - 1]) + bytes) / page * page;
+                if (begin < end) discard(reinterpret_cast<char*>(begin), end - begin);
+            }
+        }
+    }
+#pragma endregion
+#pragma region Heap
+    // address space of the arena is reserved at once and committed as the heap grows
+    static char* reserve(size_t bytes) {
+#ifdef _WIN32
+        return static_cast<char*>(VirtualAlloc(nullptr, bytes, 0x2000 /* MEM_RESERVE */, 0x01 /* PAGE_NOACCESS */));
+#else
+        void* p = mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        return p != MAP_FAILED ? static_cast<char*>(p) : nullptr;
+#endif
+    }
+    static bool commit(char* p, size_t bytes) {
+#ifdef _WIN32
+        return VirtualAlloc(p, bytes, 0x1000 /* MEM_COMMIT */, 0x04 /* PAGE_READWRITE */) != nullptr;
+#else
+        return mprotect(p, bytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+    }
+    // the pages stay committed, what they hold may be dropped
+    static void discard(char* p, size_t bytes) {
+#ifdef _WIN32
+        VirtualAlloc(p, bytes, 0x80000 /* MEM_RESET */, 0x04 /* PAGE_READWRITE */);
+#else
+        madvise(p, bytes, MADV_DONTNEED);
+#endif
+    }
+    static int64_t* element(int64_t slice, int64_t i) {
+        int64_t* p = reinterpret_cast<int64_t*>(slice);
+        const int64_t n = p != nullptr ? p[0] : 0;
+        if (static_cast<uint64_t>(i) >= static_cast<uint64_t>(n))
+            panic("panic: runtime error: index out of range [" + to_string(i) + "] with length " + to_string(n));
+        return p + 1 + i;
+    }
+    // a zeroed object of at least bytes, black while the collector marks. Small objects come from
+    // the span the worker caches for their class
+    int64_t* allocate(Worker& w, size_t bytes) {
+        if (bytes > MaxSmall) return large(w, bytes);
+        const uint8_t cls = bytes <= 1024 ? ClassBy8[(bytes + 7) / 8] : ClassBy128[(bytes - 1024 + 127) / 128];
+        Span* s = w.cache[cls];
+        int64_t* p = s != nullptr ? take(*s) : nullptr;
+        return p != nullptr ? p : refill(w, cls);
+    }
+    // the next free object of s, the allocated bit is set once it's cleared for the collector to scan
+    int64_t* take(Span& s) {
+        while (s.next < s.count) {
+            const size_t word = s.next / 64;
+            const uint64_t taken = s.allocated[word].load(memory_order_relaxed), free = ~taken >> s.next % 64;
+            if (free == 0) {
+                s.next = (word + 1) * 64;
+                continue;
+            }
+            const size_t i = s.next + __builtin_ctzll(free);
+            if (i >= s.count) break;
+            s.next = i + 1;
+            char* p = s.start + i * s.size;
+            if (!s.zeroed) memset(p, 0, s.size);
+            const uint64_t bit = uint64_t{ 1 } << i % 64;
+            if (marking.load(memory_order_relaxed)) s.marks[word].fetch_or(bit, memory_order_relaxed);
+            s.allocated[word].store(taken | bit, memory_order_release);
+            return reinterpret_cast<int64_t*>(p);
+        }
+        return nullptr;
+    }
+    // the cached span of cls is full, it's handed back for one with free objects. Spans the collector
+    // didn't sweep yet are swept here
+    int64_t* refill(Worker& w, uint8_t cls) {
+        Central& c = heap.central[cls];
+        unique_lock<mutex> hold(c.lock);
+        if (Span* full = w.cache[cls]) c.full.push_back(full);
+        Span* s = nullptr;
+        while (s == nullptr && !c.partial.empty()) {
+            s = c.partial.back();
+            c.partial.pop_back();
+        }
+        while (s == nullptr && !c.unswept.empty()) {
+            Span* u = c.unswept.back();
+            c.unswept.pop_back();
+            hold.unlock();
+            const bool kept = sweep(*u);
+            hold.lock();
+            if (kept && u->live < u->count) s = u;
+            else if (kept) c.full.push_back(u);
+        }
+        hold.unlock();
+        if (s == nullptr) s = newSpan(ClassPages[cls], ClassSize[cls]);
+        w.cache[cls] = s;
+        charge(w, (s->count - s->live) * s->size);
+        return take(*s);
+    }
+    int64_t* large(Worker& w, size_t bytes) {
+        Span* s = newSpan((bytes + PageSize - 1) / PageSize, 0);
+        int64_t* p = take(*s);
+        {
+            lock_guard<mutex> hold(heap.lock);
+            heap.large.push_back(s);
+        }
+        charge(w, s->size);
+        return p;
+    }
+    // bytes were handed to w. A worker that allocates past the goal while the collector marks helps it,
+    // and one that crosses the trigger starts a cycle
+    void charge(Worker& w, size_t bytes) {
+        const size_t live = heapLive += bytes;
+        gc.allocated += bytes;
+        if (live > gc.peak.load(memory_order_relaxed)) gc.peak = live;
+        const Phase now = phase.load(memory_order_relaxed);
+        if (now == Phase::Mark && live > goal) {
+            vector<int64_t*> batch;
+            markSome(2 * bytes, batch, w.grey);
+            flushGrey(w.grey);
+        } else if (now == Phase::Off && gogc > 0 && live >= trigger.load(memory_order_relaxed)) request();
+    }
+    // a span of pages, from a freed run if one is large enough, else past the last span. Objects of
+    // size fill it, or it holds one large object
+    Span* newSpan(size_t pages, size_t size) {
+        lock_guard<mutex> hold(heap.lock);
+        const size_t bytes = pages * PageSize;
+        char* start = nullptr;
+        bool zeroed = false;
+        for (auto run = heap.free.begin(); run != heap.free.end(); ++run) {
+            if (run->second < pages) continue;
+            start = run->first;
+            if (run->second > pages) heap.free.emplace(start + bytes, run->second - pages);
+            heap.free.erase(run);
+            break;
+        }
+        if (start == nullptr) {
+            if (heap.arena == nullptr) {
+                heap.arena = reserve(ArenaBytes);
+                auto* spans = heap.arena != nullptr ? reserve(ArenaBytes / PageSize * sizeof(atomic<Span*>)) : nullptr;
+                if (spans == nullptr || !commit(spans, ArenaBytes / PageSize * sizeof(atomic<Span*>)))
+                    panic("fatal error: can not reserve the heap");
+                heap.spans = reinterpret_cast<atomic<Span*>*>(spans);
+            }
+            const size_t used = heap.used.load(memory_order_relaxed);
+            if (bytes > ArenaBytes - used) panic("fatal error: out of memory");
+            for (; heap.committed < used + bytes; heap.committed += CommitBytes)
+                if (!commit(heap.arena + heap.committed, CommitBytes)) panic("fatal error: out of memory");
+            start = heap.arena + used;
+            zeroed = used >= heap.touched;
+            heap.touched = max(heap.touched, used + bytes);
+            heap.used.store(used + bytes, memory_order_release);
+        }
+        Span* s;
+        if (heap.unused.empty()) s = &heap.store.emplace_back();
+        else {
+            s = heap.unused.back();
+            heap.unused.pop_back();
+        }
+        s->start = start;
+        s->pages = pages;
+        s->size = size != 0 ? size : bytes;
+        s->count = size != 0 ? bytes / size : 1;
+        s->next = s->live = 0;
+        s->zeroed = zeroed;
+        s->words = (s->count + 63) / 64;
+        if (s->capacity < s->words) {
+            s->capacity = s->words;
+            s->allocated.reset(new atomic<uint64_t>[s->words]);
+            s->marks.reset(new atomic<uint64_t>[s->words]);
+        }
+        for (size_t i = 0; i < s->words; i++) {
+            s->allocated[i].store(0, memory_order_relaxed);
+            s->marks[i].store(0, memory_order_relaxed);
+        }
+        const size_t first = (start - heap.arena) >> PageShift;
+        for (size_t i = 0; i < pages; i++) heap.spans[first + i].store(s, memory_order_release);
+        return s;
+    }
+    // the objects the collector didn't mark are freed, false if none is left and the span went away
+    bool sweep(Span& s) {
+        size_t live = 0;
+        for (size_t i = 0; i < s.words; i++) {
+            const uint64_t marked = s.marks[i].load(memory_order_relaxed);
+            s.allocated[i].store(marked, memory_order_relaxed);
+            s.marks[i].store(0, memory_order_relaxed);
+            live += __builtin_popcountll(marked);
+        }
+        s.live = live;
+        s.next = 0;
+        s.zeroed = false;
+        if (live != 0) return true;
+        lock_guard<mutex> hold(heap.lock);
+        const size_t first = (s.start - heap.arena) >> PageShift;
+        for (size_t i = 0; i < s.pages; i++) heap.spans[first + i].store(nullptr, memory_order_relaxed);
+        char* start = s.start;
+        size_t pages = s.pages;
+        auto next = heap.free.lower_bound(start);
+        if (next != heap.free.end() && next->first == start + pages * PageSize) {
+            pages += next->second;
+            next = heap.free.erase(next);
+        }
+        if (next != heap.free.begin() && prev(next)->first + prev(next)->second * PageSize == start) {
+            start = prev(next)->first;
+            pages += prev(next)->second;
+            heap.free.erase(prev(next));
+        }
+        if (start + pages * PageSize == heap.arena + heap.used.load(memory_order_relaxed))
+            heap.used.store(start - heap.arena, memory_order_relaxed);
+        else heap.free.emplace(start, pages);
+        heap.unused.push_back(&s);
+        return false;
+    }
+    // once the program is done, every span goes away. Pages that were used stay committed for the next run
+    void freeHeap() {
+        const size_t used = heap.used.load(memory_order_relaxed);
+        if (heap.spans != nullptr) memset(static_cast<void*>(heap.spans), 0, (used >> PageShift) * sizeof(atomic<Span*>));
+        heap.used = 0;
+        heap.free.clear();
+        heap.unused.clear();
+        for (auto& s : heap.store) heap.unused.push_back(&s);
+        heap.large.clear();
+        heap.unswept.clear();
+        for (auto& c : heap.central) c.partial.clear(), c.full.clear(), c.unswept.clear();
+        grey.clear();
+        phase = Phase::Off;
+        marking = false;
+        stopping = false;
+        heapLive = 0;
+        trigger = goal = MinHeap;
+    }
+#pragma endregion
+#pragma region Collector
+    // A cycle stops the world to shade the roots and turn the write barrier on, marks concurrently
+    // with the workers, and stops the world again to finish marking. The barrier shades the value a
+    // store overwrites, so whatever was reachable when marking started is marked (Yuasa's snapshot),
+    // and objects allocated meanwhile are black. Then the spans are swept while the workers go on.
+    // Values are untyped, any word that points into an allocated object keeps it alive
+    void request() {
+        lock_guard<mutex> hold(gcLock);
+        if (gcWanted) return;
+        gcWanted = true;
+        if (!collector.joinable()) collector = thread([this] { collect(); });
+        else gcWake.notify_one();
+    }
+    void collect() {
+        unique_lock<mutex> hold(gcLock);
+        for (;;) {
+            gcWake.wait(hold, [&] { return gcWanted || gcQuit; });
+            if (gcQuit) return;
+            hold.unlock();
+            cycle();
+            hold.lock();
+            gcWanted = false;
+        }
+    }
+    // every worker waits at a safepoint or is parked once it returns, false if main returned meanwhile
+    bool stopWorld() {
+        unique_lock<mutex> hold(lock);
+        stopping = true;
+        world.wait(hold, [&] {
+            return exited.load(memory_order_relaxed) || stopped + idle.load(memory_order_relaxed) == (threaded ? static_cast<int>(workers.size()) : 1);
+        });
+        if (!exited.load(memory_order_relaxed)) return true;
+        stopping = false;
+        world.notify_all();
+        return false;
+    }
+    void startWorld() {
+        lock_guard<mutex> hold(lock);
+        stopping = false;
+        world.notify_all();
+    }
+    void safepoint() {
+        unique_lock<mutex> hold(lock);
+        stopped++;
+        world.notify_all();
+        world.wait(hold, [&] { return !stopping.load(memory_order_relaxed) || exited.load(memory_order_relaxed); });
+        stopped--;
+    }
+    // the object v points into is marked and goes to out, unless it was already
+    void shade(int64_t v, vector<int64_t*>& out) {
+        const uint64_t at = static_cast<uint64_t>(v) - reinterpret_cast<uint64_t>(heap.arena);
+        if (at >= heap.used.load(memory_order_acquire)) return;
+        const Span* s = heap.spans[at >> PageShift].load(memory_order_acquire);
+        if (s == nullptr) return;
+        const size_t i = static_cast<size_t>(reinterpret_cast<char*>(v) - s->start) / s->size;
+        const uint64_t bit = uint64_t{ 1 } << i % 64;
+        if (i >= s->count || (s->marks[i / 64].load(memory_order_relaxed) & bit) != 0
+            || (s->allocated[i / 64].load(memory_order_acquire) & bit) == 0) return;
+        if ((s->marks[i / 64].fetch_or(bit, memory_order_relaxed) & bit) == 0) out.push_back(reinterpret_cast<int64_t*>(s->start + i * s->size));
+    }
+    // the write barrier, what the store overwrites is shaded
+    void barrier(Worker& w, int64_t old) {
+        shade(old, w.grey);
+        if (w.grey.size() >= 256) flushGrey(w.grey);
+    }
+    void flushGrey(vector<int64_t*>& from) {
+        if (from.empty()) return;
+        lock_guard<mutex> hold(greyLock);
+        grey.insert(grey.end(), from.begin(), from.end());
+        from.clear();
+    }
+    // scans grey objects until bytes of them were scanned, false once there are none
+    bool markSome(size_t bytes, vector<int64_t*>& batch, vector<int64_t*>& found) {
+        for (size_t scanned = 0; scanned < bytes;) {
+            {
+                lock_guard<mutex> hold(greyLock);
+                const size_t n = min<size_t>(grey.size(), 64);
+                batch.assign(grey.end() - n, grey.end());
+                grey.resize(grey.size() - n);
+            }
+            if (batch.empty()) return false;
+            for (int64_t* p : batch) {
+                const size_t size = heap.spans[(reinterpret_cast<char*>(p) - heap.arena) >> PageShift].load(memory_order_relaxed)->size;
+                for (size_t k = 0; k < size / 8; k++) shade(p[k], found);
+                scanned += size;
+            }
+            flushGrey(found);
+        }
+        return true;
+    }
+    void scanRoots(G& g, vector<int64_t*>& out) {
+        shade(g.received, out);
+        if (g.pc == nullptr) {
+            for (auto v : g.args) shade(v, out);
+            return;
+        }
+        // the frame of the function g stopped in is the last one on its stack
+        for (const int64_t* v = g.stack, *end = top(g); v < end; v++) shade(*v, out);
+    }
+    // the stacks of goroutines, the values of channels and of the goroutines that wait to send them
+    void markRoots(vector<int64_t*>& out) {
+        scanRoots(root, out);
+        for (auto& w : workers) {
+            for (auto& g : w->owned) if (g.live) scanRoots(g, out);
+            for (auto& c : w->chans) {
+                for (uint64_t i = 0; i < c.size; i++) shade(c.slots[i].value, out);
+                for (auto& waiter : c.senders) shade(waiter.value, out);
+            }
+        }
+    }
+    void cycle() {
+        using clock = chrono::steady_clock;
+        const auto begin = clock::now();
+        if (!stopWorld()) return;
+        const size_t before = heapLive;
+        phase = Phase::Mark;
+        marking = true;
+        shrink(root);
+        for (auto& w : workers) for (auto& g : w->owned) if (g.live) shrink(g);
+        {
+            lock_guard<mutex> hold(greyLock);
+            markRoots(grey);
+        }
+        startWorld();
+        const auto concurrent = clock::now();
+        vector<int64_t*> batch, found;
+        while (markSome(SIZE_MAX, batch, found)) if (exited.load(memory_order_relaxed)) return;
+        const auto terminate = clock::now();
+        if (!stopWorld()) return;
+        for (auto& w : workers) flushGrey(w->grey);
+        while (markSome(SIZE_MAX, batch, found)) {}
+        marking = false;
+        phase = Phase::Sweep;
+        // the cached spans are handed back, every span is swept before it's used again
+        for (auto& w : workers)
+            for (size_t cls = 1; cls < Classes; cls++) {
+                Span* s = w->cache[cls];
+                if (s == nullptr) continue;
+                size_t allocated = 0;
+                for (size_t i = 0; i < s->words; i++) allocated += __builtin_popcountll(s->allocated[i].load(memory_order_relaxed));
+                heapLive -= (s->count - allocated) * s->size;
+                gc.allocated -= (s->count - allocated) * s->size;
+                s->live = allocated;
+                heap.central[cls].full.push_back(s);
+                w->cache[cls] = nullptr;
+            }
+        const size_t end = heapLive;
+        size_t marked = 0;
+        auto count = [&](Span* s) {
+            for (size_t i = 0; i < s->words; i++) marked += __builtin_popcountll(s->marks[i].load(memory_order_relaxed)) * s->size;
+        };
+        for (auto& c : heap.central) {
+            for (auto* list : { &c.partial, &c.full }) {
+                for (Span* s : *list) count(s);
+                c.unswept.insert(c.unswept.end(), list->begin(), list->end());
+                list->clear();
+            }
+        }
+        for (Span* s : heap.large) count(s);
+        heap.unswept.swap(heap.large);
+        // the pacer: the next goal is GOGC percent over the marked heap, and the trigger moves to have
+        // the heap reach the goal when marking is done
+        const size_t lastTrigger = trigger, lastGoal = goal;
+        const double used = lastGoal > lastTrigger ? (static_cast<double>(end) - lastTrigger) / (lastGoal - lastTrigger) : 1;
+        ratio = min(0.95, max(0.5, ratio - 0.25 * (used - 1) * (1 - ratio)));
+        heapLive = marked;
+        goal = max(MinHeap, marked + marked * max(gogc, 0) / 100);
+        trigger = marked + static_cast<size_t>((goal - marked) * ratio);
+        startWorld();
+        const auto swept = clock::now();
+        scavenge();
+        for (auto& c : heap.central) {
+            unique_lock<mutex> hold(c.lock);
+            while (!c.unswept.empty() && !exited.load(memory_order_relaxed)) {
+                Span* s = c.unswept.back();
+                c.unswept.pop_back();
+                hold.unlock();
+                const bool kept = sweep(*s);
+                hold.lock();
+                if (kept) (s->live < s->count ? c.partial : c.full).push_back(s);
+            }
+        }
+        for (unique_lock<mutex> hold(heap.lock); !heap.unswept.empty() && !exited.load(memory_order_relaxed);) {
+            Span* s = heap.unswept.back();
+            heap.unswept.pop_back();
+            hold.unlock();
+            const bool kept = sweep(*s);
+            hold.lock();
+            if (kept) heap.large.push_back(s);
+        }
+        phase = Phase::Off;
+        const auto pause = (concurrent - begin) + (swept - terminate);
+        gc.cycles++;
+        gc.pause += pause;
+        gc.maxPause = max<chrono::nanoseconds>(gc.maxPause, pause);
+        if (gctrace <= 0) return;
+        auto ms = [](clock::duration d) { return chrono::duration<double, milli>(d).count(); };
+        const double since = chrono::duration<double>(begin - started).count();
+        char line[256];
+        snprintf(line, sizeof line, "gc %zu @%.3fs: %.3f+%.3f+%.3f ms clock, %zu->%zu->%zu MB, %zu MB goal, %.0f MB/s alloc, %d P\n",
+            gc.cycles, since, ms(concurrent - begin), ms(terminate - concurrent), ms(swept - terminate), before >> 20, end >> 20,
+            marked >> 20, lastGoal >> 20, since > 0 ? gc.allocated / since / (1 << 20) : 0.0, threaded ? static_cast<int>(workers.size()) : 1);
+        lock_guard<mutex> hold(output);
+        cerr << line;
+    }
+#pragma endregion
+#pragma region Map
+    // tables of maps are objects of the heap, and what their stores overwrite is shaded while marking
+    struct MapMemory {
+        goruntime* rt;
+        Worker* w;
+        void* allocate(size_t bytes) const { return rt->allocate(*w, bytes); }
+        void release(void*, size_t) const {}    // the collector frees it
+        void overwrite(int64_t old) const { if (rt->marking.load(memory_order_relaxed)) rt->barrier(*w, old); }
+    };
+    using Map = SwissMap<int64_t, MapMemory>;
+    Map mapOf(Worker& w, int64_t m) { return { *reinterpret_cast<Map::Header*>(m), { this, &w } }; }
+    int64_t makeMap(Worker& w, int64_t hint) {
+        if (hint < 0) panic("panic: runtime error: makemap: size out of range");
+        auto* h = reinterpret_cast<Map::Header*>(allocate(w, sizeof(Map::Header)));
+        h->seed = Map::mix(reinterpret_cast<uint64_t>(h));
+        mapOf(w, reinterpret_cast<int64_t>(h)).reserve(hint);
+        return reinterpret_cast<int64_t>(h);
+    }
+    // range over a nil map has nothing to go to
+    int64_t iterate(Worker& w, int64_t m) {
+        auto* it = reinterpret_cast<Map::Iterator*>(allocate(w, sizeof(Map::Iterator)));
+        if (m != 0) mapOf(w, m).start(*it);
+        return reinterpret_cast<int64_t>(it);
+    }
+#pragma endregion
+    // hands a line of output over at once, lines of goroutines don't mix
+    static void flush(G& g) {
+        if (g.out.empty()) return;
+        lock_guard<mutex> hold(output);
+        cout << g.out;
+        g.out.clear();
+    }
+#pragma endregion
+    // runs g until it returns, yields or is preempted. Preemption is looked at on calls and backward
+    // jumps once the slice is used up, a goroutine goes on when there is nothing else to run
+    template<bool Count> Exit execute(G& g, Worker& w, int64_t& value) {
+        const Insn* code = g.code, *pc = g.pc;
+        int64_t* r = g.r;
+        vector<Frame>& frames = g.frames;
+        const Program& program = *this->program;
+        const int64_t* const k = program.consts.data();
+        const int64_t* limit = g.limit;
+        int budget = Slice;
+        size_t steps = 0;
+#define VM_LEAVE(EXIT) { g.code = code; g.pc = pc; g.r = r; if constexpr (Count) w.steps += steps; return EXIT; }
+#ifdef G5_THREADED
+#define G5_LABEL(NAME) &&op_##NAME,
+        static const void* const labels[] = { G5_OPCODES(G5_LABEL) };
+#undef G5_LABEL
+#define VM_CASE(NAME) op_##NAME:
+#define VM_DISPATCH() { if constexpr (Count) steps++; goto *labels[static_cast<uint8_t>(pc->op)]; }
+        VM_DISPATCH();
+#else
+#define VM_CASE(NAME) case Op::NAME:
+#define VM_DISPATCH() continue;
+        for (;;) {
+        if constexpr (Count) steps++;
+        switch (pc->op) {
+#endif
+#define VM_NEXT() { pc++; VM_DISPATCH(); }
+#define VM_JUMP() { const Insn* to = code + pc->c; if (to <= pc && --budget < 0) { pc = to; goto preempt; } pc = to; VM_DISPATCH(); }
+#define VM_BRANCH(COND) { if (COND) VM_JUMP(); VM_NEXT(); }
+        VM_CASE(LoadI)     r[pc->a] = static_cast<int16_t>(pc->b); VM_NEXT();
+        VM_CASE(LoadK)     r[pc->a] = k[pc->b]; VM_NEXT();
+        VM_CASE(Move)      r[pc->a] = r[pc->b]; VM_NEXT();
+        VM_CASE(Add)       r[pc->a] = add(r[pc->b], r[pc->c]); VM_NEXT();
+        VM_CASE(AddI)      r[pc->a] = add(r[pc->b], static_cast<int16_t>(pc->c)); VM_NEXT();
+        VM_CASE(Sub)       r[pc->a] = sub(r[pc->b], r[pc->c]); VM_NEXT();
+        VM_CASE(Mul)       r[pc->a] = mul(r[pc->b], r[pc->c]); VM_NEXT();
+        VM_CASE(Div)       r[pc->a] = div(r[pc->b], r[pc->c]); VM_NEXT();
+        VM_CASE(Mod)       r[pc->a] = mod(r[pc->b], r[pc->c]); VM_NEXT();
+        VM_CASE(And)       r[pc->a] = r[pc->b] & r[pc->c]; VM_NEXT();
+        VM_CASE(Or)        r[pc->a] = r[pc->b] | r[pc->c]; VM_NEXT();
+        VM_CASE(Xor)       r[pc->a] = r[pc->b] ^ r[pc->c]; VM_NEXT();
+        VM_CASE(AndNot)    r[pc->a] = r[pc->b] & ~r[pc->c]; VM_NEXT();
+        VM_CASE(Shl)       r[pc->a] = shl(r[pc->b], r[pc->c]); VM_NEXT();
+        VM_CASE(Shr)       r[pc->a] = shr(r[pc->b], r[pc->c]); VM_NEXT();
+        VM_CASE(Eq)        r[pc->a] = r[pc->b] == r[pc->c]; VM_NEXT();
+        VM_CASE(Ne)        r[pc->a] = r[pc->b] != r[pc->c]; VM_NEXT();
+        VM_CASE(Lt)        r[pc->a] = r[pc->b] < r[pc->c]; VM_NEXT();
+        VM_CASE(Le)        r[pc->a] = r[pc->b] <= r[pc->c]; VM_NEXT();
+        VM_CASE(Neg)       r[pc->a] = sub(0, r[pc->b]); VM_NEXT();
+        VM_CASE(Not)       r[pc->a] = r[pc->b] == 0; VM_NEXT();
+        VM_CASE(Com)       r[pc->a] = ~r[pc->b]; VM_NEXT();
+        VM_CASE(Jump)      VM_JUMP();
+        VM_CASE(JumpIf)    VM_BRANCH(r[pc->a] != 0);
+        VM_CASE(JumpIfNot) VM_BRANCH(r[pc->a] == 0);
+        VM_CASE(JumpEq)    VM_BRANCH(r[pc->a] == r[pc->b]);
+        VM_CASE(JumpNe)    VM_BRANCH(r[pc->a] != r[pc->b]);
+        VM_CASE(JumpLt)    VM_BRANCH(r[pc->a] < r[pc->b]);
+        VM_CASE(JumpLe)    VM_BRANCH(r[pc->a] <= r[pc->b]);
+        VM_CASE(Call) {
+            const Function& callee = program.funcs[pc->b];
+            int64_t* base = r + pc->c;
+            if (frames.size() >= MaxFrames) panic("fatal error: stack overflow");
+            frames.push_back({ code, pc, r });
+            r = base;
+            pc = code = callee.code.data();
+            if (--budget < 0) goto preempt;
+            VM_DISPATCH();
+        }
+        VM_CASE(Ret) {
+            value = pc->b ? r[pc->a] : 0;
+            if (frames.empty()) VM_LEAVE(Exit::Done);
+            const Frame f = frames.back();
+            frames.pop_back();
+            code = f.code; pc = f.pc; r = f.base;
+            r[pc->a] = value;
+            VM_NEXT();
+        }
+        VM_CASE(Print) {
+            if (pc->b == 0) {
+                char digits[24];
+                g.out.append(digits, to_chars(digits, digits + sizeof digits, r[pc->a]).ptr);
+            } else if (pc->b == 1) g.out += program.strings[pc->a];
+            else if (pc->b == 3) g.out += r[pc->a] ? "true" : "false";
+            g.out += static_cast<char>(pc->c);
+            if (pc->c == '\n') flush(g);
+            VM_NEXT();
+        }
+        VM_CASE(Go) {
+            spawn<Count>(w, program.funcs[pc->b], r + pc->c);
+            VM_NEXT();
+        }
+        VM_CASE(Stack) {
+            if (r + pc->a > limit) {
+                g.r = r;
+                grow(w, g, pc->a);
+                r = g.r;
+                limit = g.limit;
+            }
+            VM_NEXT();
+        }
+        VM_CASE(Yield) {
+            pc++;
+            VM_LEAVE(Exit::Yield);
+        }
+        VM_CASE(MakeChan) {
+            if (r[pc->b] < 0) panic("panic: makechan: size out of range");
+            r[pc->a] = reinterpret_cast<int64_t>(&w.chans.emplace_back(static_cast<uint64_t>(r[pc->b])));
+            VM_NEXT();
+        }
+        VM_CASE(Send) {
+            if (r[pc->a] == 0 || !send(*chan(r[pc->a]), r[pc->b])) VM_LEAVE(Exit::Block);
+            VM_NEXT();
+        }
+        VM_CASE(Recv) {
+            if (r[pc->b] == 0 || !receive(*chan(r[pc->b]), r[pc->a])) VM_LEAVE(Exit::Block);
+            VM_NEXT();
+        }
+        VM_CASE(Close)     close(chan(r[pc->a])); VM_NEXT();
+        VM_CASE(Select) {
+            const int64_t chosen = select(w, g, program.selects[pc->b], r + pc->c);
+            if (chosen < 0) VM_LEAVE(Exit::Block);
+            r[pc->a] = chosen;
+            VM_NEXT();
+        }
+        VM_CASE(Received)  r[pc->a] = g.received; VM_NEXT();
+        VM_CASE(MakeSlice) {
+            const int64_t n = r[pc->b];
+            if (n < 0 || n >= static_cast<int64_t>(ArenaBytes / 8)) panic("panic: runtime error: makeslice: len out of range");
+            int64_t* p = allocate(w, 8 * static_cast<size_t>(n + 1));
+            p[0] = n;
+            r[pc->a] = reinterpret_cast<int64_t>(p);
+            VM_NEXT();
+        }
+        VM_CASE(Index)     r[pc->a] = *element(r[pc->b], r[pc->c]); VM_NEXT();
+        VM_CASE(SetIndex) {
+            int64_t* slot = element(r[pc->a], r[pc->b]);
+            if (marking.load(memory_order_relaxed)) barrier(w, *slot);
+            *slot = r[pc->c];
+            VM_NEXT();
+        }
+        VM_CASE(Len)       r[pc->a] = r[pc->b] != 0 ? *reinterpret_cast<const int64_t*>(r[pc->b]) : 0; VM_NEXT();
+        VM_CASE(MakeMap)   r[pc->a] = makeMap(w, r[pc->b]); VM_NEXT();
+        VM_CASE(MapIndex) {
+            const auto* s = r[pc->b] != 0 ? mapOf(w, r[pc->b]).find(r[pc->c]) : nullptr;
+            r[pc->a] = s != nullptr ? s->value : 0;
+            VM_NEXT();
+        }
+        VM_CASE(MapHas)    r[pc->a] = r[pc->b] != 0 && mapOf(w, r[pc->b]).find(r[pc->c]) != nullptr; VM_NEXT();
+        VM_CASE(SetMap) {
+            if (r[pc->a] == 0) panic("panic: assignment to entry in nil map");
+            mapOf(w, r[pc->a]).set(r[pc->b], r[pc->c]);
+            VM_NEXT();
+        }
+        VM_CASE(Delete) {
+            if (r[pc->a] != 0) mapOf(w, r[pc->a]).erase(r[pc->b]);
+            VM_NEXT();
+        }
+        VM_CASE(MapIter)   r[pc->a] = iterate(w, r[pc->b]); VM_NEXT();
+        VM_CASE(IterNext)  r[pc->a] = Map::next(*reinterpret_cast<Map::Iterator*>(r[pc->b]), { this, &w }); VM_NEXT();
+        VM_CASE(IterKey)   r[pc->a] = reinterpret_cast<const Map::Iterator*>(r[pc->b])->key; VM_NEXT();
+        VM_CASE(IterValue) r[pc->a] = reinterpret_cast<const Map::Iterator*>(r[pc->b])->value; VM_NEXT();
+#ifndef G5_THREADED
+        }
+#endif
+    preempt:
+        if (!stopping.load(memory_order_relaxed) && !exited.load(memory_order_relaxed) && w.runq.empty()
+            && queued.load(memory_order_relaxed) == 0) {
+            budget = Slice;
+            VM_DISPATCH();
+        }
+        VM_LEAVE(Exit::Preempt);
+#ifndef G5_THREADED
+        }
+#endif
+#undef VM_LEAVE
+#undef VM_CASE
+#undef VM_DISPATCH
+#undef VM_NEXT
+#undef VM_JUMP
+#undef VM_BRANCH
+    }
+};
+static goruntime grt;
+#pragma endregion
+#pragma region Native
+#if defined(__x86_64__) && defined(__linux__)
+#define G5_NATIVE   // the runtime stub below makes Linux system calls, elsewhere only the VM runs
+#endif
+// x86-64 System V assembly of a Program in AT&T syntax, each function of it becomes main.<name>.
+// Bytecode registers 0-4 live in callee-saved rbx and r12-r15, the others in the frame; rax, rcx
+// and rdx are scratch. A runtime stub provides _start, buffered output and panics, so the program
+// needs neither libc nor a dynamic linker. There is no scheduler, a goroutine runs to its end at
+// its go statement, which is one of the schedules Go allows as long as nothing blocks
+struct X64 {
+    static constexpr const char* homes[] = { "%rbx", "%r12", "%r13", "%r14", "%r15" };
+    static constexpr const char* args[] = { "%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%r9" };
+    static constexpr int Homes = 5, ArgRegs = 6;
+    const Program& program;
+    ostringstream out;
+    const Function* fn{};
+    size_t current{};
+    int saved{};    // callee-saved registers pushed by the function
+
+    explicit X64(const Program& program) :program(program) {}
+    string loc(uint16_t r) const {
+        return r < Homes ? homes[r] : to_string(-8 * (saved + r - Homes + 1)) + "(%rbp)";
+    }
+    string label(size_t target) const { return ".L" + to_string(current) + "_" + to_string(target); }
+    void ins(const string& s) { out << "\t" << s << "\n"; }
+    void load(const string& reg, uint16_t r) { ins("movq " + loc(r) + ", " + reg); }
+    void store(const string& reg, uint16_t r) { ins("movq " + reg + ", " + loc(r)); }
+    // a = b op c for op in add, sub, and, or, xor and imul
+    void arith(const char* op, const Insn& i) {
+        if (i.a == i.b && (i.a < Homes || i.c < Homes) && string(op) != "imulq") {
+            ins(string(op) + " " + loc(i.c) + ", " + loc(i.a));
+            return;
+        }
+        load("%rax", i.b);
+        ins(string(op) + " " + loc(i.c) + ", %rax");
+        store("%rax", i.a);
+    }
+    void compare(const char* set, const Insn& i) {
+        load("%rax", i.b);
+        ins("cmpq " + loc(i.c) + ", %rax");
+        ins(string(set) + " %al");
+        ins("movzbl %al, %eax");
+        store("%rax", i.a);
+    }
+    void branch(const char* jump, const Insn& i) {
+        load("%rax", i.a);
+        ins("cmpq " + loc(i.b) + ", %rax");
+        ins(string(jump) + " " + label(i.c));
+    }
+    void function(const Function& f) {
+        fn = &f;
+        saved = min<int>(f.registers, Homes);
+        const int slots = max<int>(f.registers - Homes, 0);
+        vector<bool> targets(f.code.size() + 1);
+        for (auto& i : f.code)
+            if (anyone(i.op, Op::Jump, Op::JumpIf, Op::JumpIfNot, Op::JumpEq, Op::JumpNe, Op::JumpLt, Op::JumpLe)) targets[i.c] = true;
+        const string name = "main." + string(f.name.str());
+        out << "\t.globl " << name << "\n\t.type " << name << ", @function\n" << name << ":\n";
+        ins("pushq %rbp");
+        ins("movq %rsp, %rbp");
+        for (int k = 0; k < saved; k++) ins(string("pushq ") + homes[k]);
+        if (const int bytes = 8 * (slots + (saved + slots) % 2); bytes != 0) ins("subq $" + to_string(bytes) + ", %rsp");
+        size_t pc = 0;
+        if (!f.code.empty() && f.code[0].op == Op::Stack) instruction(f.code[pc++]);  // before params are stored
+        for (uint16_t p = 0; p < f.params; p++) {
+            if (p < ArgRegs) store(args[p], p);
+            else { ins("movq " + to_string(16 + 8 * (p - ArgRegs)) + "(%rbp), %rax"); store("%rax", p); }
+        }
+        for (; pc < f.code.size(); pc++) {
+            if (targets[pc]) out << label(pc) << ":\n";
+            instruction(f.code[pc]);
+        }
+        out << ".Lret" << current << ":\n";
+        ins("leaq " + to_string(-8 * saved) + "(%rbp), %rsp");
+        for (int k = saved; k-- > 0;) ins(string("popq ") + homes[k]);
+        ins("popq %rbp");
+        ins("ret");
+        out << "\t.size " << name << ", .-" << name << "\n";
+    }
+    void instruction(const Insn& i) {
+        const string a = loc(i.a);
+        switch (i.op) {
+        case Op::LoadI: ins("movq $" + to_string(static_cast<int16_t>(i.b)) + ", " + a); break;
+        case Op::LoadK: {
+            const int64_t v = program.consts[i.b];
+            if (v >= INT32_MIN && v <= INT32_MAX) ins("movq $" + to_string(v) + ", " + a);
+            else { ins("movabsq $" + to_string(v) + ", %rax"); store("%rax", i.a); }
+            break;
+        }
+        case Op::Move:
+            if (i.a == i.b) break;
+            if (i.a < Homes || i.b < Homes) ins("movq " + loc(i.b) + ", " + a);
+            else { load("%rax", i.b); store("%rax", i.a); }
+            break;
+        case Op::Add:    arith("addq", i); break;
+        case Op::Sub:    arith("subq", i); break;
+        case Op::Mul:    arith("imulq", i); break;
+        case Op::And:    arith("andq", i); break;
+        case Op::Or:     arith("orq", i); break;
+        case Op::Xor:    arith("xorq", i); break;
+        case Op::AndNot:
+            load("%rcx", i.c);
+            ins("notq %rcx");
+            load("%rax", i.b);
+            ins("andq %rcx, %rax");
+            store("%rax", i.a);
+            break;
+        case Op::AddI:
+            if (i.a == i.b) { ins("addq $" + to_string(static_cast<int16_t>(i.c)) + ", " + a); break; }
+            load("%rax", i.b);
+            ins("addq $" + to_string(static_cast<int16_t>(i.c)) + ", %rax");
+            store("%rax", i.a);
+            break;
+        case Op::Div: case Op::Mod: {     // x / -1 would trap on the smallest integer
+            const string minus = ".Lm" + to_string(current) + "_" + to_string(&i - fn->code.data()), done = minus + "d";
+            load("%rcx", i.c);
+            ins("testq %rcx, %rcx");
+            ins("jz g5_panic_divide");
+            load("%rax", i.b);
+            ins("cmpq $-1, %rcx");
+            ins("je " + minus);
+            ins("cqto");
+            ins("idivq %rcx");
+            if (i.op == Op::Mod) ins("movq %rdx, %rax");
+            ins("jmp " + done);
+            out << minus << ":\n";
+            ins(i.op == Op::Div ? "negq %rax" : "xorl %eax, %eax");
+            out << done << ":\n";
+            store("%rax", i.a);
+            break;
+        }
+        case Op::Shl: case Op::Shr: {   // counts of 64 and more shift every bit out
+            load("%rcx", i.c);
+            ins("testq %rcx, %rcx");
+            ins("js g5_panic_shift");
+            load("%rax", i.b);
+            if (i.op == Op::Shl) {
+                ins("xorl %edx, %edx");
+                ins("shlq %cl, %rax");
+                ins("cmpq $64, %rcx");
+                ins("cmovaeq %rdx, %rax");
+            } else {
+                ins("movl $63, %edx");
+                ins("cmpq %rdx, %rcx");
+                ins("cmovaq %rdx, %rcx");
+                ins("sarq %cl, %rax");
+            }
+            store("%rax", i.a);
+            break;
+        }
+        case Op::Eq:     compare("sete", i); break;
+        case Op::Ne:     compare("setne", i); break;
+        case Op::Lt:     compare("setl", i); break;
+        case Op::Le:     compare("setle", i); break;
+        case Op::Neg:    load("%rax", i.b); ins("negq %rax"); store("%rax", i.a); break;
+        case Op::Com:    load("%rax", i.b); ins("notq %rax"); store("%rax", i.a); break;
+        case Op::Not:
+            ins("xorl %eax, %eax");
+            ins("cmpq $0, " + loc(i.b));
+            ins("sete %al");
+            store("%rax", i.a);
+            break;
+        case Op::Jump:      ins("jmp " + label(i.c)); break;
+        case Op::JumpIf:    ins("cmpq $0, " + a); ins("jne " + label(i.c)); break;
+        case Op::JumpIfNot: ins("cmpq $0, " + a); ins("je " + label(i.c)); break;
+        case Op::JumpEq:    branch("je", i); break;
+        case Op::JumpNe:    branch("jne", i); break;
+        case Op::JumpLt:    branch("jl", i); break;
+        case Op::JumpLe:    branch("jle", i); break;
+        case Op::Call: case Op::Go: {
+            const Function& callee = program.funcs[i.b];
+            const int stacked = max<int>(callee.params - ArgRegs, 0), pad = stacked % 2;
+            if (pad) ins("subq $8, %rsp");
+            for (int p = callee.params; p-- > ArgRegs;) ins("pushq " + loc(static_cast<uint16_t>(i.c + p)));
+            for (int p = 0; p < min<int>(callee.params, ArgRegs); p++) load(args[p], static_cast<uint16_t>(i.c + p));
+            ins("call main." + string(callee.name.str()));
+            if (stacked + pad) ins("addq $" + to_string(8 * (stacked + pad)) + ", %rsp");
+            if (i.op == Op::Call) store("%rax", i.a);
+            break;
+        }
+        case Op::Yield: break;
+        case Op::Stack:     // the frame is allocated but not written yet, a callee's is checked by it
+            ins("cmpq g5_stack_limit(%rip), %rsp");
+            ins("jb g5_panic_stack");
+            break;
+        case Op::MakeChan: case Op::Send: case Op::Recv: case Op::Close: case Op::Select: case Op::Received:
+        case Op::MakeSlice: case Op::Index: case Op::SetIndex: case Op::Len: case Op::MakeMap: case Op::MapIndex:
+        case Op::MapHas: case Op::SetMap: case Op::Delete: case Op::MapIter: case Op::IterNext: case Op::IterKey: case Op::IterValue:
+            break;      // link() refuses programs with channels, slices or maps
+        case Op::Ret:
+            if (i.b) load("%rax", i.a);
+            else ins("xorl %eax, %eax");
+            ins("jmp .Lret" + to_string(current));
+            break;
+        case Op::Print:
+            if (i.b == 0) { load("%rdi", i.a); ins("call g5_print_int"); }
+            else if (i.b == 3) { load("%rdi", i.a); ins("call g5_print_bool"); }
+            else if (i.b == 1) {
+                ins("leaq .Lstr" + to_string(i.a) + "(%rip), %rdi");
+                ins("movq $" + to_string(program.strings[i.a].size()) + ", %rsi");
+                ins("call g5_write");
+            }
+            ins("movl $" + to_string(i.c) + ", %edi");
+            ins("call g5_putc");
+            break;
+        }
+    }
+    string assembly() {
+        out << "\t.text\n";
+        for (current = 0; current < program.funcs.size(); current++) function(program.funcs[current]);
+        out << runtime;
+        out << "\t.section .rodata\n";
+        for (size_t k = 0; k < program.strings.size(); k++) {
+            out << ".Lstr" << k << ":\n";
+            for (size_t i = 0; i < program.strings[k].size(); i++)
+                out << (i % 16 ? "," : "\t.byte ") << static_cast<int>(static_cast<unsigned char>(program.strings[k][i]))
+                    << (i % 16 == 15 || i + 1 == program.strings[k].size() ? "\n" : "");
+        }
+        out << "\t.section .note.GNU-stack,\"\",@progbits\n";
+        return out.str();
+    }
+    static constexpr const char* runtime = R"(	.globl _start
+# _start gives main 3/4 of RLIMIT_STACK up to 1 GB, functions check g5_stack_limit on entry and the
+# rest holds the environment and the frames of g5_panic_stack
+_start:
+	xorl %ebp, %ebp
+	andq $-16, %rsp
+	subq $16, %rsp
+	movq $8388608, (%rsp)
+	movl $97, %eax
+	movl $3, %edi
+	movq %rsp, %rsi
+	syscall
+	movq (%rsp), %rax
+	addq $16, %rsp
+	movl $1073741824, %ecx
+	cmpq %rcx, %rax
+	cmova %rcx, %rax
+	shrq $2, %rax
+	leaq (%rax,%rax,2), %rax
+	movq %rsp, %rcx
+	subq %rax, %rcx
+	movq %rcx, g5_stack_limit(%rip)
+	call main.main
+	call g5_flush
+	movl $60, %eax
+	xorl %edi, %edi
+	syscall
+# g5_putc(dil) appends a byte to the output buffer
+g5_putc:
+	movq g5_outlen(%rip), %rax
+	cmpq $4096, %rax
+	jb 1f
+	pushq %rdi
+	call g5_flush
+	popq %rdi
+	xorl %eax, %eax
+1:	leaq g5_outbuf(%rip), %rcx
+	movb %dil, (%rcx,%rax)
+	incq %rax
+	movq %rax, g5_outlen(%rip)
+	ret
+# g5_write(rdi, rsi) appends rsi bytes at rdi
+g5_write:
+	pushq %rbx
+	pushq %r12
+	movq %rdi, %rbx
+	movq %rsi, %r12
+1:	testq %r12, %r12
+	jz 2f
+	movzbl (%rbx), %edi
+	call g5_putc
+	incq %rbx
+	decq %r12
+	jmp 1b
+2:	popq %r12
+	popq %rbx
+	ret
+# g5_print_int(rdi) appends a decimal integer
+g5_print_int:
+	subq $40, %rsp
+	leaq 32(%rsp), %rsi
+	movq %rdi, %r8
+	movq %rdi, %rax
+	testq %rax, %rax
+	jns 1f
+	negq %rax
+1:	movl $10, %ecx
+2:	xorl %edx, %edx
+	divq %rcx
+	addb $48, %dl
+	decq %rsi
+	movb %dl, (%rsi)
+	testq %rax, %rax
+	jnz 2b
+	testq %r8, %r8
+	jns 3f
+	decq %rsi
+	movb $45, (%rsi)
+3:	leaq 32(%rsp), %rdx
+	subq %rsi, %rdx
+	movq %rsi, %rdi
+	movq %rdx, %rsi
+	call g5_write
+	addq $40, %rsp
+	ret
+# g5_print_bool(rdi) appends true or false
+g5_print_bool:
+	testq %rdi, %rdi
+	leaq g5_false(%rip), %rdi
+	movl $5, %esi
+	jz 1f
+	leaq g5_true(%rip), %rdi
+	movl $4, %esi
+1:	jmp g5_write
+# g5_flush writes the output buffer to stdout
+g5_flush:
+	movq g5_outlen(%rip), %rdx
+	leaq g5_outbuf(%rip), %rsi
+1:	testq %rdx, %rdx
+	jz 2f
+	movl $1, %edi
+	movl $1, %eax
+	syscall
+	testq %rax, %rax
+	jle 2f
+	addq %rax, %rsi
+	subq %rax, %rdx
+	jmp 1b
+2:	movq $0, g5_outlen(%rip)
+	ret
+# g5_panic(rdi, rsi) flushes stdout, writes the message to stderr and exits with 2
+g5_panic:
+	pushq %rdi
+	pushq %rsi
+	call g5_flush
+	popq %rdx
+	popq %rsi
+	movl $2, %edi
+	movl $1, %eax
+	syscall
+	movl $60, %eax
+	movl $2, %edi
+	syscall
+g5_panic_divide:
+	leaq g5_divide(%rip), %rdi
+	movq $g5_divide_len, %rsi
+	jmp g5_panic
+g5_panic_shift:
+	leaq g5_shift(%rip), %rdi
+	movq $g5_shift_len, %rsi
+	jmp g5_panic
+g5_panic_stack:
+	leaq g5_stack(%rip), %rdi
+	movq $g5_stack_len, %rsi
+	jmp g5_panic
+	.section .rodata
+g5_divide:
+	.ascii "panic: runtime error: integer divide by zero\n"
+	.set g5_divide_len, . - g5_divide
+g5_shift:
+	.ascii "panic: runtime error: negative shift amount\n"
+	.set g5_shift_len, . - g5_shift
+g5_stack:
+	.ascii "fatal error: stack overflow\n"
+	.set g5_stack_len, . - g5_stack
+g5_true:
+	.ascii "true"
+g5_false:
+	.ascii "false"
+	.bss
+	.align 8
+g5_outlen:
+	.zero 8
+g5_stack_limit:
+	.zero 8
+g5_outbuf:
+	.zero 4096
+)";
+};
+// Runs args[0], looked up in PATH, with args and waits for it. No shell is involved so nothing needs
+// quoting. Returns the wait status, or -1 if it could not be started
+int execute(const vector<string>& args) {
+#ifdef _WIN32
+    return -1;
+#else
+    vector<char*> argv;
+    for (auto& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+    pid_t pid;
+    if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) return -1;
+    int status;
+    while (waitpid(pid, &status, 0) == -1)
+        if (errno != EINTR) return -1;
+    return status;
+#endif
+}
+// what a wait status of execute() tells, for diagnostics
+string exitStatus(int status) {
+#ifndef _WIN32
+    if (status != -1 && WIFEXITED(status)) return "exit status " + to_string(WEXITSTATUS(status));
+    if (status != -1 && WIFSIGNALED(status)) return "signal " + to_string(WTERMSIG(status));
+#endif
+    return "could not be started";
+}
+// Assembles and links a program into a static executable, the C compiler driver $CC or cc runs as
+// and ld. $CC may hold words that lead the arguments, split at spaces. The assembly is kept next to
+// it as exe.s
+bool link(const Program& program, const string& exe) {
+    for (auto& f : program.funcs)
+        for (auto& i : f.code) {
+            if (anyone(i.op, Op::MakeChan, Op::Send, Op::Recv, Op::Close, Op::Select, Op::Received)) {
+                cerr << "fatal error: channels are only run by the VM yet\n";
+                return false;
+            }
+            if (anyone(i.op, Op::MakeSlice, Op::Index, Op::SetIndex, Op::Len)) {
+                cerr << "fatal error: slices are only run by the VM yet\n";     // the heap is goruntime's
+                return false;
+            }
+            if (anyone(i.op, Op::MakeMap, Op::MapIndex, Op::MapHas, Op::SetMap, Op::Delete, Op::MapIter, Op::IterNext)) {
+                cerr << "fatal error: maps are only run by the VM yet\n";
+                return false;
+            }
+        }
+    const string source = exe + ".s";
+    {
+        ofstream s(source);
+        s << X64(program).assembly();
+        if (!s.good()) {
+            cerr << "fatal error: can not write " << source << "\n";
+            return false;
+        }
+    }
+    vector<string> args;
+    istringstream cc(getenv("CC") != nullptr ? getenv("CC") : "cc");
+    for (string word; cc >> word;) args.push_back(word);
+    if (args.empty()) args.push_back("cc");
+    args.insert(args.end(), { "-nostdlib", "-static", "-o", exe, source });
+    if (const int status = execute(args); status != 0) {
+        cerr << "fatal error: " << args[0] << " failed, " << exitStatus(status) << "\n";
+        return false;
+    }
+    return true;
+}
+#pragma endregion
+
+//===---------------------------------------------------------------------------------------===//
 // debug auxiliary functions, they are not part of 5 functions
 //===---------------------------------------------------------------------------------------===//
 void printLex(const string & filename) {
-    fstream f(filename, ios::binary | ios::in);
-    while (lastToken != TK_EOF) {
-        auto[token, lexeme] = next(f);
-        cout << "<" << token << "," << lexeme << "," << line << "," << column << ">\n";
+    Lexer f(filename);
+    try {
+        while (f.lastToken != TK_EOF) {
+            auto[token, lexeme, sym] = next(f);
+            cout << "<" << token << "," << lexeme << "," << f.line << "," << f.column << ">\n";
+        }
+    } catch (Diagnostic& d) {
+        cerr << d << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Go files named by paths, a directory stands for its *.go files in name order
+vector<string> goFiles(char* paths[], int n) {
+    vector<string> files;
+    for (int i = 0; i < n; i++) {
+        if (filesystem::is_directory(paths[i])) {
+            const size_t from = files.size();
+            for (auto& entry : filesystem::directory_iterator(paths[i]))
+                if (entry.is_regular_file() && entry.path().extension() == ".go") files.push_back(entry.path().string());
+            sort(files.begin() + from, files.end());
+        } else {
+            files.push_back(paths[i]);
+        }
+    }
+    return files;
+}
+#ifdef G5_BENCH
+// g5_bench counts every heap allocation besides the arena ones
+static atomic<size_t> heapAllocs{ 0 };
+void* operator new(size_t n) {
+    heapAllocs++;
+    if (void* p = malloc(n == 0 ? 1 : n); p != nullptr) return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+size_t peakRSS() {
+#ifndef _WIN32
+    struct rusage ru{};
+    if (getrusage(RUSAGE_SELF, &ru) == 0) return static_cast<size_t>(ru.ru_maxrss) * 1024;
+#endif
+    return 0;
+}
+// resident bytes now, where /proc tells
+size_t currentRSS() {
+#ifdef __linux__
+    size_t pages = 0, resident = 0;
+    if (FILE* f = fopen("/proc/self/statm", "r")) {
+        if (fscanf(f, "%zu %zu", &pages, &resident) != 2) resident = 0;
+        fclose(f);
+    }
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+// Naive interpreter of the subset codegen() lowers, it walks the tree and looks variables up by
+// name. g5_bench measures the bytecode VM against it
+struct TreeWalker {
+    enum Flow { Normal, Break, Continue, Return };
+    map<Symbol, FuncDecl*> funcs;
+    vector<pair<Symbol, int64_t>> vars;
+    size_t frame = 0, block = 0;    // variables of the running call and of the innermost block start there
+    int64_t result = 0;
+    const Symbol print = symbols.intern("g5print"), yes = symbols.intern("true"), blank = symbols.intern("_");
+    explicit TreeWalker(const CompilationUnit* unit) { for (auto* f : unit->funcDecl) funcs[f->funcName] = f; }
+    int64_t& var(Symbol name) {
+        for (size_t i = vars.size(); i-- > frame;) if (vars[i].first == name) return vars[i].second;
+        throw runtime_error("undefined: " + string(name.str()));
+    }
+    void declare(Symbol name, int64_t v) {
+        for (size_t i = block; i < vars.size(); i++) if (vars[i].first == name) { vars[i].second = v; return; }
+        vars.emplace_back(name, v);
+    }
+    int64_t call(FuncDecl* f, const vector<int64_t>& args) {
+        const size_t savedFrame = frame, savedBlock = block, size = vars.size();
+        frame = block = size;
+        for (size_t i = 0; i < args.size(); i++) vars.emplace_back(f->signature->param->paramList[i]->name, args[i]);
+        result = 0;
+        stmts(f->funcBody);
+        vars.resize(size);
+        frame = savedFrame; block = savedBlock;
+        return result;
+    }
+    int64_t call(CallExpr* e) {
+        vector<int64_t> args;
+        if (e->arguments != nullptr) for (auto* a : e->arguments->exprs) args.push_back(expr(a));
+        if (static_cast<Name*>(e->operand)->name == print) {
+            for (size_t i = 0; i < args.size(); i++) cout << args[i] << (i + 1 < args.size() ? ' ' : '\n');
+            return 0;
+        }
+        return call(funcs.at(static_cast<Name*>(e->operand)->name), args);
+    }
+    Flow stmts(StmtList* list) {
+        if (list == nullptr) return Normal;
+        const size_t saved = block, size = vars.size();
+        block = size;
+        Flow flow = Normal;
+        for (auto* s : list->stmts) if ((flow = stmt(s)) != Normal) break;
+        vars.resize(size);
+        block = saved;
+        return flow;
+    }
+    Flow stmt(Stmt* s) {
+        if (s == nullptr) return Normal;
+        const size_t saved = block, size = vars.size();
+        auto leave = [&](Flow flow) { vars.resize(size); block = saved; return flow; };
+        switch (s->kind) {
+        case NodeKind::StmtList: return stmts(static_cast<StmtList*>(s));
+        case NodeKind::ExprStmt: call(static_cast<CallExpr*>(static_cast<ExprStmt*>(s)->expr)); return Normal;
+        case NodeKind::SAssignStmt: {
+            auto* a = static_cast<SAssignStmt*>(s);
+            vector<int64_t> values;
+            for (auto* e : a->rhs->exprs) values.push_back(expr(e));
+            for (size_t i = 0; i < values.size(); i++) if (a->lhs[i] != blank) declare(a->lhs[i], values[i]);
+            return Normal;
+        }
+        case NodeKind::AssignStmt: {
+            auto* a = static_cast<AssignStmt*>(s);
+            vector<int64_t> values;
+            for (auto* e : a->rhs->exprs) values.push_back(expr(e));
+            for (size_t i = 0; i < values.size(); i++) {
+                const Symbol name = static_cast<Name*>(a->lhs->exprs[i])->name;
+                if (name == blank) continue;
+                int64_t& v = var(name);
+                v = a->op == OP_AGN ? values[i] : arith(Emitter::compound(a->op), v, values[i]);
+            }
+            return Normal;
+        }
+        case NodeKind::IncDecStmt: {
+            auto* i = static_cast<IncDecStmt*>(s);
+            int64_t& v = var(static_cast<Name*>(i->expr)->name);
+            v = goruntime::add(v, i->isInc ? 1 : -1);
+            return Normal;
+        }
+        case NodeKind::IfStmt: {
+            auto* i = static_cast<IfStmt*>(s);
+            block = size;
+            stmt(i->init);
+            return leave(expr(i->cond) ? stmt(i->ifBlock) : stmt(i->elseBlock));
+        }
+        case NodeKind::ForStmt: {
+            auto* f = static_cast<ForStmt*>(s);
+            auto* cond = as<ExprStmt>(f->cond) != nullptr ? static_cast<ExprStmt*>(f->cond)->expr : static_cast<Expr*>(f->cond);
+            block = size;
+            stmt(static_cast<Stmt*>(f->init));
+            for (; cond == nullptr || expr(cond); stmt(static_cast<Stmt*>(f->post))) {
+                const Flow flow = stmts(f->block);
+                if (flow == Break) break;
+                if (flow == Return) return leave(Return);
+            }
+            return leave(Normal);
+        }
+        case NodeKind::ReturnStmt: {
+            auto* exprs = static_cast<ReturnStmt*>(s)->exprs;
+            result = exprs != nullptr ? expr(exprs->exprs[0]) : 0;
+            return Return;
+        }
+        case NodeKind::BreakStmt: return Break;
+        case NodeKind::ContinueStmt: return Continue;
+        default: throw runtime_error(string(kindName[static_cast<size_t>(s->kind)]) + " is not supported");
+        }
     }
+    static int64_t arith(TokenType op, int64_t x, int64_t y) {
+        switch (op) {
+        case OP_ADD: return goruntime::add(x, y);
+        case OP_SUB: return goruntime::sub(x, y);
+        case OP_MUL: return goruntime::mul(x, y);
+        case OP_DIV: return goruntime::div(x, y);
+        case OP_MOD: return goruntime::mod(x, y);
+        case OP_BITAND: return x & y;
+        case OP_BITOR: return x | y;
+        case OP_XOR: return x ^ y;
+        case OP_ANDXOR: return x & ~y;
+        case OP_LSHIFT: return goruntime::shl(x, y);
+        case OP_RSHIFT: return goruntime::shr(x, y);
+        case OP_EQ: return x == y;
+        case OP_NE: return x != y;
+        case OP_LT: return x < y;
+        case OP_LE: return x <= y;
+        case OP_GT: return x > y;
+        case OP_GE: return x >= y;
+        default: throw runtime_error("operator " + string(spelling(op)) + " is not supported");
+        }
+    }
+    int64_t expr(Expr* e) {
+        switch (e->kind) {
+        case NodeKind::Name: {
+            const Symbol name = static_cast<Name*>(e)->name;
+            for (size_t i = vars.size(); i-- > frame;) if (vars[i].first == name) return vars[i].second;
+            return name == yes;
+        }
+        case NodeKind::BasicLit: {
+            int64_t v = 0;
+            Emitter::integer(static_cast<BasicLit*>(e)).num.toInt64(v);
+            return v;
+        }
+        case NodeKind::CallExpr: return call(static_cast<CallExpr*>(e));
+        case NodeKind::BasicExpr: {
+            auto* b = static_cast<BasicExpr*>(e);
+            if (b->rhs == nullptr) {
+                const int64_t v = expr(b->lhs);
+                return b->op == OP_SUB ? goruntime::sub(0, v) : b->op == OP_NOT ? v == 0 : b->op == OP_XOR ? ~v : v;
+            }
+            if (b->op == OP_AND) return expr(b->lhs) && expr(b->rhs);
+            if (b->op == OP_OR) return expr(b->lhs) || expr(b->rhs);
+            const int64_t x = expr(b->lhs);
+            return arith(b->op, x, expr(b->rhs));
+        }
+        default: throw runtime_error(string(kindName[static_cast<size_t>(e->kind)]) + " is not supported");
+        }
+    }
+};
+// tables of the maps of goruntime on memory of the C heap, the write barrier is of no concern
+struct Malloc {
+    static void* allocate(size_t bytes) { return calloc(1, bytes); }
+    static void release(void* p, size_t) { free(p); }
+    template<typename T> static void overwrite(const T&) {}
+};
+// ns an insert, a lookup and an entry of range take over keys, in SwissMap and in std::unordered_map.
+// Keys are looked up shuffled, nodes of std::unordered_map would be visited in the order they were made
+struct MapTimes { double insert[2], lookup[2], iterate[2]; };
+template<typename K> MapTimes mapTimes(const vector<K>& keys, int passes) {
+    using clock = chrono::steady_clock;
+    using Swiss = SwissMap<K, Malloc>;
+    vector<K> shuffled = keys;
+    for (size_t i = shuffled.size(); i > 1; i--) swap(shuffled[i - 1], shuffled[Swiss::mix(i) % i]);
+    MapTimes t{};
+    auto add = [&](double& to, clock::time_point since) { to += chrono::duration<double, nano>(clock::now() - since).count(); };
+    int64_t sink = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        typename Swiss::Header h{};
+        h.seed = Swiss::mix(pass);
+        Swiss swiss(h, {});
+        auto begin = clock::now();
+        for (size_t i = 0; i < keys.size(); i++) swiss.set(keys[i], static_cast<int64_t>(i));
+        add(t.insert[0], begin);
+        begin = clock::now();
+        for (auto& k : shuffled) sink += swiss.find(k)->value;
+        add(t.lookup[0], begin);
+        begin = clock::now();
+        typename Swiss::Iterator it{};
+        swiss.start(it);
+        while (Swiss::next(it, {})) sink += it.value;
+        add(t.iterate[0], begin);
+        free(h.table);
+        unordered_map<K, int64_t> baseline;
+        begin = clock::now();
+        for (size_t i = 0; i < keys.size(); i++) baseline[keys[i]] = static_cast<int64_t>(i);
+        add(t.insert[1], begin);
+        begin = clock::now();
+        for (auto& k : shuffled) sink += baseline.find(k)->second;
+        add(t.lookup[1], begin);
+        begin = clock::now();
+        for (auto& e : baseline) sink += e.second;
+        add(t.iterate[1], begin);
+    }
+    for (auto* d : { t.insert, t.lookup, t.iterate }) for (int i = 0; i < 2; i++) d[i] /= static_cast<double>(passes) * keys.size();
+    volatile int64_t read = sink;   // the lookups may not go away
+    (void)read;
+    return t;
+}
+// usage: g5_bench [-n passes] [-o report.json] [files or directories...]
+// next(), parse() of every ParseMode, loading of AstCache images and walks of both tree layouts run `passes` times
+// over every file, throughput is reported per file and in total on stdout and as JSON. The parser corpus of this repository is used if no file is given
+int main(int argc, char *argv[]) {
+    int passes = 20;
+    string report = "g5_bench.json";
+    int i = 1;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (string_view(argv[i]) == "-n") passes = max(atoi(argv[i + 1]), 1);
+        else if (string_view(argv[i]) == "-o") report = argv[i + 1];
+        else break;
+    }
+    vector<string> files;
+    if (i < argc) {
+        files = goFiles(argv + i, argc - i);
+    } else {
+        char* corpus[] = { const_cast<char*>(G5_CORPUS "/official"), const_cast<char*>(G5_CORPUS "/adhoc") };
+        files = goFiles(corpus, 2);
+    }
+    struct Result {
+        string file;
+        size_t bytes, tokens, nodes, arenaAllocs, arenaBytes, heapAllocs, peakRSS, imageBytes, compactBytes;
+        double lexSeconds, parseSeconds, bufferSeconds, declSeconds, cacheSeconds, walkSeconds, compactWalkSeconds;
+    };
+    using clock = chrono::steady_clock;
+    auto seconds = [](clock::time_point since) { return chrono::duration<double>(clock::now() - since).count(); };
+    vector<Result> results;
+    for (auto& file : files) {
+        Result r{ file };
+        r.bytes = filesystem::file_size(file);
+        auto start = clock::now();
+        for (int pass = 0; pass < passes; pass++) {
+            Lexer f(file);
+            size_t tokens = 0;
+            while (next(f).type != TK_EOF) tokens++;
+            r.tokens = tokens;
+        }
+        r.lexSeconds = seconds(start);
+        const size_t heapBefore = heapAllocs;
+        start = clock::now();
+        for (int pass = 0; pass < passes; pass++) {
+            auto* unit = parse(file);
+            if (pass == 0) {
+                size_t nodes = 0;
+                auto count = [&](Node*) { nodes++; return true; };
+                for (auto* decl : unit->constDecl) walk(decl, count);
+                for (auto* decl : unit->typeDecl) walk(decl, count);
+                for (auto* decl : unit->varDecl) walk(decl, count);
+                for (auto* decl : unit->funcDecl) walk(decl, count);
+                r.nodes = nodes;
+                r.arenaAllocs = unit->arena.count;
+                r.arenaBytes = unit->arena.used;
+            }
+            delete unit;
+        }
+        r.parseSeconds = seconds(start);
+        r.heapAllocs = (heapAllocs - heapBefore) / passes;
+        start = clock::now();
+        for (int pass = 0; pass < passes; pass++) delete parse(file, ParseMode::Buffer);
+        r.bufferSeconds = seconds(start);
+        start = clock::now();
+        for (int pass = 0; pass < passes; pass++) delete parse(file, ParseMode::Lazy);
+        r.declSeconds = seconds(start);
+        auto* unit = parse(file);
+        const string image = AstCache::encode(unit, 0);    // decoded from memory, disk is not measured
+        r.imageBytes = image.size();
+        start = clock::now();
+        for (int pass = 0; pass < passes; pass++) delete AstCache::decode(image.data(), image.data() + image.size(), 0);
+        r.cacheSeconds = seconds(start);
+        const CompactAst compact(unit);
+        r.compactBytes = compact.bytes();
+        size_t visited = 0, compactVisited = 0;
+        auto walkAll = [&](const auto& decls) { for (auto* decl : decls) walk(decl, [&](auto) { visited++; return true; }); };
+        start = clock::now();
+        for (int pass = 0; pass < passes; pass++) {
+            walkAll(unit->constDecl); walkAll(unit->typeDecl); walkAll(unit->funcDecl); walkAll(unit->varDecl);
+        }
+        r.walkSeconds = seconds(start);
+        start = clock::now();
+        for (int pass = 0; pass < passes; pass++)
+            for (auto* decls : { &compact.constDecl, &compact.typeDecl, &compact.funcDecl, &compact.varDecl })
+                for (auto decl : *decls) compact.walk(decl, [&](auto) { compactVisited++; return true; });
+        r.compactWalkSeconds = seconds(start);
+        if (visited != compactVisited) cerr << "warning: " << file << " has " << visited << " nodes but " << compactVisited << " compact\n";
+        delete unit;
+        r.peakRSS = peakRSS();
+        results.push_back(r);
+    }
+    // the bytecode VM against walking the tree, on a program of loops, branches and calls
+    const char* vmSource = R"(package main
+
+func fib(n int) int {
+    if n < 2 {
+        return n
+    }
+    return fib(n-1) + fib(n-2)
+}
+
+func work() int {
+    sum := 0
+    for i := 0; i < 200000; i++ {
+        if i%3 == 0 || i%5 == 0 {
+            sum += i * 2
+        } else {
+            sum ^= i
+        }
+    }
+    return sum + fib(18)
+}
+
+func main() {
+    g5print(work())
+}
+)";
+    auto* vmUnit = parse("vm.go", vmSource, ParseMode::Stream);
+    Package vmPackage;
+    vmPackage.merge(vmUnit);
+    const Program program = codegen(vmPackage);
+    const auto work = find_if(program.funcs.begin(), program.funcs.end(), [](auto& f) { return f.name.str() == "work"; });
+    if (program.entry < 0 || work == program.funcs.end()) {
+        cerr << "fatal error: the VM benchmark does not compile, " << program.note << "\n";
+        return EXIT_FAILURE;
+    }
+    grt.steps = 0;
+    const int64_t expected = grt.run<true>(program, static_cast<int>(work - program.funcs.begin()));
+    const size_t instructions = grt.steps;
+    auto start = clock::now();
+    for (int pass = 0; pass < passes; pass++)
+        if (grt.run(program, static_cast<int>(work - program.funcs.begin())) != expected) cerr << "warning: the VM is not deterministic\n";
+    const double vmSeconds = seconds(start);
+    TreeWalker walker(vmUnit);
+    start = clock::now();
+    for (int pass = 0; pass < passes; pass++)
+        if (walker.call(walker.funcs.at(symbols.intern("work")), {}) != expected) cerr << "warning: the VM and the tree walker disagree\n";
+    const double treeSeconds = seconds(start);
+    delete vmUnit;
+    // the scheduler on one worker: spawning goroutines that don't run before main returns, spawning
+    // each and running it right away, and two goroutines that yield to each other
+    const char* goSource = R"(package main
+
+import "runtime"
+
+func nop(i int) {
+}
+
+func spawn() int {
+    for i := 0; i < 100000; i++ {
+        go nop(i)
+    }
+    return 0
+}
+
+func spawnRun() int {
+    for i := 0; i < 100000; i++ {
+        go nop(i)
+        runtime.Gosched()
+    }
+    return 0
+}
+
+func yielder(n int) {
+    for i := 0; i < n; i++ {
+        runtime.Gosched()
+    }
+}
+
+func yield() int {
+    go yielder(100000)
+    yielder(100000)
+    return 0
+}
+
+func main() {
+    spawn()
+    spawnRun()
+    yield()
+}
+)";
+    auto* goUnit = parse("go.go", goSource, ParseMode::Stream);
+    Package goPackage;
+    goPackage.merge(goUnit);
+    const Program goProgram = codegen(goPackage);
+    auto entry = [&](const char* name) {
+        auto f = find_if(goProgram.funcs.begin(), goProgram.funcs.end(), [&](auto& fn) { return fn.name.str() == name; });
+        return f != goProgram.funcs.end() ? static_cast<int>(f - goProgram.funcs.begin()) : -1;
+    };
+    if (entry("spawn") < 0 || entry("spawnRun") < 0 || entry("yield") < 0) {
+        cerr << "fatal error: the scheduler benchmark does not compile, " << goProgram.note << "\n";
+        return EXIT_FAILURE;
+    }
+    grt.procs = 1;
+    auto perOp = [&](const char* name, size_t goruntime::* counter) {
+        grt.run(goProgram, entry(name));
+        const size_t before = grt.*counter;
+        const auto begin = clock::now();
+        for (int pass = 0; pass < passes; pass++) grt.run(goProgram, entry(name));
+        const size_t n = grt.*counter - before;
+        return n != 0 ? seconds(begin) / n : 0.0;
+    };
+    const double spawnSeconds = perOp("spawn", &goruntime::spawns), spawnRunSeconds = perOp("spawnRun", &goruntime::spawns),
+        yieldSeconds = perOp("yield", &goruntime::switches);
+    grt.procs = 0;
+    delete goUnit;
+    // channels on every worker: a producer and a consumer streaming values through an unbuffered and
+    // a buffered channel, and the round trip of a value sent to a goroutine that echoes it back
+    const char* chanSource = R"(package main
+
+func produce(ch chan int, n int) {
+    for i := 0; i < n; i++ {
+        ch <- i
+    }
+}
+
+func stream(size int) int {
+    ch := make(chan int, size)
+    go produce(ch, 100000)
+    sum := 0
+    for i := 0; i < 100000; i++ {
+        sum += <-ch
+    }
+    return sum
+}
+
+func unbuffered() int {
+    return stream(0)
+}
+
+func buffered() int {
+    return stream(128)
+}
+
+func echo(in, out chan int) {
+    for {
+        out <- <-in
+    }
+}
+
+func roundTrip() int {
+    in, out := make(chan int), make(chan int)
+    go echo(in, out)
+    for i := 0; i < 100000; i++ {
+        in <- i
+        <-out
+    }
+    return 0
+}
+
+func main() {
+    unbuffered()
+    buffered()
+    roundTrip()
+}
+)";
+    auto* chanUnit = parse("chan.go", chanSource, ParseMode::Stream);
+    Package chanPackage;
+    chanPackage.merge(chanUnit);
+    const Program chanProgram = codegen(chanPackage);
+    auto perMessage = [&](const char* name) {
+        auto f = find_if(chanProgram.funcs.begin(), chanProgram.funcs.end(), [&](auto& fn) { return fn.name.str() == name; });
+        if (chanProgram.entry < 0 || f == chanProgram.funcs.end()) return -1.0;
+        const int at = static_cast<int>(f - chanProgram.funcs.begin());
+        grt.run(chanProgram, at);
+        const auto begin = clock::now();
+        for (int pass = 0; pass < passes; pass++) grt.run(chanProgram, at);
+        return seconds(begin) / passes / 100000;
+    };
+    const double unbufferedSeconds = perMessage("unbuffered"), bufferedSeconds = perMessage("buffered"),
+        roundTripSeconds = perMessage("roundTrip");
+    if (roundTripSeconds < 0) {
+        cerr << "fatal error: the channel benchmark does not compile, " << chanProgram.note << "\n";
+        return EXIT_FAILURE;
+    }
+    delete chanUnit;
+    // binary trees churn the heap, the collector runs at the default GOGC
+    const char* heapSource = R"(package main
+
+type node []node
+
+func tree(depth int) node {
+    if depth == 0 {
+        return make(node, 0)
+    }
+    n := make(node, 2)
+    n[0] = tree(depth - 1)
+    n[1] = tree(depth - 1)
+    return n
+}
+
+func check(t node) int {
+    if len(t) == 0 {
+        return 1
+    }
+    return 1 + check(t[0]) + check(t[1])
+}
+
+func trees() int {
+    long := tree(16)
+    sum := 0
+    for i := 0; i < 64; i++ {
+        sum += check(tree(12))
+    }
+    return sum + check(long)
+}
+
+func main() {
+    trees()
+}
+)";
+    auto* heapUnit = parse("heap.go", heapSource, ParseMode::Stream);
+    Package heapPackage;
+    heapPackage.merge(heapUnit);
+    const Program heapProgram = codegen(heapPackage);
+    auto treesFunc = find_if(heapProgram.funcs.begin(), heapProgram.funcs.end(), [](auto& fn) { return fn.name.str() == "trees"; });
+    if (heapProgram.entry < 0 || treesFunc == heapProgram.funcs.end()) {
+        cerr << "fatal error: the heap benchmark does not compile, " << heapProgram.note << "\n";
+        return EXIT_FAILURE;
+    }
+    const int treesAt = static_cast<int>(treesFunc - heapProgram.funcs.begin());
+    grt.run(heapProgram, treesAt);
+    const size_t allocatedBefore = grt.gc.allocated, cyclesBefore = grt.gc.cycles;
+    const auto pauseBefore = grt.gc.pause;
+    grt.gc.maxPause = {};
+    const auto heapBegin = clock::now();
+    for (int pass = 0; pass < passes; pass++) grt.run(heapProgram, treesAt);
+    const double heapSeconds = seconds(heapBegin);
+    const size_t heapCycles = grt.gc.cycles - cyclesBefore;
+    const double allocRate = heapSeconds > 0 ? (grt.gc.allocated - allocatedBefore) / heapSeconds : 0;
+    const double pauseNs = heapCycles ? chrono::duration<double, nano>(grt.gc.pause - pauseBefore).count() / heapCycles : 0;
+    const double maxPauseNs = chrono::duration<double, nano>(grt.gc.maxPause).count();
+    delete heapUnit;
+    // distinct keys, integers spread over 64 bits and strings of 12 to 20 bytes
+    vector<int64_t> intKeys(1 << 18);
+    vector<string> strings(intKeys.size());
+    vector<string_view> stringKeys(intKeys.size());
+    for (size_t i = 0; i < intKeys.size(); i++) {
+        intKeys[i] = static_cast<int64_t>(SwissMap<int64_t, Malloc>::mix(i + 1));
+        strings[i] = "key" + to_string(i) + string(i % 9, '.');
+        stringKeys[i] = strings[i];
+    }
+    const int mapPasses = max(1, passes / 4);
+    const MapTimes intMaps = mapTimes(intKeys, mapPasses), stringMaps = mapTimes(stringKeys, mapPasses);
+    // a million goroutines park at once, the resident memory they take is sampled while they run
+    const char* idleSource = R"(package main
+
+func idle(ready, wake, done chan int) {
+    ready <- 1
+    <-wake
+    done <- 1
+}
+
+func main() {
+    ready, wake, done := make(chan int), make(chan int), make(chan int)
+    for i := 0; i < 1000000; i++ {
+        go idle(ready, wake, done)
+    }
+    for i := 0; i < 1000000; i++ {
+        <-ready
+    }
+    close(wake)
+    for i := 0; i < 1000000; i++ {
+        <-done
+    }
+}
+)";
+    auto* idleUnit = parse("idle.go", idleSource, ParseMode::Stream);
+    Package idlePackage;
+    idlePackage.merge(idleUnit);
+    const Program idleProgram = codegen(idlePackage);
+    if (idleProgram.entry < 0) {
+        cerr << "fatal error: the stack benchmark does not compile, " << idleProgram.note << "\n";
+        return EXIT_FAILURE;
+    }
+    const size_t idleGoroutines = 1000000, rssBefore = currentRSS();
+    atomic<size_t> rssPeak{ rssBefore };
+    atomic<bool> idleDone{ false };
+    thread sampler([&] {
+        while (!idleDone) {
+            rssPeak = max(rssPeak.load(), currentRSS());
+            this_thread::sleep_for(chrono::milliseconds(2));
+        }
+    });
+    const auto idleBegin = clock::now();
+    grt.run(idleProgram, idleProgram.entry);
+    const double idleSeconds = seconds(idleBegin) / idleGoroutines;
+    idleDone = true;
+    sampler.join();
+    const size_t idleBytes = rssPeak - rssBefore;
+    delete idleUnit;
+    Result total{ "total" };
+    for (auto& r : results) {
+        total.bytes += r.bytes; total.tokens += r.tokens; total.nodes += r.nodes;
+        total.arenaAllocs += r.arenaAllocs; total.arenaBytes += r.arenaBytes; total.heapAllocs += r.heapAllocs;
+        total.lexSeconds += r.lexSeconds; total.parseSeconds += r.parseSeconds; total.bufferSeconds += r.bufferSeconds; total.declSeconds += r.declSeconds;
+        total.imageBytes += r.imageBytes; total.cacheSeconds += r.cacheSeconds;
+        total.compactBytes += r.compactBytes; total.walkSeconds += r.walkSeconds; total.compactWalkSeconds += r.compactWalkSeconds;
+    }
+    total.peakRSS = peakRSS();
+    // a rate is the work of all passes divided by the time they took
+    auto rate = [&](size_t n, double secs) { return secs > 0 ? n * passes / secs : 0.0; };
+    ofstream json(report);
+    json.precision(10);
+    json << "{\n  \"passes\": " << passes << ",\n  \"files\": [\n";
+    auto emit = [&](const Result& r) {
+        string name;
+        for (char c : r.file) { if (c == '"' || c == '\\') name += '\\'; name += c; }
+        json << "{\"file\": \"" << name << "\", \"bytes\": " << r.bytes << ", \"tokens\": " << r.tokens
+            << ", \"nodes\": " << r.nodes << ", \"lex_seconds\": " << r.lexSeconds
+            << ", \"parse_seconds\": " << r.parseSeconds
+            << ", \"lex_bytes_per_sec\": " << rate(r.bytes, r.lexSeconds)
+            << ", \"tokens_per_sec\": " << rate(r.tokens, r.lexSeconds)
+            << ", \"parse_bytes_per_sec\": " << rate(r.bytes, r.parseSeconds)
+            << ", \"nodes_per_sec\": " << rate(r.nodes, r.parseSeconds)
+            << ", \"buffered_seconds\": " << r.bufferSeconds << ", \"buffered_bytes_per_sec\": " << rate(r.bytes, r.bufferSeconds)
+            << ", \"decl_seconds\": " << r.declSeconds << ", \"decl_bytes_per_sec\": " << rate(r.bytes, r.declSeconds)
+            << ", \"image_bytes\": " << r.imageBytes << ", \"cached_seconds\": " << r.cacheSeconds
+            << ", \"cached_bytes_per_sec\": " << rate(r.bytes, r.cacheSeconds)
+            << ", \"compact_bytes\": " << r.compactBytes << ", \"walk_nodes_per_sec\": " << rate(r.nodes, r.walkSeconds)
+            << ", \"compact_walk_nodes_per_sec\": " << rate(r.nodes, r.compactWalkSeconds)
+            << ", \"arena_allocs\": " << r.arenaAllocs << ", \"arena_bytes\": " << r.arenaBytes
+            << ", \"heap_allocs\": " << r.heapAllocs << ", \"peak_rss\": " << r.peakRSS << "}";
+    };
+    for (size_t k = 0; k < results.size(); k++) {
+        json << "    ";
+        emit(results[k]);
+        json << (k + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "  ],\n  \"interpreter\": {\"instructions\": " << instructions << ", \"vm_seconds\": " << vmSeconds
+        << ", \"vm_ops_per_sec\": " << rate(instructions, vmSeconds) << ", \"tree_seconds\": " << treeSeconds
+        << ", \"tree_ops_per_sec\": " << rate(instructions, treeSeconds) << "},\n  \"scheduler\": {\"spawn_ns\": "
+        << spawnSeconds * 1e9 << ", \"spawn_run_ns\": " << spawnRunSeconds * 1e9 << ", \"yield_ns\": " << yieldSeconds * 1e9
+        << "},\n  \"channels\": {\"unbuffered_msgs_per_sec\": " << (unbufferedSeconds > 0 ? 1 / unbufferedSeconds : 0)
+        << ", \"buffered_msgs_per_sec\": " << (bufferedSeconds > 0 ? 1 / bufferedSeconds : 0)
+        << ", \"round_trip_ns\": " << roundTripSeconds * 1e9 << "},\n  \"heap\": {\"alloc_bytes_per_sec\": " << allocRate
+        << ", \"gc_cycles\": " << heapCycles << ", \"avg_pause_ns\": " << pauseNs << ", \"max_pause_ns\": " << maxPauseNs
+        << ", \"peak_heap_bytes\": " << grt.gc.peak << "},\n  \"maps\": {";
+    for (auto[name, t] : { make_pair("int", &intMaps), make_pair("string", &stringMaps) })
+        json << "\"" << name << "\": {\"keys\": " << intKeys.size() << ", \"swiss_insert_ns\": " << t->insert[0]
+            << ", \"swiss_lookup_ns\": " << t->lookup[0] << ", \"swiss_iterate_ns\": " << t->iterate[0]
+            << ", \"unordered_insert_ns\": " << t->insert[1] << ", \"unordered_lookup_ns\": " << t->lookup[1]
+            << ", \"unordered_iterate_ns\": " << t->iterate[1] << "}" << (t == &intMaps ? ", " : "");
+    json << "},\n  \"stacks\": {\"idle_goroutines\": " << idleGoroutines << ", \"rss_bytes\": " << idleBytes
+        << ", \"rss_bytes_per_goroutine\": " << idleBytes / idleGoroutines << ", \"spawn_park_wake_ns\": " << idleSeconds * 1e9
+        << "},\n  \"total\": ";
+    emit(total);
+    json << "\n}\n";
+    auto print = [&](const Result& r) {
+        cout << r.file << ": " << r.bytes << " bytes, " << r.tokens << " tokens, " << r.nodes << " nodes, "
+            << rate(r.bytes, r.lexSeconds) / 1e6 << " MB/s lex, " << rate(r.tokens, r.lexSeconds) / 1e6 << " Mtok/s, "
+            << rate(r.bytes, r.parseSeconds) / 1e6 << " MB/s parse, " << rate(r.nodes, r.parseSeconds) / 1e6 << " Mnode/s, "
+            << rate(r.bytes, r.bufferSeconds) / 1e6 << " MB/s buffered, " << rate(r.bytes, r.declSeconds) / 1e6 << " MB/s decl-only, "
+            << rate(r.bytes, r.cacheSeconds) / 1e6 << " MB/s cached (" << r.imageBytes << " bytes image), "
+            << r.arenaBytes / 1024 << " KB tree, " << r.compactBytes / 1024 << " KB compact, " << rate(r.nodes, r.walkSeconds) / 1e6
+            << " Mnode/s walk, " << rate(r.nodes, r.compactWalkSeconds) / 1e6 << " Mnode/s compact walk, "
+            << r.arenaAllocs << " arena + " << r.heapAllocs << " heap allocs, " << r.peakRSS / 1024 << " KB peak RSS\n";
+    };
+    for (auto& r : results) print(r);
+    print(total);
+    cout << "interpreter: " << instructions << " instructions, " << rate(instructions, vmSeconds) / 1e6 << " Mop/s bytecode, "
+        << rate(instructions, treeSeconds) / 1e6 << " Mop/s walking the tree (" << treeSeconds / vmSeconds << "x)\n";
+    cout << "scheduler: " << spawnSeconds * 1e9 << " ns a go statement, " << spawnRunSeconds * 1e9 << " ns to spawn and run a goroutine, "
+        << yieldSeconds * 1e9 << " ns a switch by runtime.Gosched()\n";
+    cout << "channels: " << (unbufferedSeconds > 0 ? 1e-6 / unbufferedSeconds : 0) << " M/s unbuffered, "
+        << (bufferedSeconds > 0 ? 1e-6 / bufferedSeconds : 0) << " M/s buffered, " << roundTripSeconds * 1e9 << " ns a round trip\n";
+    cout << "heap: " << allocRate / 1e6 << " MB/s allocated, " << heapCycles << " collections, " << pauseNs / 1e3
+        << " us average pause, " << maxPauseNs / 1e3 << " us longest, " << (grt.gc.peak >> 20) << " MB peak heap\n";
+    for (auto[name, t] : { make_pair("int", &intMaps), make_pair("string", &stringMaps) })
+        cout << "maps of " << name << " keys: " << t->insert[0] << "/" << t->lookup[0] << "/" << t->iterate[0]
+            << " ns insert/lookup/range, std::unordered_map " << t->insert[1] << "/" << t->lookup[1] << "/" << t->iterate[1] << "\n";
+    cout << "stacks: " << idleGoroutines << " idle goroutines in " << (idleBytes >> 20) << " MB resident, "
+        << idleBytes / idleGoroutines << " bytes each, " << idleSeconds * 1e9 << " ns to spawn, park and wake one\n";
+    cout << "report written to " << report << "\n";
+    return 0;
+}
+#else
+// Diagnostics of units in the legacy format, file names lead them if there are several files
+bool printDiagnostics(const vector<CompilationUnit*>& units) {
+    bool failed = false;
+    for (auto* unit : units)
+        for (auto& d : unit->diagnostics) {
+            cerr << (units.size() > 1 ? unit->file + ": " : "") << d << "\n";
+            failed = true;
+        }
+    return failed;
+}
+
+// -batch checks every file in one process, it reports all diagnostics and then a table of files
+// and their parsing time. It fails if any file fails
+int batch(const vector<CompilationUnit*>& units) {
+    printDiagnostics(units);
+    size_t width = 4, failed = 0, errors = 0, cached = 0;
+    double seconds = 0;
+    for (auto* unit : units) width = max(width, unit->file.size());
+    cout << left << setw(width) << "file" << "  result  errors  time(ms)\n" << fixed << setprecision(3);
+    for (auto* unit : units) {
+        const size_t n = unit->diagnostics.size();
+        cout << setw(width) << unit->file << "  " << setw(6) << (n ? "FAIL" : "PASS") << "  " << setw(6) << n
+            << "  " << unit->seconds * 1000 << "\n";
+        failed += n != 0; errors += n; cached += unit->cached; seconds += unit->seconds;
+    }
+    cout << units.size() << " files, " << units.size() - failed << " passed, " << failed << " failed, "
+        << errors << " errors, " << cached << " from cache, " << seconds * 1000 << " ms\n";
+    return failed ? EXIT_FAILURE : 0;
+}
+
+// -compact rebuilds every tree as a CompactAst, it checks that both hold the same nodes and reports
+// the memory of each layout
+void compactReport(const vector<CompilationUnit*>& units) {
+    size_t tree = 0, flat = 0, nodes = 0;
+    for (auto* unit : units) {
+        const CompactAst compact(unit);
+        size_t visited = 0, compactVisited = 0;
+        auto walkAll = [&](const auto& decls) { for (auto* decl : decls) walk(decl, [&](auto) { visited++; return true; }); };
+        walkAll(unit->constDecl); walkAll(unit->typeDecl); walkAll(unit->funcDecl); walkAll(unit->varDecl);
+        for (auto* decls : { &compact.constDecl, &compact.typeDecl, &compact.funcDecl, &compact.varDecl })
+            for (auto decl : *decls) compact.walk(decl, [&](auto) { compactVisited++; return true; });
+        if (visited != compactVisited) {
+            cerr << "internal error: " << unit->file << " has " << visited << " nodes but " << compactVisited << " compact\n";
+            exit(EXIT_FAILURE);
+        }
+        tree += unit->arena.used; flat += compact.bytes(); nodes += visited;
+    }
+    cout << nodes << " nodes, " << tree << " bytes as nodes, " << flat << " bytes compact\n";
+}
+
+// -reparse edits the middle of some declarations of every file and undoes it, through reparse().
+// Each tree must be the one parsing the whole text gives, it reports how long reparse() took. With
+// -decl bodies are parsed every other edit, their diagnostics come in the order bodies are used
+int replayEdits(const vector<string>& files, ParseMode mode) {
+    constexpr size_t perFile = 4;
+    size_t edits = 0, incremental = 0;
+    double seconds = 0, worst = 0, wholeSeconds = 0;
+    auto same = [](CompilationUnit* a, CompilationUnit* b) {
+        auto sorted = [](vector<Diagnostic> ds) {
+            vector<tuple<int, int, string, string>> out;
+            for (auto& d : ds) out.emplace_back(d.line, d.column, d.kind, d.message);
+            sort(out.begin(), out.end());
+            return out;
+        };
+        return AstCache::encode(a, 0) == AstCache::encode(b, 0) && sorted(a->diagnostics) == sorted(b->diagnostics);
+    };
+    auto bodies = [](CompilationUnit* unit, CompilationUnit* like) {    // those like has parsed, or all
+        for (size_t i = 0; i < unit->funcDecl.size(); i++)
+            if (like == nullptr || (i < like->funcDecl.size() && like->funcDecl[i]->funcBody.text.empty()))
+                walk(unit->funcDecl[i], [](auto) { return true; });
+    };
+    for (auto& file : files) {
+        const Source src(file);
+        auto* unit = parse(file, string(src.begin, src.end), mode);
+        vector<size_t> middles;
+        const size_t n = unit->spans.size(), m = min(n, perFile);
+        for (size_t j = 0; j < m; j++) {
+            const size_t i = j * n / m, end = i + 1 < n ? unit->spans[i + 1].offset : unit->text.size();
+            middles.push_back((unit->spans[i].offset + end) / 2);
+        }
+        for (auto offset : middles) {
+            for (string_view text : { "x", "\n", "}" }) {
+                for (auto edit : { TextEdit{ offset, 0, text }, TextEdit{ offset, text.size(), "" } }) {
+                    unit = reparse(unit, edit);
+                    auto* whole = parse(file, unit->text, mode);
+                    if (edits % 2 != 0) bodies(unit, nullptr);
+                    bodies(whole, unit);
+                    if (!same(unit, whole)) {
+                        cerr << "internal error: " << file << " differs from a whole parse after an edit at " << offset << "\n";
+                        return EXIT_FAILURE;
+                    }
+                    edits++; incremental += unit->edits != 0;
+                    seconds += unit->seconds; worst = max(worst, unit->seconds); wholeSeconds += whole->seconds;
+                    delete whole;
+                }
+            }
+        }
+        delete unit;
+    }
+    cout << edits << " edits, " << incremental << " reparsed in place, " << fixed << setprecision(1)
+        << (edits ? seconds / edits * 1e6 : 0) << " us average, " << worst * 1e6 << " us worst, "
+        << (edits ? wholeSeconds / edits * 1e6 : 0) << " us to parse a whole file\n";
+    return 0;
 }
 
+// usage: g5 [-decl|-tokens] [-batch] [-cache] [-compact] [-reparse] [-dump-ssa] [-native] [-o exe]
+// [files or directories...], -decl parses function bodies only when they are used, -tokens lexes
+// every file up front, -cache reuses trees of unchanged files from $G5_CACHE_DIR or .g5cache, and
+// -dump-ssa prints the SSA of each function around its passes. main runs on the VM, or natively
+// with -native, -o links it into exe instead
 int main(int argc, char *argv[]) {
-    if (argc < 2 || argv[1] == nullptr) G_ERROR("fatal error", "specify your go source file\n");
+    ParseMode mode = ParseMode::Stream;
+    bool batchMode = false, compact = false, replay = false, native = false, dumpSsa = false;
+    string output;
+    unique_ptr<AstCache> cache;
+    int flags = 1;
+    for (; flags < argc && argv[flags][0] == '-'; flags++) {
+        const string_view flag = argv[flags];
+        if (flag == "-decl") mode = ParseMode::Lazy;
+        else if (flag == "-tokens") mode = ParseMode::Buffer;
+        else if (flag == "-batch") batchMode = true;
+        else if (flag == "-compact") compact = true;
+        else if (flag == "-reparse") replay = true;
+        else if (flag == "-native") native = true;
+        else if (flag == "-dump-ssa") dumpSsa = true;
+        else if (flag == "-o" && flags + 1 < argc) output = argv[++flags];
+        else if (flag == "-cache") cache = make_unique<AstCache>(getenv("G5_CACHE_DIR") ? getenv("G5_CACHE_DIR") : ".g5cache");
+        else {
+            cerr << "fatal error: unknown flag " << flag << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc <= flags) {
+        cerr << "fatal error: specify your go source files or directories\n";
+        return EXIT_FAILURE;
+    }
     //printLex(argv[1]);
-    const CompilationUnit* ast = parse(argv[1]);
+    if (replay) return replayEdits(goFiles(argv + flags, argc - flags), mode);
+    const auto units = parse(goFiles(argv + flags, argc - flags), mode, cache.get());
+    if (compact) compactReport(units);
+    if (batchMode) return batch(units);
+    if (printDiagnostics(units)) return EXIT_FAILURE;
+    map<Symbol, Package> packages;
+    for (CompilationUnit* unit : units)
+        packages[unit->package].merge(unit);
     cout << "parsing passed\n";
-    codegen(ast);
+    vector<Program> programs;
+    for (auto&[name, pkg] : packages) programs.push_back(codegen(pkg, dumpSsa ? &cout : nullptr));
+    if (printDiagnostics(units)) return EXIT_FAILURE;   // bodies parsed by codegen with -decl
+    for (auto& program : programs) {
+        if (!program.note.empty()) {
+            cerr << "note: main is not run, " << program.note << "\n";
+            return EXIT_FAILURE;
+        }
+        if (program.entry < 0) continue;
+        if (!native && output.empty()) {
+            grt.run(program, program.entry);
+            continue;
+        }
+#ifndef G5_NATIVE
+        cerr << "fatal error: " << (native ? "-native" : "-o") << " is not supported on this target, native code is only built for x86-64 Linux\n";
+        return EXIT_FAILURE;
+#else
+        const string exe = !output.empty() ? output
+            : (filesystem::temp_directory_path() / ("g5-" + to_string(getpid()))).string();
+        if (!link(program, exe)) return EXIT_FAILURE;
+        if (!native) continue;
+        cout.flush();
+        const int status = execute({ filesystem::absolute(exe).string() });    // not looked up in PATH
+        if (output.empty()) {
+            filesystem::remove(exe);
+            filesystem::remove(exe + ".s");
+        }
+        if (status == -1 || !WIFEXITED(status)) {
+            cerr << "fatal error: " << exe << " " << exitStatus(status) << "\n";
+            return EXIT_FAILURE;
+        }
+        if (WEXITSTATUS(status) != 0) return WEXITSTATUS(status);
+#endif
+    }
     return 0;
-}
\ No newline at end of file
+}
+#endif
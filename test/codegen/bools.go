@@ -0,0 +1,17 @@
+package main
+
+func less(a int, b int) bool {
+    return a < b
+}
+
+func main() {
+    g5print(1 < 2, false, true)
+    x := 3
+    ok := x > 2
+    var done bool
+    g5print(ok, done, !ok, x == 3 && !done, x != 3 || done)
+    g5print("less", less(x, 4), less(4, x), x)
+    for i := 0; i < 3; i++ {
+        g5print(i, i%2 == 0)
+    }
+}
@@ -0,0 +1,50 @@
+package main
+
+func sum8(a, b, c, d, e, f, g, h int) int {
+    return a + 2*b + 3*c + 4*d + 5*e + 6*f + 7*g + 8*h
+}
+
+func sum7(a, b, c, d, e, f, g int) int {
+    return sum8(a, b, c, d, e, f, g, a-g)
+}
+
+func ackermann(m, n int) int {
+    if m == 0 {
+        return n + 1
+    }
+    if n == 0 {
+        return ackermann(m-1, 1)
+    }
+    return ackermann(m-1, ackermann(m, n-1))
+}
+
+func even(n int) bool {
+    if n == 0 {
+        return true
+    }
+    return odd(n - 1)
+}
+
+func odd(n int) bool {
+    if n == 0 {
+        return false
+    }
+    return even(n - 1)
+}
+
+func mix(x int) int {
+    a, b, c, d, e, f, g := x, x+1, x+2, x+3, x+4, x+5, x+6
+    for i := 0; i < 3; i++ {
+        a, b, c, d, e, f, g = g-i, a*2, b^c, c&^d, d|e, e>>1, f<<2
+    }
+    return a + b + c + d + e + f + g
+}
+
+func main() {
+    min, one, max := -9223372036854775807 - 1, 1, 0x7fffffffffffffff
+    g5print(sum8(1, 2, 3, 4, 5, 6, 7, 8), sum7(9, 8, 7, 6, 5, 4, 3), ackermann(2, 3))
+    g5print(even(10), odd(7), even(7), mix(5))
+    g5print(min, min/-1, min%-1, 5/-1, one<<63, one<<64, -one>>70, 1000000000000*1000000)
+    s := 70
+    g5print(1<<s, -8>>s, 7>>1, -7>>1, ^5, max+one)
+}
@@ -0,0 +1,67 @@
+package main
+
+type Weekday int
+
+const (
+    Sunday Weekday = iota
+    Monday
+    Tuesday
+    _
+    Thursday
+)
+
+const (
+    KB = 1 << (10 * (iota + 1))
+    MB
+    GB
+    TB
+)
+
+const (
+    a, b = iota * 10, -iota
+    c, d
+    e, f
+)
+
+const (
+    huge  = 1 << 100
+    small = huge >> 98
+    mask  = ^uint32(0)
+    ratio = 7.0 / 2
+    whole = ratio * 4
+    name  = "g5" + "print"
+    size  = len(name)
+    first = 'a' + 2
+)
+
+const limit int8 = -128
+
+const deep = depth * 3
+const depth = width + 1
+const width = 4
+
+func scale(x int) int {
+    const factor = KB / 256
+    return x * factor
+}
+
+func shadow(iota int) int {
+    const small = 1
+    return iota + small
+}
+
+func main() {
+    g5print(Sunday, Monday, Tuesday, Thursday)
+    g5print(KB, MB, GB, TB)
+    g5print(a, b, c, d, e, f)
+    g5print(small, int(mask), int(whole), size, first, int(limit))
+    g5print(deep, scale(5), shadow(2), small)
+    g5print(int64(-9223372036854775808), 1000000007*1000000007%998244353, int(whole)/3)
+    const local = huge / (1 << 90)
+    x := local
+    {
+        local := 3
+        x += local
+    }
+    g5print(x, Weekday(2)+Tuesday)
+}
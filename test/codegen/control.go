@@ -0,0 +1,49 @@
+package main
+
+func fib(n int) int {
+    if n < 2 {
+        return n
+    }
+    return fib(n-1) + fib(n-2)
+}
+
+func gcd(a, b int) int {
+    for b != 0 {
+        a, b = b, a%b
+    }
+    return a
+}
+
+func collatz(n int) int {
+    steps := 0
+    for ; n != 1; steps++ {
+        if n%2 == 0 {
+            n /= 2
+        } else {
+            n = 3*n + 1
+        }
+    }
+    return steps
+}
+
+func main() {
+    sum := 0
+    for i := 0; i < 100; i++ {
+        if i%3 == 0 || i%5 == 0 {
+            continue
+        }
+        if i > 50 && !(i < 10) {
+            break
+        }
+        sum += i
+    }
+    x := 1
+    {
+        x := 2
+        x++
+    }
+    y := 0
+    y -= 0x10
+    g5print("fib", fib(20), "gcd", gcd(1071, 462), "collatz", collatz(27))
+    g5print(sum, x, y, -7/2, -7%2, 1<<40, 'a', '\n', 6&^3)
+}
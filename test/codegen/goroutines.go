@@ -0,0 +1,44 @@
+package main
+
+import "runtime"
+
+func collatz(n int) int {
+    steps := 0
+    for n != 1 {
+        if n%2 == 0 {
+            n = n / 2
+        } else {
+            n = 3*n + 1
+        }
+        steps++
+    }
+    return steps
+}
+
+// every worker prints the same line, so any schedule prints the same output
+func worker(from, to int) {
+    longest := 0
+    for i := from; i < from+to; i++ {
+        if collatz(27) > longest {
+            longest = collatz(27)
+        }
+    }
+    g5print("worker", longest)
+}
+
+func spawner(n int) {
+    for i := 0; i < n; i++ {
+        go worker(i, 50)
+    }
+}
+
+func main() {
+    for i := 0; i < 4; i++ {
+        go worker(i, 200)
+    }
+    go spawner(4)
+    for i := 0; i < 10000; i++ {
+        runtime.Gosched()
+    }
+    g5print("main", collatz(97))
+}
@@ -0,0 +1,14 @@
+package main
+
+// n never gets back to 0, the recursion runs out of stack long before it wraps
+func down(n int) int {
+    if n == 0 {
+        return 0
+    }
+    return down(n+1) + 1
+}
+
+func main() {
+    g5print("deep")
+    g5print(down(1))
+}
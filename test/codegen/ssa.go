@@ -0,0 +1,115 @@
+package main
+
+func rotate(n int) int {
+    a, b, c := 1, 2, 3
+    for i := 0; i < n; i++ {
+        a, b, c = b, c, a
+    }
+    return a*100 + b*10 + c
+}
+
+func swapfib(n int) int {
+    a, b := 0, 1
+    for n > 0 {
+        a, b = b, a+b
+        n--
+    }
+    return a
+}
+
+func early(x int) int {
+    if x > 10 {
+        return 1
+        x = 5
+    } else if x > 5 {
+        return 2
+    }
+    for {
+        x++
+        if x%7 == 0 {
+            break
+        }
+        continue
+        x = 100
+    }
+    return x
+}
+
+func logic(a, b int) int {
+    t := a > 0 && b > 0
+    u := a > 0 || b > 0
+    v := !(a == b) && (a < b || b < 0)
+    r := 0
+    if t {
+        r += 1
+    }
+    if u {
+        r += 2
+    }
+    if v {
+        r += 4
+    }
+    return r
+}
+
+func nested(n int) int {
+    total := 0
+    for i := 0; i < n; i++ {
+        for j := i; j < n; j++ {
+            if j == 7 {
+                break
+            }
+            if (i+j)%3 == 0 {
+                continue
+            }
+            total += i * j
+        }
+        x := total
+        {
+            x := x * 2
+            total += x % 5
+        }
+        total += x % 3
+    }
+    return total
+}
+
+func same(x int) int {
+    y := x*x + 3
+    z := x*x + 3
+    w := 3 + x*x
+    k := 2 * 21
+    if k == 42 {
+        return y + z - w
+    }
+    return 0
+}
+
+func dead(x int) int {
+    unused := x * 1000
+    _ = unused
+    q := x / 1
+    return q
+}
+
+func trap(x int) int {
+    d := 0
+    _ = d
+    return x
+}
+
+func main() {
+    g5print(rotate(0), rotate(1), rotate(2), rotate(3), rotate(10))
+    g5print(swapfib(10), swapfib(50), swapfib(90))
+    g5print(early(20), early(7), early(1), early(3))
+    g5print(logic(1, 1), logic(1, -1), logic(-1, -1), logic(0, 5), logic(5, 0))
+    g5print(nested(10), nested(3), same(4), same(-4), dead(3), trap(9))
+    a, b := 1, 2
+    a, b = b, a
+    g5print(a, b)
+    i := 0
+    for i < 3 {
+        i++
+    }
+    g5print(i)
+}
@@ -0,0 +1,16 @@
+package main
+
+const (
+    zero = 0
+    ratio = 1 / zero
+)
+
+const byte8 uint8 = 1 << 8
+
+const loop = loop + 1
+
+func main() {
+    const mixed = int8(1) + uint8(2)
+    wide := 1 << 63
+    g5print(wide, 3.5 << 1)
+}
@@ -0,0 +1,7 @@
+package main
+
+// x is a uint, x - 2 wraps at 2^64 where integers of the VM go negative
+func main() {
+    x := uint(1)
+    g5print(x - 2)
+}
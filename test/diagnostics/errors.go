@@ -0,0 +1,29 @@
+package main
+
+import "fmt"
+
+func first() {
+    x := 1 +
+    y := x @ 2
+    fmt.Println(x)
+}
+
+var broken = ]
+
+func second(a int) int {
+    if a > {
+        return 1
+    }
+    switch a {
+    case 1:
+        a = )
+    default:
+        return a
+    }
+    return a
+}
+
+func main() {
+    first()
+    second(1)
+}
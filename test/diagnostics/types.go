@@ -0,0 +1,10 @@
+package main
+
+// uint8 wraps at 256, integers of the VM wrap at 2^64
+func next(x uint8) uint8 {
+    return x + 1
+}
+
+func main() {
+    g5print(next(255))
+}
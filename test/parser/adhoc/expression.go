@@ -2,4 +2,9 @@ package main
 
 func main(){
     n := len(p) &^ (chunk - 1)
-}
\ No newline at end of file
+}
+func precedence(a, b, c int, ok bool) bool {
+    x := a*b + c<<2 - -a
+    y := a + b*c&^3 | a%b>>1
+    return x == y || a < b && !ok || c >= a*b+c
+}
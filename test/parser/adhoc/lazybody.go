@@ -0,0 +1,19 @@
+package main
+
+func braces() string {
+    s := "}}{ \"}\" \\"
+    r := '}'
+    q := '\''
+    raw := `}
+{{`
+    /* } { */
+    // }}}
+    if len(s) > 0 { return raw }
+    return string(r) + string(q)
+}
+
+func main() {
+    m := map[string]int{"{": 1, "}": 2}
+    f := func() { m["}"]++ }
+    f()
+}
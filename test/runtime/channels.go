@@ -0,0 +1,106 @@
+package main
+
+func produce(ch chan int, from, n int) {
+    for i := from; i < from+n; i++ {
+        ch <- i
+    }
+}
+
+func consume(ch chan int, n int, done chan int) {
+    sum := 0
+    for i := 0; i < n; i++ {
+        sum += <-ch
+    }
+    done <- sum
+}
+
+// values of one sender arrive in the order they were sent
+func ordered(ch chan int, n int) int {
+    for i := 0; i < n; i++ {
+        if <-ch != i {
+            return 0
+        }
+    }
+    return 1
+}
+
+func pipe(in, out chan int) {
+    for {
+        v := <-in
+        if v < 0 {
+            close(out)
+            return
+        }
+        out <- v * v
+    }
+}
+
+func fanIn(a, b, quit chan int) int {
+    sum := 0
+    for {
+        select {
+        case v := <-a:
+            sum += v
+        case v := <-b:
+            sum -= v
+        case <-quit:
+            return sum
+        }
+    }
+}
+
+func sendBoth(a, b chan int, n int, quit chan int) {
+    for i := 1; i <= n; i++ {
+        a <- i
+        b <- 1
+    }
+    quit <- 0
+}
+
+func main() {
+    // many producers and consumers on an unbuffered and a buffered channel
+    for size := 0; size <= 8; size += 8 {
+        ch, done := make(chan int, size), make(chan int)
+        for p := 0; p < 4; p++ {
+            go produce(ch, p*1000, 1000)
+        }
+        for c := 0; c < 2; c++ {
+            go consume(ch, 2000, done)
+        }
+        g5print("size", size, "sum", <-done+<-done)
+    }
+
+    one := make(chan int, 3)
+    go produce(one, 0, 5000)
+    g5print("ordered", ordered(one, 5000))
+
+    in, out := make(chan int), make(chan int, 1)
+    go pipe(in, out)
+    in <- 12
+    g5print("squared", <-out)
+    in <- -1
+    g5print("closed", <-out, <-out)
+
+    a, b, quit := make(chan int), make(chan int), make(chan int)
+    go sendBoth(a, b, 100, quit)
+    g5print("fan-in", fanIn(a, b, quit))
+
+    // default is taken while nothing is ready, a nil channel is never ready
+    var none chan int
+    full := make(chan int, 1)
+    full <- 1
+    select {
+    case full <- 2:
+        g5print("sent to a full channel")
+    case v := <-none:
+        g5print("received from nil", v)
+    default:
+        g5print("default")
+    }
+    select {
+    case v := <-full:
+        g5print("received", v)
+    default:
+        g5print("default")
+    }
+}
@@ -0,0 +1,21 @@
+package main
+
+func wait(ch chan int) {
+    <-ch
+}
+
+// every goroutine is blocked once main waits for a value no one sends
+func main() {
+    ch := make(chan int)
+    for i := 0; i < 4; i++ {
+        go wait(ch)
+    }
+    ch <- 1
+    g5print("one waiter got a value")
+    select {
+    case ch <- 2:
+    case <-make(chan int):
+    }
+    g5print("another one got a value")
+    <-ch
+}
@@ -0,0 +1,73 @@
+package main
+
+// a node is a slice of its two children, a leaf has none
+type node []node
+
+func tree(depth int) node {
+    if depth == 0 {
+        return make(node, 0)
+    }
+    n := make(node, 2)
+    n[0] = tree(depth - 1)
+    n[1] = tree(depth - 1)
+    return n
+}
+
+func check(t node) int {
+    if len(t) == 0 {
+        return 1
+    }
+    return 1 + check(t[0]) + check(t[1])
+}
+
+func builder(n int, out chan node) {
+    for i := 0; i < n; i++ {
+        out <- tree(10)
+    }
+}
+
+// a cell holds the round that stored it, a slice of 5 and its index in the table
+type cell [][]int
+
+// cells of the table are replaced while the collector runs, each must still hold what was stored last
+func churn(table []cell, rounds int) int {
+    for i := 0; i < rounds; i++ {
+        k := i % len(table)
+        c := make(cell, 3)
+        c[0] = []int{i}
+        c[1] = make([]int, 5)
+        c[2] = []int{k}
+        table[k] = c
+    }
+    bad := 0
+    for k := 0; k < len(table); k++ {
+        c := table[k]
+        if c[2][0] != k || c[0][0]%len(table) != k || len(c[1]) != 5 {
+            bad++
+        }
+    }
+    return bad
+}
+
+func main() {
+    var none []int
+    s := []int{1, 2, 3}
+    s[1] += 40
+    s[2]++
+    m := [][]int{{1, 2}, {3}}
+    g5print("literals", len(none), len(s), s[0], s[1], s[2], len(m), len(m[1]), m[0][1])
+    long := tree(14)
+    ch := make(chan node, 4)
+    for w := 0; w < 4; w++ {
+        go builder(50, ch)
+    }
+    sum := 0
+    for i := 0; i < 200; i++ {
+        sum += check(<-ch)
+    }
+    g5print("trees", sum, check(long))
+    g5print("churn", churn(make([]cell, 1000), 300000))
+    big := make([]int, 100000)
+    big[99999] = 7
+    g5print("large", len(big), big[0], big[99999])
+}
@@ -0,0 +1,123 @@
+package main
+
+type index map[int][]int
+
+func fill(n int) map[int]int {
+    m := make(map[int]int)
+    for i := 0; i < n; i++ {
+        m[i*7] = i
+    }
+    return m
+}
+
+func sum(m map[int]int) int {
+    s := 0
+    for k, v := range m {
+        s += k + v
+    }
+    return s
+}
+
+// every entry is produced once even though each is deleted as it is
+func drain(m map[int]int) int {
+    n := 0
+    for k := range m {
+        delete(m, k)
+        n++
+    }
+    return n + len(m)
+}
+
+// values of a map keep what they point to alive while the collector runs
+func churn(rounds int) int {
+    cells := make(index, 64)
+    for i := 0; i < rounds; i++ {
+        cell := make([]int, 2)
+        cell[0] = i
+        cell[1] = i % 512
+        cells[i%512] = cell
+        if i%3 == 0 {
+            delete(cells, (i+7)%512)
+        }
+    }
+    bad := 0
+    for k, cell := range cells {
+        if cell[1] != k || cell[0]%512 != k {
+            bad++
+        }
+    }
+    return bad
+}
+
+func worker(id int, done chan int) {
+    m := fill(20000 + id)
+    done <- sum(m)
+}
+
+// maps made in another goroutine arrive through a channel
+func send(out chan map[int]int) {
+    for n := 1; n <= 2; n++ {
+        m := make(map[int]int)
+        for i := 0; i < 10; i++ {
+            m[i] = i * i * n
+        }
+        out <- m
+    }
+}
+
+func main() {
+    m := fill(100000)
+    g5print("fill", len(m), m[700], m[699], sum(m))
+    for i := 0; i < 100000; i += 2 {
+        delete(m, i*7)
+    }
+    v, ok := m[7]
+    w, found := m[14]
+    g5print("delete", len(m), v, ok, w, found, sum(m))
+    m[7] += 5
+    m[21]++
+    m[-1]--
+    g5print("update", m[7], m[21], m[-1], len(m))
+    g5print("drain", drain(m), len(m))
+    var none map[int]int
+    g5print("nil", len(none), none[3], sum(none))
+    lit := map[int]int{1: 10, 2: 20, 3: 30}
+    nested := map[int][]int{1: {1, 2, 3}, 2: {4}}
+    g5print("literals", len(lit), lit[2], sum(lit), len(nested[1]), nested[2][0], len(nested[3]))
+    s := []int{5, 6, 7}
+    total := 0
+    for i, x := range s {
+        total += i * x
+    }
+    for range s {
+        total++
+    }
+    g5print("slices", total)
+    g5print("churn", churn(400000))
+    done := make(chan int)
+    for id := 0; id < 4; id++ {
+        go worker(id, done)
+    }
+    all := 0
+    for id := 0; id < 4; id++ {
+        all += <-done
+    }
+    g5print("workers", all)
+    maps := make(chan map[int]int)
+    go send(maps)
+    first := <-maps
+    first[0] = 7
+    last, held := first[9]
+    got := 0
+    select {
+    case r := <-maps:
+        for k, x := range r {
+            got += k * x
+        }
+        _, missing := r[10]
+        if !missing {
+            got += len(r)
+        }
+    }
+    g5print("channel", first[5], first[0], len(first), last, held, got)
+}
@@ -0,0 +1,88 @@
+package main
+
+func depth(n int) int {
+    if n == 0 {
+        return 0
+    }
+    return depth(n-1) + 1
+}
+
+func deep(n int, done chan int) {
+    done <- depth(n)
+}
+
+// each frame holds a slice of its own, the collector runs while they are on a stack that moved
+func hold(n int) int {
+    s := make([]int, 4)
+    s[0] = n
+    s[3] = n * 3
+    if n > 0 {
+        if hold(n-1) != n-1 {
+            return -1
+        }
+    } else {
+        for i := 0; i < 50000; i++ {
+            garbage := make([]int, 16)
+            garbage[0] = i
+        }
+    }
+    if len(s) != 4 || s[3] != n*3 {
+        return -1
+    }
+    return s[0]
+}
+
+// goes deep, waits with a shallow stack while the collector may shrink it, and goes deep again
+func again(n int, wake, done chan int) {
+    first := depth(n)
+    <-wake
+    done <- first + depth(n)
+}
+
+func idle(wake, done chan int) {
+    <-wake
+    done <- 1
+}
+
+func main() {
+    g5print("main", depth(100000))
+
+    done := make(chan int)
+    for i := 0; i < 8; i++ {
+        go deep(20000+i, done)
+    }
+    sum := 0
+    for i := 0; i < 8; i++ {
+        sum += <-done
+    }
+    g5print("goroutines", sum)
+
+    g5print("hold", hold(3000))
+
+    wake := make(chan int)
+    for i := 0; i < 16; i++ {
+        go again(5000, wake, done)
+    }
+    for i := 0; i < 200000; i++ {
+        garbage := make([]int, 16)
+        garbage[0] = i
+    }
+    close(wake)
+    sum = 0
+    for i := 0; i < 16; i++ {
+        sum += <-done
+    }
+    g5print("again", sum)
+
+    // idle goroutines each hold a small stack
+    wake = make(chan int)
+    for i := 0; i < 100000; i++ {
+        go idle(wake, done)
+    }
+    close(wake)
+    sum = 0
+    for i := 0; i < 100000; i++ {
+        sum += <-done
+    }
+    g5print("idle", sum)
+}